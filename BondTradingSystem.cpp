@@ -1,154 +1,274 @@
-// BondTradingSystem.cpp : Defines the entry point for the console application.
-//
-
-#include "historicaldataservice.hpp"
-
-int main()
-{
-	std::vector<std::string> CUSIPS = {
-
-		"9128283H1", "9128283L2", "912828M80",
-
-		"9128283J7", "9128283F5", "912810RZ3" };
-
-	std::vector<float> BondCoupon = { static_cast<float>(0), static_cast<float>(0), static_cast<float>(0), static_cast<float>(0), static_cast<float>(0), static_cast<float>(0) };
-
-	std::vector<date> BondMaturity = { date(2019, 11, 30), date(2020, 12, 15), date(2022, 11, 30),
-
-		date(2024, 11, 30), date(2027, 11, 15), date(2047, 11, 15) };
-
-	std::vector<float> BondYield = { static_cast<float>(1.765 / 100.), static_cast<float>(1.932 / 100.), 
-		
-		static_cast<float>(2.066 / 100.), static_cast<float>(2.230 / 100.),
-
-		static_cast<float>(2.384 / 100.), static_cast<float>(2.801 / 100.) };
-
-
-	auto bondRiskServiceListener = BondRiskServiceListener::instance();
-
-	//auto bondTradeBookingServiceConnector = BondTradeBookingConnector::instance();
-
-	auto bondPositionServiceListener = BondPositionServiceListener::instance();
-
-	auto bondRiskService = bondRiskServiceListener->GetService();
-
-	auto bondPositionService = bondPositionServiceListener->GetService();
-
-	//auto bondTradeBookingService = bondTradeBookingServiceConnector->GetService();
-
-	auto bondInquiryServiceConnector = BondInquiryConnector::instance();
-
-	auto bondInquiryService = bondInquiryServiceConnector->GetService();
-
-	auto bondMarketDataServiceConnector = BondMarketDataConnector::instance();
-
-	auto bondMarketDataService = bondMarketDataServiceConnector->GetService();
-
-	auto bondAlgoExecutionServiceListener = BondAlgoExecutionServiceListener::instance();
-
-	auto bondAlgoExecutionService = bondAlgoExecutionServiceListener->GetService();
-
-	auto bondExecutionServiceListener = BondExecutionServiceListener::instance();
-
-	auto bondExecutionService = bondExecutionServiceListener->GetService();
-
-	auto bondTradeBookingServiceListener = BondTradeBookingServiceListener::instance();
-
-	auto bondTradeBookingService = bondTradeBookingServiceListener->GetService();
-
-	auto bondPricingServiceConnector = BondPricingServiceConnector::instance();
-
-	auto bondPricingService = bondPricingServiceConnector->GetService();
-
-	auto bondAlgoStreamingServiceListener = BondAlgoStreamingServiceListener::instance();
-
-	auto bondAlgoStreamingService = bondAlgoStreamingServiceListener->GetService();
-
-	auto bondStreamingServiceListener = BondStreamingServiceListener::instance();
-
-	auto bondStreamingService = bondStreamingServiceListener->GetService();
-
-	auto bondGUIServiceListener = BondGUIServiceListener::instance();
-
-	auto bondGUIService = bondGUIServiceListener->GetService();
-
-	auto bondHistoricalPV01ServiceListener = BondHistoricalPV01ServiceListener::instance();
-
-	auto bondHistoricalExecutionServiceListener = BondHistoricalExecutionServiceListener::instance();
-
-	auto bondHistoricalStreamingServiceListener = BondHistoricalStreamingServiceListener::instance();
-
-	auto bondHistoricalInquriyServiceListener = BondHistoricalInquiryServiceListener::instance();
-
-	bondInquiryService->AddListener(bondHistoricalInquriyServiceListener);
-
-	bondStreamingService->AddListener(bondHistoricalStreamingServiceListener);
-
-	bondExecutionService->AddListener(bondHistoricalExecutionServiceListener);
-
-	bondRiskService->AddListener(bondHistoricalPV01ServiceListener);
-
-	bondAlgoStreamingService->AddListener(bondStreamingServiceListener);
-
-	bondPricingService->AddListener(bondAlgoStreamingServiceListener);
-
-	bondMarketDataService->AddListener(bondAlgoExecutionServiceListener);
-
-	bondAlgoExecutionService->AddListener(bondExecutionServiceListener);
-
-	bondTradeBookingService->AddListener(bondPositionServiceListener);
-
-	bondPositionService->AddListener(bondRiskServiceListener);
-
-	bondExecutionService->AddListener(bondTradeBookingServiceListener);
-
-	bondPricingService->AddListener(bondGUIServiceListener);
-
-	for (int i = 0; i < 6; ++i) {
-
-		Bond bond(CUSIPS[i], CUSIP, "T", BondCoupon[i], BondMaturity[i]);
-
-		Position<Bond> position(bond);
-
-		PV01<Bond> pv01(bond, BondYield[i], position.GetAggregatePosition());
-
-		bondRiskService->Add(pv01);
-
-	}
-	
-	std::vector<Bond> bonds = { Bond(CUSIPS[0], CUSIP, "T", BondCoupon[0], BondMaturity[0]),  Bond(CUSIPS[1], CUSIP, "T", BondCoupon[1], BondMaturity[1]) };
-	BucketedSector<Bond> sector(bonds, "sector1");
-	bondRiskService->AddBusketedSector(sector);
-
-	bonds = { Bond(CUSIPS[2], CUSIP, "T", BondCoupon[2], BondMaturity[2]),  Bond(CUSIPS[3], CUSIP, "T", BondCoupon[3], BondMaturity[3]), Bond(CUSIPS[4], CUSIP, "T", BondCoupon[4], BondMaturity[4]) };
-	sector = BucketedSector<Bond>(bonds, "sector2");
-	bondRiskService->AddBusketedSector(sector);
-
-	bonds = { Bond(CUSIPS[5], CUSIP, "T", BondCoupon[5], BondMaturity[5]) };
-	sector = BucketedSector<Bond>(bonds, "sector3");
-	bondRiskService->AddBusketedSector(sector);
-
-	trade_data();
-
-	bond_data();
-
-	inquiries_data();
-
-	market_data();
-
-	prices_data();
-
-	//bondTradeBookingServiceConnector->Subscribe();
-
-
-	bondInquiryServiceConnector->Subscribe();
-
-	bondMarketDataServiceConnector->Subscribe();
-
-	bondPricingServiceConnector->Subscribe();
-
-
-    
-	return 0;
-}
-
+// BondTradingSystem.cpp : Defines the entry point for the console application.
+//
+
+#include "historicaldataservice.hpp"
+#include "benchmark.hpp"
+#include "asynclistener.hpp"
+#include "replay.hpp"
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::string(argv[1]) == "benchmark") {
+
+		return (run_benchmarks() == 0 ? 0 : 1);
+
+	}
+
+	// print binary journals in the historical text format
+	if (argc > 2 && std::string(argv[1]) == "readjournal") {
+
+		for (int i = 2; i < argc; ++i) JournalReader(argv[i]).ToText(std::cout);
+
+		return 0;
+
+	}
+
+	// "journal" writes the historical records as binary journals, "record" also journals every
+	// connector input to inputs.jnl, and "replay <file> [speed]" feeds such a journal back in
+
+	std::string mode = (argc > 1 ? argv[1] : "");
+
+	if (mode == "replay" && argc < 3) {
+
+		std::cerr << "usage: BondTradingSystem replay <journal> [speed]" << std::endl;
+
+		return 1;
+
+	}
+
+	std::vector<std::string> CUSIPS = {
+
+		"9128283H1", "9128283L2", "912828M80",
+
+		"9128283J7", "9128283F5", "912810RZ3" };
+
+	std::vector<float> BondCoupon = { static_cast<float>(0), static_cast<float>(0), static_cast<float>(0), static_cast<float>(0), static_cast<float>(0), static_cast<float>(0) };
+
+	std::vector<date> BondMaturity = { date(2019, 11, 30), date(2020, 12, 15), date(2022, 11, 30),
+
+		date(2024, 11, 30), date(2027, 11, 15), date(2047, 11, 15) };
+
+	std::vector<float> BondYield = { static_cast<float>(1.765 / 100.), static_cast<float>(1.932 / 100.), 
+		
+		static_cast<float>(2.066 / 100.), static_cast<float>(2.230 / 100.),
+
+		static_cast<float>(2.384 / 100.), static_cast<float>(2.801 / 100.) };
+
+
+	auto bondRiskServiceListener = BondRiskServiceListener::instance();
+
+	//auto bondTradeBookingServiceConnector = BondTradeBookingConnector::instance();
+
+	auto bondPositionServiceListener = BondPositionServiceListener::instance();
+
+	auto bondRiskService = bondRiskServiceListener->GetService();
+
+	auto bondPositionService = bondPositionServiceListener->GetService();
+
+	//auto bondTradeBookingService = bondTradeBookingServiceConnector->GetService();
+
+	auto bondInquiryServiceConnector = BondInquiryConnector::instance();
+
+	auto bondInquiryService = bondInquiryServiceConnector->GetService();
+
+	auto bondMarketDataServiceConnector = BondMarketDataConnector::instance();
+
+	auto bondMarketDataService = bondMarketDataServiceConnector->GetService();
+
+	auto bondAlgoExecutionServiceListener = BondAlgoExecutionServiceListener::instance();
+
+	auto bondAlgoExecutionService = bondAlgoExecutionServiceListener->GetService();
+
+	auto bondExecutionServiceListener = BondExecutionServiceListener::instance();
+
+	auto bondExecutionService = bondExecutionServiceListener->GetService();
+
+	auto bondTradeBookingServiceListener = BondTradeBookingServiceListener::instance();
+
+	auto bondTradeBookingService = bondTradeBookingServiceListener->GetService();
+
+	auto bondPricingServiceConnector = BondPricingServiceConnector::instance();
+
+	auto bondPricingService = bondPricingServiceConnector->GetService();
+
+	auto bondAlgoStreamingServiceListener = BondAlgoStreamingServiceListener::instance();
+
+	auto bondAlgoStreamingService = bondAlgoStreamingServiceListener->GetService();
+
+	auto bondStreamingServiceListener = BondStreamingServiceListener::instance();
+
+	auto bondStreamingService = bondStreamingServiceListener->GetService();
+
+	auto bondGUIServiceListener = BondGUIServiceListener::instance();
+
+	auto bondGUIService = bondGUIServiceListener->GetService();
+
+	auto bondHistoricalPV01ServiceListener = BondHistoricalPV01ServiceListener::instance();
+
+	auto bondHistoricalExecutionServiceListener = BondHistoricalExecutionServiceListener::instance();
+
+	auto bondHistoricalStreamingServiceListener = BondHistoricalStreamingServiceListener::instance();
+
+	auto bondHistoricalInquriyServiceListener = BondHistoricalInquiryServiceListener::instance();
+
+	if (mode == "journal") {
+
+		BondHistoricalPV01Connector::instance()->EnableJournal("risk.jnl");
+
+		BondHistoricalExecutionConnector::instance()->EnableJournal("executions.jnl");
+
+		BondHistoricalStreamingConnector::instance()->EnableJournal("streaming.jnl");
+
+		BondHistoricalInquiryConnector::instance()->EnableJournal("allinquiries.jnl");
+
+	}
+
+	// the historical persisters write files, so they get their own queues and threads;
+	// leaving main() destroys these wrappers, which delivers whatever is still queued
+
+	AsyncServiceListener<Inquiry<Bond>> asyncHistoricalInquiryListener(bondHistoricalInquriyServiceListener, 4096, BLOCK);
+
+	AsyncServiceListener<PriceStream<Bond>> asyncHistoricalStreamingListener(bondHistoricalStreamingServiceListener, 4096, BLOCK);
+
+	AsyncServiceListener<ExecutionOrder<Bond>> asyncHistoricalExecutionListener(bondHistoricalExecutionServiceListener, 4096, BLOCK);
+
+	AsyncServiceListener<PV01<Bond>> asyncHistoricalPV01Listener(bondHistoricalPV01ServiceListener, 4096, BLOCK);
+
+	bondInquiryService->AddListener(&asyncHistoricalInquiryListener);
+
+	bondStreamingService->AddListener(&asyncHistoricalStreamingListener);
+
+	bondExecutionService->AddListener(&asyncHistoricalExecutionListener);
+
+	bondRiskService->AddListener(&asyncHistoricalPV01Listener);
+
+	bondAlgoStreamingService->AddListener(bondStreamingServiceListener);
+
+	bondPricingService->AddListener(bondAlgoStreamingServiceListener);
+
+	bondMarketDataService->AddListener(BondVenueBookListener::instance());
+
+	bondMarketDataService->AddListener(bondAlgoExecutionServiceListener);
+
+	bondAlgoExecutionService->AddListener(bondExecutionServiceListener);
+
+	bondTradeBookingService->AddListener(bondPositionServiceListener);
+
+	bondPositionService->AddListener(bondRiskServiceListener);
+
+	bondPositionService->AddListener(BondStreamingPositionListener::instance());
+
+	bondExecutionService->AddListener(bondTradeBookingServiceListener);
+
+	std::unique_ptr<JournalWriter> inputJournal(mode == "record" ? new JournalWriter("inputs.jnl") : nullptr);
+
+	JournalServiceListener<OrderBook<Bond>> orderBookRecorder(inputJournal.get());
+
+	JournalServiceListener<OrderBookDelta> deltaRecorder(inputJournal.get());
+
+	JournalServiceListener<Price<Bond>> priceRecorder(inputJournal.get());
+
+	JournalServiceListener<Trade<Bond>> tradeRecorder(inputJournal.get());
+
+	JournalServiceListener<Inquiry<Bond>> inquiryRecorder(inputJournal.get());
+
+	if (inputJournal) {
+
+		bondMarketDataServiceConnector->SetRecorder(&orderBookRecorder);
+
+		bondMarketDataServiceConnector->SetRecorder(&deltaRecorder);
+
+		bondPricingServiceConnector->SetRecorder(&priceRecorder);
+
+		BondTradeBookingConnector::instance()->SetRecorder(&tradeRecorder);
+
+		bondInquiryServiceConnector->SetRecorder(&inquiryRecorder);
+
+	}
+
+	// the GUI only shows the latest price per CUSIP, so a burst collapses to one update per bond
+
+	BondPriceConflatingListener conflatingGUIListener(bondGUIServiceListener);
+
+	bondPricingService->AddListener(&conflatingGUIListener);
+
+	// the universe is priced as of the on-the-run issue dates of these maturities
+
+	bondRiskService->SetSettlementDate(date(2017, 12, 15));
+
+	for (int i = 0; i < 6; ++i) {
+
+		Bond bond(CUSIPS[i], CUSIP, "T", BondCoupon[i], BondMaturity[i]);
+
+		bondRiskService->AddBond(bond, BondYield[i]);
+
+	}
+	
+	std::vector<Bond> bonds = { Bond(CUSIPS[0], CUSIP, "T", BondCoupon[0], BondMaturity[0]),  Bond(CUSIPS[1], CUSIP, "T", BondCoupon[1], BondMaturity[1]) };
+	BucketedSector<Bond> sector(bonds, "sector1");
+	bondRiskService->AddBusketedSector(sector);
+
+	bonds = { Bond(CUSIPS[2], CUSIP, "T", BondCoupon[2], BondMaturity[2]),  Bond(CUSIPS[3], CUSIP, "T", BondCoupon[3], BondMaturity[3]), Bond(CUSIPS[4], CUSIP, "T", BondCoupon[4], BondMaturity[4]) };
+	sector = BucketedSector<Bond>(bonds, "sector2");
+	bondRiskService->AddBusketedSector(sector);
+
+	bonds = { Bond(CUSIPS[5], CUSIP, "T", BondCoupon[5], BondMaturity[5]) };
+	sector = BucketedSector<Bond>(bonds, "sector3");
+	bondRiskService->AddBusketedSector(sector);
+
+	if (mode == "replay") {
+
+		bond_data();
+
+		ReplayEngine replayEngine(argc > 3 ? std::stod(argv[3]) : 0);
+
+		size_t inputs = replayEngine.Replay(argv[2]);
+
+		double seconds = time_it([&]() {
+
+			asyncHistoricalInquiryListener.Drain();
+
+			asyncHistoricalStreamingListener.Drain();
+
+			asyncHistoricalExecutionListener.Drain();
+
+			asyncHistoricalPV01Listener.Drain();
+
+		}) + replayEngine.GetSeconds();
+
+		std::cout << "Replayed " << inputs << " inputs in " << seconds << " seconds (" << inputs / seconds << " inputs/sec end to end)" << std::endl;
+
+		return 0;
+
+	}
+
+	trade_data();
+
+	bond_data();
+
+	inquiries_data();
+
+	market_data();
+
+	prices_data();
+
+	market_data_deltas();
+
+	//bondTradeBookingServiceConnector->Subscribe();
+
+
+	bondInquiryServiceConnector->Subscribe();
+
+	bondMarketDataServiceConnector->Subscribe();
+
+	// the deltas apply level by level on top of the books the snapshots left
+
+	bondMarketDataServiceConnector->SubscribeDeltas();
+
+	bondPricingServiceConnector->Subscribe();
+
+
+    
+	return 0;
+}
+
@@ -0,0 +1,580 @@
+/**
+ * asynclistener.hpp
+ * Opt-in asynchronous dispatch for ServiceListener edges.
+ * An AsyncServiceListener wraps an existing listener; events are copied into a
+ * bounded lock-free ring buffer and delivered to the wrapped listener on a
+ * dedicated thread, so the publishing Service never runs the listener's work.
+ */
+#ifndef ASYNC_LISTENER_HPP
+#define ASYNC_LISTENER_HPP
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <boost/optional.hpp>
+#include "soa.hpp"
+
+using namespace std;
+
+// What a producer does when the queue of a listener edge is full
+enum OverflowPolicy { BLOCK, DROP_OLDEST };
+
+// Wait a little longer each time a polling loop finds nothing to do: yield for a while, then sleep
+inline void IdleBackoff(int &idle)
+{
+  if (++idle < 64) this_thread::yield();
+  else this_thread::sleep_for(chrono::microseconds(50));
+}
+
+/**
+ * Bounded ring buffer for one producer and one consumer thread.
+ * Slots carry sequence numbers (Vyukov style) so that, besides the consumer,
+ * the producer itself may discard the oldest element when the buffer is full.
+ * Type V need only be copy constructible.
+ */
+template<typename V>
+class SpscQueue
+{
+
+public:
+
+  // ctor; capacity is rounded up to a power of two
+  SpscQueue(size_t capacity);
+  ~SpscQueue();
+
+  // Copy an element in; returns false if the queue is full
+  bool TryPush(const V &data);
+
+  // Call f(V&) on the oldest element in place and then release it; returns false if the queue is empty
+  template<typename F>
+  bool TryConsume(F f);
+
+  // Number of elements currently queued
+  size_t Size() const;
+
+  // Maximum number of elements
+  size_t Capacity() const;
+
+private:
+  struct Slot
+  {
+    atomic<size_t> sequence;
+    typename aligned_storage<sizeof(V), alignof(V)>::type storage;
+  };
+
+  Slot *slots;
+  size_t mask;
+  alignas(64) atomic<size_t> enqueuePos;
+  alignas(64) atomic<size_t> dequeuePos;
+
+  SpscQueue(const SpscQueue&);
+  SpscQueue& operator=(const SpscQueue&);
+
+};
+
+/**
+ * Listener decorator backed by an SpscQueue drained by its own thread.
+ * Register it on a Service in place of the wrapped listener:
+ *   service->AddListener(new AsyncServiceListener<V>(listener, 4096, DROP_OLDEST));
+ * With DROP_OLDEST, an event arriving while the queue is full discards the
+ * oldest queued event and takes its place. For per-product conflation use a
+ * ConflatingServiceListener instead.
+ * Type V is the data type of the listener.
+ */
+template<typename V>
+class AsyncServiceListener : public ServiceListener<V>
+{
+
+public:
+
+  // ctor starts the dispatch thread
+  AsyncServiceListener(ServiceListener<V> *_listener, size_t capacity = 1024, OverflowPolicy _policy = BLOCK);
+
+  // dtor delivers everything queued and joins the dispatch thread
+  ~AsyncServiceListener();
+
+  // Listener callbacks; the data is copied and queued for the wrapped listener
+  void ProcessAdd(V &data);
+  void ProcessRemove(V &data);
+  void ProcessUpdate(V &data);
+
+  // Block until every event queued so far has been delivered
+  void Drain();
+
+  // Deliver everything queued and stop the dispatch thread
+  void Stop();
+
+  // Get the wrapped listener
+  ServiceListener<V>* GetListener() const;
+
+  // Get the overflow policy
+  OverflowPolicy GetPolicy() const;
+
+  // Queue depth counters
+  size_t GetQueueDepth() const;
+  size_t GetMaxQueueDepth() const;
+  unsigned long GetEnqueued() const;
+  unsigned long GetDelivered() const;
+  unsigned long GetDropped() const;
+
+private:
+  enum EventType { ADD_EVENT, REMOVE_EVENT, UPDATE_EVENT };
+
+  struct Event
+  {
+    EventType type;
+    V data;
+    Event(EventType _type, const V &_data) : type(_type), data(_data) {}
+  };
+
+  void Enqueue(EventType type, V &data);
+  void Deliver(Event &event);
+  void Run();
+
+  ServiceListener<V> *listener;
+  OverflowPolicy policy;
+  SpscQueue<Event> queue;
+  atomic<bool> running;
+  atomic<size_t> maxDepth;
+  atomic<unsigned long> enqueued;
+  atomic<unsigned long> delivered;
+  atomic<unsigned long> dropped;
+  thread worker;
+
+};
+
+/**
+ * Listener decorator that conflates per key on its own dispatch thread.
+ * While the wrapped listener is busy, a newer event for a key replaces the
+ * pending one instead of queueing behind it; keys are delivered in the order
+ * their pending event first arrived. Suited to consumers that only care
+ * about the latest value per product, such as a GUI.
+ * Type V is the data type of the listener; type K is the conflation key.
+ */
+template<typename V, typename K = string>
+class ConflatingServiceListener : public ServiceListener<V>
+{
+
+public:
+
+  // ctor starts the dispatch thread; key maps an event to its conflation key
+  ConflatingServiceListener(ServiceListener<V> *_listener, function<K(const V&)> _key);
+
+  // dtor delivers everything pending and joins the dispatch thread
+  ~ConflatingServiceListener();
+
+  // Listener callbacks; the data replaces any event still pending for its key
+  void ProcessAdd(V &data);
+  void ProcessRemove(V &data);
+  void ProcessUpdate(V &data);
+
+  // Block until every pending event has been delivered
+  void Drain();
+
+  // Deliver everything pending and stop the dispatch thread
+  void Stop();
+
+  // Get the wrapped listener
+  ServiceListener<V>* GetListener() const;
+
+  // Number of keys with an event waiting
+  size_t GetPendingKeys() const;
+
+  // Counters
+  unsigned long GetReceived() const;
+  unsigned long GetDelivered() const;
+  unsigned long GetConflated() const;
+
+private:
+  enum EventType { ADD_EVENT, REMOVE_EVENT, UPDATE_EVENT };
+
+  struct Slot
+  {
+    boost::optional<V> data;
+    EventType type;
+  };
+
+  void Enqueue(EventType type, V &data);
+  void Run();
+
+  ServiceListener<V> *listener;
+  function<K(const V&)> key;
+  unordered_map<K, size_t> index;
+  vector<Slot> slots;
+  deque<size_t> ready;
+  mutable mutex lock;
+  condition_variable wake;
+  condition_variable idle;
+  bool running;
+  bool busy;
+  unsigned long received;
+  unsigned long delivered;
+  unsigned long conflated;
+  thread worker;
+
+};
+
+template<typename V>
+SpscQueue<V>::SpscQueue(size_t capacity)
+{
+  size_t size = 2;
+  while (size < capacity) size <<= 1;
+  mask = size - 1;
+  slots = new Slot[size];
+  for (size_t i = 0; i < size; ++i) slots[i].sequence.store(i, memory_order_relaxed);
+  enqueuePos.store(0, memory_order_relaxed);
+  dequeuePos.store(0, memory_order_relaxed);
+}
+
+template<typename V>
+SpscQueue<V>::~SpscQueue()
+{
+  while (TryConsume([](V&) {}));
+  delete[] slots;
+}
+
+template<typename V>
+bool SpscQueue<V>::TryPush(const V &data)
+{
+  size_t pos = enqueuePos.load(memory_order_relaxed);
+  Slot &slot = slots[pos & mask];
+  if (slot.sequence.load(memory_order_acquire) != pos) return false;
+  new (&slot.storage) V(data);
+  enqueuePos.store(pos + 1, memory_order_relaxed);
+  slot.sequence.store(pos + 1, memory_order_release);
+  return true;
+}
+
+template<typename V>
+template<typename F>
+bool SpscQueue<V>::TryConsume(F f)
+{
+  size_t pos = dequeuePos.load(memory_order_relaxed);
+  for (;;) {
+    Slot &slot = slots[pos & mask];
+    size_t sequence = slot.sequence.load(memory_order_acquire);
+    if (sequence == pos + 1) {
+      // the producer may also be discarding from this end, so claim the slot first
+      if (dequeuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+        V *data = reinterpret_cast<V*>(&slot.storage);
+        f(*data);
+        data->~V();
+        slot.sequence.store(pos + mask + 1, memory_order_release);
+        return true;
+      }
+    }
+    else if (sequence < pos + 1) {
+      return false;
+    }
+    else {
+      pos = dequeuePos.load(memory_order_relaxed);
+    }
+  }
+}
+
+template<typename V>
+size_t SpscQueue<V>::Size() const
+{
+  size_t tail = enqueuePos.load(memory_order_acquire);
+  size_t head = dequeuePos.load(memory_order_acquire);
+  return tail > head ? tail - head : 0;
+}
+
+template<typename V>
+size_t SpscQueue<V>::Capacity() const
+{
+  return mask + 1;
+}
+
+template<typename V>
+AsyncServiceListener<V>::AsyncServiceListener(ServiceListener<V> *_listener, size_t capacity, OverflowPolicy _policy) :
+  listener(_listener), policy(_policy), queue(capacity), running(true),
+  maxDepth(0), enqueued(0), delivered(0), dropped(0)
+{
+  worker = thread(&AsyncServiceListener<V>::Run, this);
+}
+
+template<typename V>
+AsyncServiceListener<V>::~AsyncServiceListener()
+{
+  Stop();
+}
+
+template<typename V>
+void AsyncServiceListener<V>::ProcessAdd(V &data)
+{
+  Enqueue(ADD_EVENT, data);
+}
+
+template<typename V>
+void AsyncServiceListener<V>::ProcessRemove(V &data)
+{
+  Enqueue(REMOVE_EVENT, data);
+}
+
+template<typename V>
+void AsyncServiceListener<V>::ProcessUpdate(V &data)
+{
+  Enqueue(UPDATE_EVENT, data);
+}
+
+template<typename V>
+void AsyncServiceListener<V>::Drain()
+{
+  while (delivered.load() + dropped.load() < enqueued.load()) this_thread::yield();
+}
+
+template<typename V>
+void AsyncServiceListener<V>::Stop()
+{
+  if (!worker.joinable()) return;
+  Drain();
+  running.store(false);
+  worker.join();
+}
+
+template<typename V>
+ServiceListener<V>* AsyncServiceListener<V>::GetListener() const
+{
+  return listener;
+}
+
+template<typename V>
+OverflowPolicy AsyncServiceListener<V>::GetPolicy() const
+{
+  return policy;
+}
+
+template<typename V>
+size_t AsyncServiceListener<V>::GetQueueDepth() const
+{
+  return queue.Size();
+}
+
+template<typename V>
+size_t AsyncServiceListener<V>::GetMaxQueueDepth() const
+{
+  return maxDepth.load();
+}
+
+template<typename V>
+unsigned long AsyncServiceListener<V>::GetEnqueued() const
+{
+  return enqueued.load();
+}
+
+template<typename V>
+unsigned long AsyncServiceListener<V>::GetDelivered() const
+{
+  return delivered.load();
+}
+
+template<typename V>
+unsigned long AsyncServiceListener<V>::GetDropped() const
+{
+  return dropped.load();
+}
+
+template<typename V>
+void AsyncServiceListener<V>::Enqueue(EventType type, V &data)
+{
+  Event event(type, data);
+  enqueued.fetch_add(1);
+
+  // DROP_OLDEST discards one event per overflow; the push may still have to wait for
+  // the consumer to finish delivering the event at the head and release its slot
+  bool discarded = false;
+  int idle = 0;
+  while (!queue.TryPush(event)) {
+    if (policy == DROP_OLDEST && !discarded) {
+      discarded = true;
+      if (queue.TryConsume([](Event&) {})) dropped.fetch_add(1);
+    }
+    else {
+      IdleBackoff(idle);
+    }
+  }
+
+  size_t depth = GetQueueDepth();
+  size_t seen = maxDepth.load(memory_order_relaxed);
+  while (depth > seen && !maxDepth.compare_exchange_weak(seen, depth, memory_order_relaxed));
+}
+
+template<typename V>
+void AsyncServiceListener<V>::Deliver(Event &event)
+{
+  switch (event.type) {
+  case ADD_EVENT: listener->ProcessAdd(event.data); break;
+  case REMOVE_EVENT: listener->ProcessRemove(event.data); break;
+  case UPDATE_EVENT: listener->ProcessUpdate(event.data); break;
+  }
+  delivered.fetch_add(1);
+}
+
+template<typename V>
+void AsyncServiceListener<V>::Run()
+{
+  int idle = 0;
+  for (;;) {
+    if (queue.TryConsume([this](Event &event) { Deliver(event); })) {
+      idle = 0;
+    }
+    else if (!running.load()) {
+      return;
+    }
+    else {
+      IdleBackoff(idle);
+    }
+  }
+}
+
+template<typename V, typename K>
+ConflatingServiceListener<V, K>::ConflatingServiceListener(ServiceListener<V> *_listener, function<K(const V&)> _key) :
+  listener(_listener), key(_key), running(true), busy(false), received(0), delivered(0), conflated(0)
+{
+  worker = thread(&ConflatingServiceListener<V, K>::Run, this);
+}
+
+template<typename V, typename K>
+ConflatingServiceListener<V, K>::~ConflatingServiceListener()
+{
+  Stop();
+}
+
+template<typename V, typename K>
+void ConflatingServiceListener<V, K>::ProcessAdd(V &data)
+{
+  Enqueue(ADD_EVENT, data);
+}
+
+template<typename V, typename K>
+void ConflatingServiceListener<V, K>::ProcessRemove(V &data)
+{
+  Enqueue(REMOVE_EVENT, data);
+}
+
+template<typename V, typename K>
+void ConflatingServiceListener<V, K>::ProcessUpdate(V &data)
+{
+  Enqueue(UPDATE_EVENT, data);
+}
+
+template<typename V, typename K>
+void ConflatingServiceListener<V, K>::Drain()
+{
+  unique_lock<mutex> guard(lock);
+  idle.wait(guard, [this]() { return ready.empty() && !busy; });
+}
+
+template<typename V, typename K>
+void ConflatingServiceListener<V, K>::Stop()
+{
+  if (!worker.joinable()) return;
+  Drain();
+  {
+    lock_guard<mutex> guard(lock);
+    running = false;
+  }
+  wake.notify_one();
+  worker.join();
+}
+
+template<typename V, typename K>
+ServiceListener<V>* ConflatingServiceListener<V, K>::GetListener() const
+{
+  return listener;
+}
+
+template<typename V, typename K>
+size_t ConflatingServiceListener<V, K>::GetPendingKeys() const
+{
+  lock_guard<mutex> guard(lock);
+  return ready.size();
+}
+
+template<typename V, typename K>
+unsigned long ConflatingServiceListener<V, K>::GetReceived() const
+{
+  lock_guard<mutex> guard(lock);
+  return received;
+}
+
+template<typename V, typename K>
+unsigned long ConflatingServiceListener<V, K>::GetDelivered() const
+{
+  lock_guard<mutex> guard(lock);
+  return delivered;
+}
+
+template<typename V, typename K>
+unsigned long ConflatingServiceListener<V, K>::GetConflated() const
+{
+  lock_guard<mutex> guard(lock);
+  return conflated;
+}
+
+template<typename V, typename K>
+void ConflatingServiceListener<V, K>::Enqueue(EventType type, V &data)
+{
+  K k = key(data);
+  {
+    lock_guard<mutex> guard(lock);
+    ++received;
+
+    auto it = index.find(k);
+    if (it == index.end()) {
+      it = index.insert(make_pair(k, slots.size())).first;
+      slots.push_back(Slot());
+    }
+
+    Slot &slot = slots[it->second];
+    if (slot.data) ++conflated;
+    else ready.push_back(it->second);
+    slot.data.reset();
+    slot.data.emplace(data);
+    slot.type = type;
+  }
+  wake.notify_one();
+}
+
+template<typename V, typename K>
+void ConflatingServiceListener<V, K>::Run()
+{
+  unique_lock<mutex> guard(lock);
+  for (;;) {
+    wake.wait(guard, [this]() { return !ready.empty() || !running; });
+    if (ready.empty()) return;
+
+    Slot &slot = slots[ready.front()];
+    ready.pop_front();
+    V data(*slot.data);
+    EventType type = slot.type;
+    slot.data.reset();
+    busy = true;
+
+    // deliver outside the lock so producers only ever wait for the bookkeeping above
+    guard.unlock();
+    switch (type) {
+    case ADD_EVENT: listener->ProcessAdd(data); break;
+    case REMOVE_EVENT: listener->ProcessRemove(data); break;
+    case UPDATE_EVENT: listener->ProcessUpdate(data); break;
+    }
+    guard.lock();
+
+    busy = false;
+    ++delivered;
+    if (ready.empty()) idle.notify_all();
+  }
+}
+
+#endif
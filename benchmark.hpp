@@ -0,0 +1,2222 @@
+/**
+ * benchmark.hpp
+ * Micro-benchmarks for the hot paths of the trading system.
+ * Run with "BondTradingSystem benchmark"; results are printed to stdout.
+ */
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <list>
+#include <map>
+#include "priceformat.hpp"
+#include "csvreader.hpp"
+#include "marketdataservice.hpp"
+#include "persistence.hpp"
+#include "journal.hpp"
+#include "tradebookingservice.hpp"
+#include "keyedstore.hpp"
+#include "pv01engine.hpp"
+#include "riskservice.hpp"
+#include "scenarioengine.hpp"
+#include "shardedpositionservice.hpp"
+#include "executionservice.hpp"
+#include "streamingservice.hpp"
+#include "limitorderbook.hpp"
+
+using namespace std;
+
+// Seconds taken by a single call of f
+template<typename F>
+double time_it(F f)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	f();
+
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const string &name, double seconds, long ops)
+{
+	std::cout << "  " << name << ": " << ops / seconds / 1e6 << " M ops/sec, " << seconds * 1e9 / ops << " ns/op" << std::endl;
+}
+
+// Number of benchmark checks that failed; run_benchmarks returns it
+int benchmarkFailures = 0;
+
+// Print a FAIL line and count it unless ok
+void check(const string &what, bool ok)
+{
+	if (ok) return;
+
+	std::cout << "  FAIL: " << what << std::endl;
+
+	++benchmarkFailures;
+}
+
+// Counting heap allocations means replacing the global operator new for the whole program,
+// so it is only compiled in when COUNT_ALLOCATIONS is defined, for benchmark builds
+#ifdef COUNT_ALLOCATIONS
+
+// Heap allocations made by the calling thread, so that a benchmark can check that a path
+// allocates nothing once it has warmed up
+thread_local long heapAllocations = 0;
+
+// gcc would inline these into their callers and then warn that memory from new is passed to free
+#ifdef __GNUC__
+#define ALLOCATION_HOOK __attribute__((noinline))
+#else
+#define ALLOCATION_HOOK
+#endif
+
+ALLOCATION_HOOK void* operator new(size_t size)
+{
+	++heapAllocations;
+
+	if (void *p = std::malloc(size ? size : 1)) return p;
+
+	throw std::bad_alloc();
+}
+
+ALLOCATION_HOOK void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+ALLOCATION_HOOK void operator delete(void *p, size_t) noexcept
+{
+	std::free(p);
+}
+
+#endif
+
+
+void price_format_benchmark() {
+
+	// the String2Price lambda previously copied into every connector
+	auto LegacyString2Price = [](std::string& str) {
+
+		size_t idx = str.find_first_of('-');
+
+		double result = std::stoi(str.substr(0, idx));
+
+		int num1 = std::stoi(str.substr(idx + 1, 2));
+
+		char ch = str[str.size() - 1];
+
+		if (ch == '+') ch = '4';
+
+		int num2 = ch - '0';
+
+		result += (num1 * 8 + num2) / 256.0;
+
+		return result;
+
+	};
+
+	const int N = 1 << 12, ROUNDS = 500;
+
+	std::vector<std::string> prices;
+
+	for (int i = 0; i < N; ++i) prices.push_back(Ticks2String(99 * TICKS_PER_POINT + rand() % (256 * 2 + 1)));
+
+	double sink = 0;
+
+	std::cout << "Fractional price parsing (" << N * ROUNDS << " prices)" << std::endl;
+
+	report("legacy lambda", time_it([&]() {
+
+		for (int r = 0; r < ROUNDS; ++r) for (auto& p : prices) sink += LegacyString2Price(p);
+
+	}), N * ROUNDS);
+
+	report("String2Price", time_it([&]() {
+
+		for (int r = 0; r < ROUNDS; ++r) for (auto& p : prices) sink += String2Price(p);
+
+	}), N * ROUNDS);
+
+	report("ParsePriceTicks", time_it([&]() {
+
+		long ticks = 0;
+
+		for (int r = 0; r < ROUNDS; ++r) for (auto& p : prices) {
+
+			ParsePriceTicks(p.data(), p.data() + p.size(), ticks);
+
+			sink += ticks;
+
+		}
+
+	}), N * ROUNDS);
+
+	char buf[PRICE_STRING_SIZE];
+
+	report("FormatPriceTicks", time_it([&]() {
+
+		for (int r = 0; r < ROUNDS; ++r) for (int i = 0; i < N; ++i) sink += FormatPriceTicks(99 * TICKS_PER_POINT + i % 512, buf);
+
+	}), N * ROUNDS);
+
+	std::cout << "  (checksum " << sink << ")\n" << std::endl;
+
+}
+
+
+void csv_ingestion_benchmark() {
+
+	const int ROWS = 500000;
+
+	const char* path = "benchmark_prices.txt";
+
+	{
+
+		std::ofstream file(path, std::ios::out | std::ios::trunc);
+
+		file << "CUSIP,mid,bidofferspread\n";
+
+		for (int i = 0; i < ROWS; ++i) {
+
+			file << "9128283H1," << Ticks2String(99 * TICKS_PER_POINT + rand() % 512) << ",0-00" << (i % 3 == 0 ? "+" : "2") << "\n";
+
+		}
+
+	}
+
+	std::ifstream probe(path, std::ios::binary | std::ios::ate);
+
+	double mb = probe.tellg() / 1e6;
+
+	double sink = 0;
+
+	std::cout << "Price file ingestion (" << ROWS << " rows, " << mb << " MB)" << std::endl;
+
+	auto report_rows = [&](const string& name, double seconds) {
+
+		std::cout << "  " << name << ": " << ROWS / seconds / 1e6 << " M rows/sec, " << mb / seconds << " MB/sec" << std::endl;
+
+	};
+
+	report_rows("ifstream + SplitLine", time_it([&]() {
+
+		auto SplitLine = [](std::string& line) {
+
+			stringstream enter_line(line);
+
+			std::string item;
+
+			std::vector<std::string> tmp;
+
+			while (getline(enter_line, item, ',')) 	tmp.push_back(item);
+
+			return tmp;
+
+		};
+
+		ifstream file(path);
+
+		string line;
+
+		getline(file, line);
+
+		while (getline(file, line)) {
+
+			std::vector<std::string> elems = SplitLine(line);
+
+			sink += String2Price(elems[1]) + String2Price(elems[2]) + elems[0].size();
+
+		}
+
+	}));
+
+	report_rows("MappedCsvReader", time_it([&]() {
+
+		MappedCsvReader reader(path);
+
+		reader.ForEachRow([&](const CsvField* elems, size_t count) {
+
+			sink += String2Price(elems[1].first, elems[1].last) + String2Price(elems[2].first, elems[2].last) + elems[0].Size();
+
+			return true;
+
+		});
+
+	}));
+
+	std::cout << "  (checksum " << sink << ")\n" << std::endl;
+
+	std::remove(path);
+
+}
+
+
+void order_book_benchmark() {
+
+	const int N = 1 << 10, ROUNDS = 1000;
+
+	Bond bond("9128283H1", CUSIP, "T", 0, date(2019, 11, 30));
+
+	std::vector<FixedPrice> prices;
+
+	for (int i = 0; i < N; ++i) prices.push_back(FixedPrice::FromTicks(99 * TICKS_PER_POINT + rand() % 512));
+
+	double sink = 0;
+
+	std::cout << "Order book construction and top-of-book reads (" << N * ROUNDS << " books)" << std::endl;
+
+	std::vector<OrderBook<Bond>> books;
+
+	report("OrderBook construct", time_it([&]() {
+
+		for (int r = 0; r < ROUNDS; ++r) {
+
+			books.clear();
+
+			for (int i = 0; i < N; ++i) {
+
+				vector<Order> bid_stack, offer_stack;
+
+				for (int k = 0; k < 5; ++k) {
+
+					bid_stack.push_back(Order(prices[i] - k * ONE_TICK, 1000000 * (k + 1), BID));
+
+					offer_stack.push_back(Order(prices[i] + (k + 1) * ONE_TICK, 1000000 * (k + 1), OFFER));
+
+				}
+
+				books.push_back(OrderBook<Bond>(bond, bid_stack, offer_stack));
+
+			}
+
+		}
+
+	}), N * ROUNDS);
+
+	std::vector<BondFlatOrderBook> flat_books;
+
+	report("FlatOrderBook construct", time_it([&]() {
+
+		for (int r = 0; r < ROUNDS; ++r) {
+
+			flat_books.clear();
+
+			for (int i = 0; i < N; ++i) {
+
+				BondFlatOrderBook book(bond);
+
+				for (int k = 0; k < 5; ++k) {
+
+					book.SetBid(k, prices[i] - k * ONE_TICK, 1000000 * (k + 1));
+
+					book.SetOffer(k, prices[i] + (k + 1) * ONE_TICK, 1000000 * (k + 1));
+
+				}
+
+				flat_books.push_back(book);
+
+			}
+
+		}
+
+	}), N * ROUNDS);
+
+	report("OrderBook top of book", time_it([&]() {
+
+		for (int r = 0; r < ROUNDS; ++r) for (auto& b : books) sink += (b.GetOfferStack()[0].GetPrice() - b.GetBidStack()[0].GetPrice()).ToDouble();
+
+	}), N * ROUNDS);
+
+	report("FlatOrderBook top of book", time_it([&]() {
+
+		for (int r = 0; r < ROUNDS; ++r) for (auto& b : flat_books) sink += (b.GetOfferPrice(0) - b.GetBidPrice(0)).ToDouble();
+
+	}), N * ROUNDS);
+
+	std::cout << "  sizeof(OrderBook<Bond>) = " << sizeof(OrderBook<Bond>) << " + 2 heap stacks, sizeof(BondFlatOrderBook) = " << sizeof(BondFlatOrderBook) << std::endl;
+
+	std::cout << "  (checksum " << sink << ")\n" << std::endl;
+
+}
+
+
+void persistence_benchmark() {
+
+	const int RECORDS = 20000;
+
+	const char* legacy_path = "benchmark_legacy.txt";
+
+	const char* buffered_path = "benchmark_buffered.txt";
+
+	std::remove(legacy_path);
+
+	std::remove(buffered_path);
+
+	std::string cus_id = "9128283H1";
+
+	std::cout << "Historical record persistence (" << RECORDS << " records)" << std::endl;
+
+	auto report_records = [&](const string& name, double seconds) {
+
+		std::cout << "  " << name << ": " << RECORDS / seconds / 1e3 << " K records/sec" << std::endl;
+
+	};
+
+	report_records("ofstream per record", time_it([&]() {
+
+		for (int i = 0; i < RECORDS; ++i) {
+
+			ofstream os(legacy_path, ios_base::app);
+
+			std::string msg = "The bond " + cus_id + " has bid price " + std::to_string(99 + i / 256.0) +
+
+				" and offer price " + std::to_string(99 + (i + 1) / 256.0);
+
+			os << msg << endl;
+
+		}
+
+	}));
+
+	auto engine = PersistenceEngine::instance();
+
+	BufferedFileWriter* writer = engine->GetWriter(buffered_path);
+
+	report_records("PersistenceEngine", time_it([&]() {
+
+		for (int i = 0; i < RECORDS; ++i) {
+
+			writer->AppendFormat("The bond %s has bid price %f and offer price %f\n", cus_id.c_str(), 99 + i / 256.0, 99 + (i + 1) / 256.0);
+
+		}
+
+		engine->Flush();
+
+	}));
+
+	std::cout << std::endl;
+
+	std::remove(legacy_path);
+
+	std::remove(buffered_path);
+
+}
+
+
+void journal_benchmark() {
+
+	const int RECORDS = 200000;
+
+	const char* text_path = "benchmark_streaming.txt";
+
+	const char* journal_path = "benchmark_streaming.jnl";
+
+	std::remove(text_path);
+
+	std::remove(journal_path);
+
+	Bond bond("9128283H1", CUSIP, "T", 0, date(2019, 11, 30));
+
+	std::vector<PriceStream<Bond>> streams;
+
+	for (int i = 0; i < 1024; ++i) {
+
+		FixedPrice mid = FixedPrice::FromTicks(99 * TICKS_PER_POINT + rand() % 512);
+
+		streams.push_back(PriceStream<Bond>(bond, PriceStreamOrder(mid - ONE_TICK, 1000000, 2000000, BID), PriceStreamOrder(mid + ONE_TICK, 1000000, 2000000, OFFER)));
+
+	}
+
+	std::cout << "Historical stream records, text vs binary journal (" << RECORDS << " records)" << std::endl;
+
+	auto engine = PersistenceEngine::instance();
+
+	BufferedFileWriter* writer = engine->GetWriter(text_path);
+
+	double text_seconds = time_it([&]() {
+
+		for (int i = 0; i < RECORDS; ++i) {
+
+			auto& data = streams[i % streams.size()];
+
+			writer->AppendFormat(STREAM_TEXT_FORMAT, data.GetProduct().GetProductId().c_str(), data.GetBidOrder().GetPrice().ToDouble(), data.GetOfferOrder().GetPrice().ToDouble());
+
+		}
+
+		engine->Flush();
+
+	});
+
+	JournalWriter journal(journal_path);
+
+	double journal_seconds = time_it([&]() {
+
+		for (int i = 0; i < RECORDS; ++i) journal.Write(streams[i % streams.size()]);
+
+		engine->Flush();
+
+	});
+
+	report("text AppendFormat", text_seconds, RECORDS);
+
+	report("JournalWriter", journal_seconds, RECORDS);
+
+	std::cout << "  bytes/record: text " << writer->GetBytesWritten() / double(RECORDS) << ", journal " << journal.GetWriter()->GetBytesWritten() / double(RECORDS) << std::endl;
+
+	std::ostringstream text;
+
+	size_t records = 0;
+
+	report("JournalReader ToText", time_it([&]() { records = JournalReader(journal_path).ToText(text); }), RECORDS);
+
+	std::ifstream original(text_path);
+
+	std::ostringstream expected;
+
+	expected << original.rdbuf();
+
+	bool matches = (records == size_t(RECORDS) && text.str() == expected.str());
+
+	std::cout << "  round trip " << (matches ? "matches" : "DIFFERS from") << " the text file\n" << std::endl;
+
+	check("the journal read back as text differs from the text file", matches);
+
+	std::remove(text_path);
+
+	std::remove(journal_path);
+
+}
+
+
+void product_handle_benchmark() {
+
+	// the layout Trade<Bond> had while it held its own copy of the bond
+	struct LegacyTrade {
+
+		Bond product;
+
+		string tradeId;
+
+		double price;
+
+		string book;
+
+		long quantity;
+
+		Side side;
+
+	};
+
+	const int N = 1 << 10, ROUNDS = 2000;
+
+	Bond bond("9128283H1", CUSIP, "T", 0, date(2019, 11, 30));
+
+	std::vector<LegacyTrade> legacy_trades;
+
+	std::vector<Trade<Bond>> trades;
+
+	for (int i = 0; i < N; ++i) {
+
+		legacy_trades.push_back(LegacyTrade{ bond, "T" + std::to_string(i), 99.5, "TRSY1", 1000000, BUY });
+
+		trades.push_back(Trade<Bond>(bond, "T" + std::to_string(i), FixedPrice::FromDouble(99.5), "TRSY1", 1000000, BUY));
+
+	}
+
+	double sink = 0;
+
+	std::cout << "Message copies through a listener hop (" << N * ROUNDS << " trades)" << std::endl;
+
+	report("trade holding a Bond copy", time_it([&]() {
+
+		for (int r = 0; r < ROUNDS; ++r) for (auto& t : legacy_trades) {
+
+			LegacyTrade copy(t);
+
+			sink += copy.price + copy.product.GetProductId().size();
+
+		}
+
+	}), N * ROUNDS);
+
+	report("trade holding a registry handle", time_it([&]() {
+
+		for (int r = 0; r < ROUNDS; ++r) for (auto& t : trades) {
+
+			Trade<Bond> copy(t);
+
+			sink += copy.GetPrice().ToDouble() + copy.GetProduct().GetProductId().size();
+
+		}
+
+	}), N * ROUNDS);
+
+	report("Trade construction (interning)", time_it([&]() {
+
+		for (int r = 0; r < ROUNDS; ++r) for (auto& t : trades) {
+
+			Trade<Bond> copy(bond, t.GetTradeId(), t.GetPrice(), t.GetBook(), t.GetQuantity(), t.GetSide());
+
+			sink += copy.GetPrice().ToDouble();
+
+		}
+
+	}), N * ROUNDS);
+
+	std::cout << "  sizeof(Bond) = " << sizeof(Bond) << ", legacy trade = " << sizeof(LegacyTrade) << ", Trade<Bond> = " << sizeof(Trade<Bond>) << std::endl;
+
+	std::cout << "  (checksum " << sink << ")\n" << std::endl;
+
+}
+
+
+void keyed_store_benchmark() {
+
+	const int N = 20000, LOOKUPS = 2000000;
+
+	std::vector<std::string> cusips;
+
+	char buf[16];
+
+	for (int i = 0; i < N; ++i) {
+
+		snprintf(buf, sizeof(buf), "91282%04dX", i);
+
+		cusips.push_back(buf);
+
+	}
+
+	std::map<std::string, double> tree;
+
+	KeyedStore<std::string, double> store;
+
+	store.reserve(N);
+
+	for (int i = 0; i < N; ++i) {
+
+		tree[cusips[i]] = i;
+
+		store[cusips[i]] = i;
+
+	}
+
+	std::vector<int> keys;
+
+	for (int i = 0; i < LOOKUPS; ++i) keys.push_back(rand() % N);
+
+	double sink = 0;
+
+	std::cout << "Service store lookups (" << N << " CUSIPs, " << LOOKUPS << " lookups)" << std::endl;
+
+	report("std::map at", time_it([&]() {
+
+		for (int k : keys) sink += tree.at(cusips[k]);
+
+	}), LOOKUPS);
+
+	report("KeyedStore at", time_it([&]() {
+
+		for (int k : keys) sink += store.at(cusips[k]);
+
+	}), LOOKUPS);
+
+	report("KeyedStore AtIndex", time_it([&]() {
+
+		for (int k : keys) sink += store.AtIndex(k);
+
+	}), LOOKUPS);
+
+	std::cout << "  (checksum " << sink << ")\n" << std::endl;
+
+}
+
+
+void pv01_benchmark() {
+
+	const int N = 20000, ROUNDS = 50;
+
+	date settlement(2017, 12, 15);
+
+	PV01Engine engine(settlement);
+
+	std::vector<Bond> bonds;
+
+	for (int i = 0; i < N; ++i) {
+
+		char cusip[16];
+
+		snprintf(cusip, sizeof(cusip), "BM%07d", i);
+
+		bonds.push_back(Bond(cusip, CUSIP, "T", (rand() % 25) / 400.0f, settlement + days(30 + rand() % (30 * 365))));
+
+		engine.AddBond(bonds.back(), 0.01 + (rand() % 300) / 10000.0);
+
+	}
+
+	// walk the schedule for every bond and price each flow with its own pow, as a straightforward pricer would
+	auto naive_pv01 = [&](const Bond& bond, double yield) {
+
+		int payments = 0;
+
+		while (bond.GetMaturityDate() - months(6 * payments) > settlement) ++payments;
+
+		if (payments == 0) return 0.0;
+
+		date next = bond.GetMaturityDate() - months(6 * (payments - 1));
+
+		double first = static_cast<double>((next - settlement).days()) / (next - (bond.GetMaturityDate() - months(6 * payments))).days();
+
+		double growth = 1 + yield / 2, weighted = 0;
+
+		for (int k = 0; k < payments; ++k) {
+
+			double periods = first + k;
+
+			double amount = bond.GetCoupon() / 2.0 + (k + 1 == payments ? 1 : 0);
+
+			weighted += periods * amount * pow(growth, -periods);
+
+		}
+
+		return weighted / growth / 2 * 1e-4;
+
+	};
+
+	double sink = 0;
+
+	std::cout << "Full book PV01 (" << N << " bonds)" << std::endl;
+
+	auto report_bonds = [&](const string& name, double seconds, long bonds) {
+
+		std::cout << "  " << name << ": " << bonds / seconds / 1e6 << " M bonds/sec, " << seconds * 1e6 / (bonds / N) << " us per full book" << std::endl;
+
+	};
+
+	report_bonds("schedule walk + pow per flow", time_it([&]() {
+
+		for (int i = 0; i < N; ++i) sink += naive_pv01(bonds[i], engine.GetYield(i));
+
+	}), N);
+
+	report_bonds("PV01Engine::Compute", time_it([&]() {
+
+		for (int r = 0; r < ROUNDS; ++r) {
+
+			engine.ShiftYields(r % 2 ? 0.0001 : -0.0001);
+
+			engine.Compute();
+
+			sink += engine.GetUnitPV01(r % N);
+
+		}
+
+	}), long(N) * ROUNDS);
+
+	double worst = 0;
+
+	for (int i = 0; i < N; ++i) worst = std::max(worst, std::fabs(naive_pv01(bonds[i], engine.GetYield(i)) - engine.GetUnitPV01(i)) / engine.GetUnitPV01(i));
+
+	std::cout << "  largest relative difference from the per-flow pricer: " << worst << std::endl;
+
+	check("PV01Engine differs from the per-flow pricer by more than 1e-12", worst <= 1e-12);
+
+	std::cout << "  (checksum " << sink << ")\n" << std::endl;
+
+}
+
+
+void sector_risk_benchmark() {
+
+	const int N = 2000, SECTORS = 400, PER_SECTOR = 50, POLLS = 50, UPDATES = 20000;
+
+	BondRiskService* riskService = BondRiskService::instance();
+
+	std::vector<Bond> bonds;
+
+	for (int i = 0; i < N; ++i) {
+
+		char cusip[16];
+
+		snprintf(cusip, sizeof(cusip), "SR%07d", i);
+
+		bonds.push_back(Bond(cusip, CUSIP, "T", 0.02f, date(2027, 11, 15)));
+
+		PV01<Bond> risk(bonds.back(), (rand() % 1000) / 10.0, 1000000);
+
+		riskService->Add(risk);
+
+	}
+
+	std::vector<BucketedSector<Bond>> sectors;
+
+	for (int s = 0; s < SECTORS; ++s) {
+
+		std::vector<Bond> members;
+
+		for (int k = 0; k < PER_SECTOR; ++k) members.push_back(bonds[rand() % N]);
+
+		sectors.push_back(BucketedSector<Bond>(members, "benchsector" + std::to_string(s)));
+
+		riskService->AddBusketedSector(sectors.back());
+
+	}
+
+	double sink = 0;
+
+	std::cout << "Sector risk (" << SECTORS << " sectors of " << PER_SECTOR << " bonds, " << POLLS << " polls of every sector)" << std::endl;
+
+	report("rescan every sector", time_it([&]() {
+
+		for (int p = 0; p < POLLS; ++p) {
+
+			for (auto& sector : sectors) {
+
+				double total = 0;
+
+				for (auto& b : sector.GetProducts()) total += riskService->GetData(b.GetProductId()).GetPV01();
+
+				sink += total;
+
+			}
+
+		}
+
+	}), long(POLLS) * SECTORS);
+
+	report("GetBucketedRisk running totals", time_it([&]() {
+
+		for (int p = 0; p < POLLS; ++p) {
+
+			for (auto& sector : sectors) sink += riskService->GetBucketedRisk(sector).GetPV01();
+
+		}
+
+	}), long(POLLS) * SECTORS);
+
+	// AddPosition logs to stdout, which is muted while it is timed
+
+	std::streambuf* console = std::cout.rdbuf(nullptr);
+
+	double seconds = time_it([&]() {
+
+		for (int u = 0; u < UPDATES; ++u) {
+
+			Position<Bond> position(bonds[u % N]);
+
+			position.AddPosition("TRSY1", (u % 2 ? 1000 : -1000));
+
+			riskService->AddPosition(position);
+
+		}
+
+	});
+
+	std::cout.rdbuf(console);
+
+	std::cout.clear();
+
+	report("AddPosition with sector deltas", seconds, UPDATES);
+
+	double drift = 0;
+
+	for (auto& sector : sectors) {
+
+		double total = 0;
+
+		for (auto& b : sector.GetProducts()) total += riskService->GetData(b.GetProductId()).GetPV01();
+
+		drift = std::max(drift, std::fabs(total - riskService->GetBucketedRisk(sector).GetPV01()));
+
+	}
+
+	std::cout << "  largest difference between running and rescanned totals: " << drift << std::endl;
+
+	// the running totals only pick up rounding from the deltas, far below a millionth of PV01
+	check("running sector totals drifted from a rescan by more than 1e-6", drift <= 1e-6);
+
+	std::cout << "  (checksum " << sink << ")\n" << std::endl;
+
+}
+
+
+void scenario_benchmark() {
+
+	const int N = 2000, SCENARIOS = 4000, SECTORS = 8;
+
+	date settlement(2017, 12, 15);
+
+	PV01Engine engine(settlement);
+
+	std::vector<std::string> cusips;
+
+	for (int i = 0; i < N; ++i) {
+
+		char cusip[16];
+
+		snprintf(cusip, sizeof(cusip), "SC%07d", i);
+
+		cusips.push_back(cusip);
+
+		engine.AddBond(Bond(cusip, CUSIP, "T", (rand() % 25) / 400.0f, settlement + days(30 + rand() % (30 * 365))), 0.01 + (rand() % 300) / 10000.0);
+
+	}
+
+	engine.Compute();
+
+	// sectors by maturity, positions on every bond, and a mix of parallel, twist and key-rate shocks
+
+	std::vector<std::vector<size_t>> sectors(SECTORS);
+
+	std::vector<long> quantities;
+
+	for (int i = 0; i < N; ++i) {
+
+		sectors[std::min(SECTORS - 1, int(engine.GetMaturityYears(i) / 30 * SECTORS))].push_back(i);
+
+		quantities.push_back((rand() % 100 + 1) * 1000000L);
+
+	}
+
+	std::vector<CurveShock> shocks;
+
+	for (int s = 0; s < SCENARIOS; ++s) {
+
+		double bp = ((rand() % 401) - 200) * 0.0001;
+
+		switch (s % 3) {
+
+		case 0: shocks.push_back(CurveShock("parallel" + std::to_string(s), bp)); break;
+
+		case 1: shocks.push_back(CurveShock("twist" + std::to_string(s), 0, bp / 10)); break;
+
+		default:
+
+			shocks.push_back(CurveShock("keyrate" + std::to_string(s)));
+
+			shocks.back().AddSectorBump("bucket" + std::to_string(s % SECTORS), bp);
+
+		}
+
+	}
+
+	double sink = 0;
+
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+	std::cout << "Curve-shock scenarios (" << SCENARIOS << " scenarios over " << N << " positions, " << cores << " cores)" << std::endl;
+
+	std::vector<unsigned> threadCounts = { 1u };
+
+	if (cores > 1) threadCounts.push_back(cores);
+
+	for (unsigned threads : threadCounts) {
+
+		ScenarioEngine scenarios(engine, threads);
+
+		for (int k = 0; k < SECTORS; ++k) scenarios.AddSector("bucket" + std::to_string(k), sectors[k]);
+
+		for (int i = 0; i < N; ++i) scenarios.AddPosition(cusips[i], i, quantities[i]);
+
+		double seconds = time_it([&]() {
+
+			ScenarioResults results = scenarios.Run(shocks);
+
+			for (int s = 0; s < SCENARIOS; ++s) sink += results.GetTotalPnL(s);
+
+		});
+
+		std::cout << "  ScenarioEngine::Run on " << threads << " thread(s): " << SCENARIOS / seconds << " scenarios/sec, " << seconds * 1e6 / SCENARIOS << " us per scenario" << std::endl;
+
+	}
+
+	// a parallel shock must agree with moving every yield and recomputing the engine
+
+	ScenarioEngine serial(engine, 1);
+
+	for (int k = 0; k < SECTORS; ++k) serial.AddSector("bucket" + std::to_string(k), sectors[k]);
+
+	for (int i = 0; i < N; ++i) serial.AddPosition(cusips[i], i, quantities[i]);
+
+	ScenarioResults results = serial.Run(shocks);
+
+	PV01Engine shifted(engine);
+
+	double worst = 0;
+
+	for (int s = 0; s < 30; s += 3) {
+
+		shifted.ShiftYields(shocks[s].GetParallel());
+
+		shifted.Compute();
+
+		double total = 0;
+
+		for (int i = 0; i < N; ++i) total += (shifted.GetPrice(i) - engine.GetPrice(i)) * quantities[i];
+
+		worst = std::max(worst, std::fabs(total - results.GetTotalPnL(s)) / std::max(1.0, std::fabs(total)));
+
+		shifted.ShiftYields(-shocks[s].GetParallel());
+
+	}
+
+	std::cout << "  largest relative difference from shifting the engine: " << worst << std::endl;
+
+	check("a parallel shock differs from shifting the engine by more than 1e-12", worst <= 1e-12);
+
+	std::cout << "  (checksum " << sink << ")\n" << std::endl;
+
+}
+
+
+void position_benchmark() {
+
+	const int N = 200, TRADES = 1000000;
+
+	std::vector<std::string> cusips;
+
+	std::vector<Bond> bonds;
+
+	for (int i = 0; i < N; ++i) {
+
+		char cusip[16];
+
+		snprintf(cusip, sizeof(cusip), "PS%07d", i);
+
+		cusips.push_back(cusip);
+
+		bonds.push_back(Bond(cusip, CUSIP, "T", 0.02f, date(2027, 11, 15)));
+
+	}
+
+	std::vector<std::string> books = { "TRSY1", "TRSY2", "TRSY3" };
+
+	std::vector<int> tradeBonds, tradeBooks;
+
+	std::vector<long> amounts;
+
+	for (int t = 0; t < TRADES; ++t) {
+
+		tradeBonds.push_back(rand() % N);
+
+		tradeBooks.push_back(rand() % 3);
+
+		amounts.push_back((rand() % 2 ? 1 : -1) * (rand() % 10 + 1) * 1000000L);
+
+	}
+
+	long sink = 0;
+
+	std::cout << "Position aggregation (" << N << " CUSIPs, 3 books, " << TRADES << " trades)" << std::endl;
+
+	// the old AddTrade: find then operator[], a copy of the position to publish, and a walk of its books for the aggregate
+
+	std::map<std::string, std::map<std::string, long>> legacy;
+
+	report("map of books, copied to publish", time_it([&]() {
+
+		for (int t = 0; t < TRADES; ++t) {
+
+			const std::string& id = cusips[tradeBonds[t]];
+
+			if (legacy.find(id) == legacy.end()) legacy.insert(std::make_pair(id, std::map<std::string, long>()));
+
+			legacy[id][books[tradeBooks[t]]] += amounts[t];
+
+			std::map<std::string, long> published = legacy[id];
+
+			long aggregate = 0;
+
+			for (auto pair : published) aggregate += pair.second;
+
+			sink += aggregate;
+
+		}
+
+	}), TRADES);
+
+	KeyedStore<std::string, Position<Bond>> store;
+
+	report("Position running aggregate", time_it([&]() {
+
+		for (int t = 0; t < TRADES; ++t) {
+
+			const std::string& id = cusips[tradeBonds[t]];
+
+			size_t i = store.IndexOf(id);
+
+			if (i == KeyedStore<std::string, Position<Bond>>::NOT_FOUND) {
+
+				i = store.Assign(id);
+
+				store.AtIndex(i) = Position<Bond>(bonds[tradeBonds[t]]);
+
+			}
+
+			Position<Bond>& position = store.AtIndex(i);
+
+			position.AddPosition(books[tradeBooks[t]], amounts[t]);
+
+			sink += position.GetAggregatePosition();
+
+		}
+
+	}), TRADES);
+
+	long mismatches = 0;
+
+	for (int i = 0; i < N; ++i) {
+
+		long total = 0;
+
+		for (auto& book : legacy[cusips[i]]) total += book.second;
+
+		if (store.count(cusips[i]) && store.at(cusips[i]).GetAggregatePosition() != total) ++mismatches;
+
+	}
+
+	std::cout << "  positions differing from the old aggregation: " << mismatches << std::endl;
+
+	check("running position aggregates differ from summing the books", mismatches == 0);
+
+	std::cout << "  (checksum " << sink << ")\n" << std::endl;
+
+}
+
+
+void sharded_position_benchmark() {
+
+	const int N = 2000, TRADES = 2000000;
+
+	std::vector<Trade<Bond>> trades;
+
+	std::vector<std::string> books = { "TRSY1", "TRSY2", "TRSY3" };
+
+	std::vector<Bond> bonds;
+
+	for (int i = 0; i < N; ++i) {
+
+		char cusip[16];
+
+		snprintf(cusip, sizeof(cusip), "SH%07d", i);
+
+		bonds.push_back(Bond(cusip, CUSIP, "T", 0.02f, date(2027, 11, 15)));
+
+	}
+
+	for (int t = 0; t < TRADES; ++t) trades.push_back(Trade<Bond>(bonds[rand() % N], "T", FixedPrice::FromDouble(99.5), books[rand() % 3], (rand() % 10 + 1) * 1000000L, (rand() % 2 ? BUY : SELL)));
+
+	// the single-threaded aggregate to check every snapshot against
+
+	std::unordered_map<std::string, long> expected;
+
+	for (auto& trade : trades) expected[trade.GetProduct().GetProductId()] += (trade.GetSide() == BUY ? trade.GetQuantity() : -trade.GetQuantity());
+
+	std::cout << "Sharded position keeping (" << N << " CUSIPs, " << TRADES << " trades, " << std::thread::hardware_concurrency() << " cores)" << std::endl;
+
+	for (size_t shards : { 1, 2, 4, 8 }) {
+
+		ShardedPositionService<Bond> service(shards);
+
+		std::vector<Position<Bond>> snapshot;
+
+		double seconds = time_it([&]() {
+
+			for (auto& trade : trades) service.AddTrade(trade);
+
+			snapshot = service.Snapshot();
+
+		});
+
+		long mismatches = 0;
+
+		for (auto& position : snapshot) if (position.GetAggregatePosition() != expected[position.GetProduct().GetProductId()]) ++mismatches;
+
+		report(std::to_string(shards) + " shard(s), trades to snapshot", seconds, TRADES);
+
+		std::cout << "    " << snapshot.size() << " positions, " << mismatches << " differing from one thread" << std::endl;
+
+		check("the sharded snapshot over " + std::to_string(shards) + " shard(s) differs from one thread", snapshot.size() == expected.size() && mismatches == 0);
+
+	}
+
+	std::cout << std::endl;
+
+}
+
+
+void matching_benchmark() {
+
+	const int N = 100, BOOKS = 64, ORDERS = 2000000, REFRESH = 8;
+
+	std::vector<Bond> bonds;
+
+	for (int i = 0; i < N; ++i) {
+
+		char cusip[16];
+
+		snprintf(cusip, sizeof(cusip), "MB%07d", i);
+
+		bonds.push_back(Bond(cusip, CUSIP, "T", 0.02f, date(2027, 11, 15)));
+
+	}
+
+	// books five levels deep around a mid which wanders, and orders of every type near the touch
+
+	std::vector<OrderBook<Bond>> books;
+
+	for (int b = 0; b < BOOKS; ++b) {
+
+		const Bond& bond = bonds[b % N];
+
+		long mid = 99 * TICKS_PER_POINT + rand() % 512;
+
+		vector<Order> bid_stack, offer_stack;
+
+		for (int level = 0; level < 5; ++level) {
+
+			bid_stack.push_back(Order(FixedPrice::FromTicks(mid - 1 - level), (level + 1) * 1000000L, BID));
+
+			offer_stack.push_back(Order(FixedPrice::FromTicks(mid + 1 + level), (level + 1) * 1000000L, OFFER));
+
+		}
+
+		books.push_back(OrderBook<Bond>(bond, bid_stack, offer_stack));
+
+	}
+
+	std::vector<ExecutionOrder<Bond>> orders;
+
+	OrderType types[] = { FOK, IOC, MARKET, LIMIT, STOP };
+
+	for (int o = 0; o < 4096; ++o) {
+
+		const OrderBook<Bond>& book = books[o % BOOKS];
+
+		PricingSide side = (rand() % 2 ? BID : OFFER);
+
+		FixedPrice touch = (side == BID ? book.GetOfferStack()[0].GetPrice() : book.GetBidStack()[0].GetPrice());
+
+		FixedPrice price = touch + (side == BID ? 1 : -1) * ((rand() % 5) - 2) * ONE_TICK;
+
+		orders.push_back(ExecutionOrder<Bond>(book.GetProduct(), side, "O" + std::to_string(o), types[rand() % 5], price, (rand() % 3 + 1) * 1000000L, (rand() % 2) * 1000000L, "P", false));
+
+	}
+
+	MatchingEngine<Bond> engine(CME);
+
+	std::vector<VenueFill> fills;
+
+	for (auto& book : books) engine.OnBook(book, fills);
+
+	long filled = 0, fillCount = 0;
+
+	std::cout << "Venue matching (" << N << " CUSIPs, " << ORDERS << " orders, a book refresh every " << REFRESH << " orders)" << std::endl;
+
+	report("MatchingEngine::Match", time_it([&]() {
+
+		for (int o = 0; o < ORDERS; ++o) {
+
+			if (o % REFRESH == 0) engine.OnBook(books[(o / REFRESH) % BOOKS], fills);
+
+			filled += engine.Match(orders[o % orders.size()], fills);
+
+			fillCount += fills.size();
+
+			fills.clear();
+
+		}
+
+	}), ORDERS);
+
+	std::cout << "  " << fillCount << " fills, " << filled << " filled by aggressive orders\n" << std::endl;
+
+}
+
+
+void limit_order_book_benchmark() {
+
+	const int OPS = 2000000, LIVE = 10000;
+
+	// a stream of adds near the touch with cancels and partial executions of live orders, keeping about LIVE resting
+
+	struct Op { int kind; uint64_t id; PricingSide side; long ticks; long quantity; };
+
+	std::vector<Op> ops;
+
+	std::vector<std::pair<uint64_t, long>> live;
+
+	uint64_t nextId = 1;
+
+	long mid = 100 * TICKS_PER_POINT;
+
+	for (int o = 0; o < OPS; ++o) {
+
+		int roll = rand() % 10;
+
+		if (live.size() < LIVE / 2 || (roll < 5 && live.size() < LIVE)) {
+
+			PricingSide side = (rand() % 2 ? BID : OFFER);
+
+			long ticks = (side == BID ? mid - 1 - rand() % 32 : mid + 1 + rand() % 32);
+
+			long quantity = (rand() % 5 + 1) * 1000000L;
+
+			ops.push_back(Op{ 0, nextId, side, ticks, quantity });
+
+			live.push_back(std::make_pair(nextId++, quantity));
+
+		}
+
+		else {
+
+			size_t k = rand() % live.size();
+
+			int kind = (roll < 8 ? 1 : 2);
+
+			ops.push_back(Op{ kind, live[k].first, BID, 0, 1000000L });
+
+			// a partly executed order stays live with what is left
+
+			if (kind == 1 || (live[k].second -= 1000000L) <= 0) {
+
+				live[k] = live.back();
+
+				live.pop_back();
+
+			}
+
+		}
+
+		if (o % 1000 == 0) mid += (rand() % 3) - 1;
+
+	}
+
+	long sink = 0;
+
+	std::cout << "Limit order book (" << OPS << " adds, cancels and executions, about " << LIVE << " live orders)" << std::endl;
+
+	// the obvious structure: a map of price levels holding lists, and a hash of iterators by id
+
+	struct Resting { PricingSide side; long ticks; std::list<std::pair<uint64_t, long>>::iterator it; };
+
+	std::map<long, std::list<std::pair<uint64_t, long>>> bidLevels, offerLevels;
+
+	std::unordered_map<uint64_t, Resting> where;
+
+	report("std::map levels + std::list + unordered_map", time_it([&]() {
+
+		for (auto& op : ops) {
+
+			if (op.kind == 0) {
+
+				auto& levels = (op.side == BID ? bidLevels : offerLevels);
+
+				auto& queue = levels[op.ticks];
+
+				queue.push_back(std::make_pair(op.id, op.quantity));
+
+				where[op.id] = Resting{ op.side, op.ticks, std::prev(queue.end()) };
+
+				continue;
+
+			}
+
+			auto found = where.find(op.id);
+
+			if (found == where.end()) continue;
+
+			auto& levels = (found->second.side == BID ? bidLevels : offerLevels);
+
+			auto level = levels.find(found->second.ticks);
+
+			if (op.kind == 2 && found->second.it->second > op.quantity) {
+
+				found->second.it->second -= op.quantity;
+
+				sink += op.quantity;
+
+				continue;
+
+			}
+
+			level->second.erase(found->second.it);
+
+			if (level->second.empty()) levels.erase(level);
+
+			where.erase(found);
+
+		}
+
+		sink += (bidLevels.empty() ? 0 : bidLevels.rbegin()->first);
+
+	}), OPS);
+
+	LimitOrderBook<Bond> book;
+
+	report("LimitOrderBook", time_it([&]() {
+
+		for (auto& op : ops) {
+
+			if (op.kind == 0) book.AddOrder(op.id, op.side, op.ticks, op.quantity);
+
+			else if (op.kind == 1) book.CancelOrder(op.id);
+
+			else sink += book.ExecuteOrder(op.id, op.quantity);
+
+		}
+
+		sink += (book.HasBid() ? book.GetBestBid() : 0);
+
+	}), OPS);
+
+	bool agree = (book.Size() == where.size()) && (book.HasBid() ? book.GetBestBid() == bidLevels.rbegin()->first : bidLevels.empty()) && (book.HasOffer() ? book.GetBestOffer() == offerLevels.begin()->first : offerLevels.empty());
+
+	std::cout << "  " << book.Size() << " live orders, books " << (agree ? "agree" : "DIFFER") << " (checksum " << sink << ")\n" << std::endl;
+
+	check("the limit order book differs from the reference book", agree);
+
+}
+
+
+void message_path_benchmark() {
+
+	const int N = 6, TICKS = 1000000, WARMUP = 100000;
+
+	std::vector<Bond> bonds;
+
+	for (int i = 0; i < N; ++i) {
+
+		char cusip[16];
+
+		snprintf(cusip, sizeof(cusip), "MP%07d", i);
+
+		bonds.push_back(Bond(cusip, CUSIP, "T", 0.02f, date(2027, 11, 15)));
+
+	}
+
+	// each CUSIP alternates between two books four ticks apart, so an order resting on one is filled by the other
+
+	std::vector<OrderBook<Bond>> books;
+
+	std::vector<ExecutionOrder<Bond>> orders;
+
+	std::vector<Price<Bond>> prices;
+
+	OrderType types[] = { FOK, IOC, MARKET, LIMIT, STOP };
+
+	for (int i = 0; i < 2 * N; ++i) {
+
+		const Bond& bond = bonds[i % N];
+
+		long mid = 99 * TICKS_PER_POINT + (i < N ? 0 : 4);
+
+		vector<Order> bid_stack, offer_stack;
+
+		for (int level = 0; level < 5; ++level) {
+
+			bid_stack.push_back(Order(FixedPrice::FromTicks(mid - 1 - level), 1000000000L, BID));
+
+			offer_stack.push_back(Order(FixedPrice::FromTicks(mid + 1 + level), 1000000000L, OFFER));
+
+		}
+
+		books.push_back(OrderBook<Bond>(bond, bid_stack, offer_stack));
+
+		prices.push_back(Price<Bond>(ProductRegistry<Bond>::instance()->Intern(bond), FixedPrice::FromTicks(mid), 2 * ONE_TICK));
+
+	}
+
+	for (int o = 0; o < 50; ++o) {
+
+		PricingSide side = (o % 2 ? BID : OFFER);
+
+		FixedPrice price = FixedPrice::FromTicks(99 * TICKS_PER_POINT + 2 + (side == BID ? 1 : -1));
+
+		orders.push_back(ExecutionOrder<Bond>(bonds[o % N], side, "O" + std::to_string(o), types[o % 5], price, 1000000L, (o % 3 == 0 ? 1000000L : 0L), "P", false));
+
+	}
+
+	// book, match, booked trade and streamed price for one CUSIP per tick, through the services themselves
+
+	struct TradeCounter : public ServiceListener<Trade<Bond>> {
+
+		long quantity = 0;
+
+		void ProcessAdd(Trade<Bond> &data) { quantity += data.GetQuantity(); }
+
+		void ProcessRemove(Trade<Bond> &data) {}
+
+		void ProcessUpdate(Trade<Bond> &data) {}
+
+	} tradeCounter;
+
+	struct StreamCounter : public ServiceListener<PriceStream<Bond>> {
+
+		long streams = 0;
+
+		void ProcessAdd(PriceStream<Bond> &data) { ++streams; }
+
+		void ProcessRemove(PriceStream<Bond> &data) {}
+
+		void ProcessUpdate(PriceStream<Bond> &data) {}
+
+	} streamCounter;
+
+	BondExecutionService* executionService = BondExecutionService::instance();
+
+	executionService->AddListener(&tradeCounter);
+
+	BondAlgoStreamingService::instance()->AddListener(BondStreamingServiceListener::instance());
+
+	BondStreamingService::instance()->AddListener(&streamCounter);
+
+	auto tick = [&](int t) {
+
+		const OrderBook<Bond>& book = books[(t / N) % 2 * N + t % N];
+
+		executionService->OnBook(book);
+
+		executionService->ExecuteOrder(orders[t % orders.size()], Market(t % 3));
+
+		BondAlgoStreamingServiceListener::instance()->ProcessAdd(prices[(t / N) % 2 * N + t % N]);
+
+	};
+
+	std::streambuf* coutBuffer = std::cout.rdbuf(nullptr);
+
+	for (int t = 0; t < WARMUP; ++t) tick(t);
+
+#ifdef COUNT_ALLOCATIONS
+	long allocations = heapAllocations;
+#endif
+
+	double seconds = time_it([&]() {
+
+		for (int t = WARMUP; t < WARMUP + TICKS; ++t) tick(t);
+
+	});
+
+#ifdef COUNT_ALLOCATIONS
+	allocations = heapAllocations - allocations;
+#endif
+
+	std::cout.rdbuf(coutBuffer);
+
+	std::cout << "Message path (" << TICKS << " ticks of book, execution order, trades and price stream)" << std::endl;
+
+	report("book + execute + stream", seconds, TICKS);
+
+#ifdef COUNT_ALLOCATIONS
+	std::cout << "  " << allocations << " heap allocations in steady state, " << tradeCounter.quantity << " traded, " << streamCounter.streams << " streams" << std::endl;
+
+	check("the message path allocated in steady state", allocations == 0);
+#else
+	std::cout << "  " << tradeCounter.quantity << " traded, " << streamCounter.streams << " streams (build with COUNT_ALLOCATIONS to check for heap allocations)" << std::endl;
+#endif
+
+	std::cout << std::endl;
+
+}
+
+
+void algo_execution_benchmark() {
+
+	const int N = 100, BOOKS = 256, TICKS = 2000000;
+
+	std::vector<Bond> bonds;
+
+	for (int i = 0; i < N; ++i) {
+
+		char cusip[16];
+
+		snprintf(cusip, sizeof(cusip), "AE%07d", i);
+
+		bonds.push_back(Bond(cusip, CUSIP, "T", 0.02f, date(2027, 11, 15)));
+
+	}
+
+	// five-level books, a third of them one tick wider than the tightest spread
+
+	std::vector<OrderBook<Bond>> books;
+
+	for (int b = 0; b < BOOKS; ++b) {
+
+		long mid = 99 * TICKS_PER_POINT + rand() % 512;
+
+		int wide = (b % 3 == 0 ? 1 : 0);
+
+		vector<Order> bid_stack, offer_stack;
+
+		for (int level = 0; level < 5; ++level) {
+
+			bid_stack.push_back(Order(FixedPrice::FromTicks(mid - 1 - wide - level), (level + 1) * 1000000L, BID));
+
+			offer_stack.push_back(Order(FixedPrice::FromTicks(mid + 1 + level), (level + 1) * 1000000L, OFFER));
+
+		}
+
+		books.push_back(OrderBook<Bond>(bonds[b % N], bid_stack, offer_stack));
+
+	}
+
+	std::vector<ExecutionOrder<Bond>> children;
+
+	long sent = 0;
+
+	std::cout << "Algo execution strategies (" << N << " CUSIPs, " << TICKS << " books)" << std::endl;
+
+	AlgoExecutionEngine<Bond, AggressWhenTight<Bond> > aggress;
+
+	report("AggressWhenTight", time_it([&]() {
+
+		for (int t = 0; t < TICKS; ++t) {
+
+			aggress.OnBook(books[t % BOOKS], children);
+
+			sent += children.size();
+
+			children.clear();
+
+		}
+
+	}), TICKS);
+
+	// every CUSIP works a parent in 20 slices, one every 4 books, restarting when it is done
+
+	AlgoExecutionEngine<Bond, TwapSlicer<Bond> > twap(TwapSlicer<Bond>(4));
+
+	report("TwapSlicer", time_it([&]() {
+
+		for (int t = 0; t < TICKS; ++t) {
+
+			const OrderBook<Bond>& book = books[t % BOOKS];
+
+			TwapSlicer<Bond>::State& state = twap.GetState(book.GetProduct());
+
+			if (state.remaining == 0) state.Start(t % 2 ? BID : OFFER, 20000000, 20);
+
+			twap.OnBook(book, children);
+
+			sent += children.size();
+
+			children.clear();
+
+		}
+
+	}), TICKS);
+
+	AlgoExecutionEngine<Bond, Iceberg<Bond> > iceberg;
+
+	report("Iceberg", time_it([&]() {
+
+		for (int t = 0; t < TICKS; ++t) {
+
+			const OrderBook<Bond>& book = books[t % BOOKS];
+
+			if (t % 8 == 0) iceberg.GetState(book.GetProduct()).Start(t % 16 ? BID : OFFER, 10000000, 1000000);
+
+			iceberg.OnBook(book, children);
+
+			sent += children.size();
+
+			children.clear();
+
+		}
+
+	}), TICKS);
+
+	std::cout << "  " << sent << " child orders sent\n" << std::endl;
+
+}
+
+
+void order_manager_benchmark() {
+
+	const int PARENTS = 10000, FILLS = 2000000;
+
+	Bond bond("OM0000001", CUSIP, "T", 0.02f, date(2027, 11, 15));
+
+	OrderManager<Bond> manager(PARENTS);
+
+	std::vector<ExecutionOrder<Bond>> orders;
+
+	// each parent shows 1M of 10M at a time; fills of up to 0.5M land on random live children
+
+	std::vector<uint64_t> liveChildren(PARENTS);
+
+	auto start = [&](int k) {
+
+		orders.clear();
+
+		manager.AddParent(bond, k % 2 ? BID : OFFER, LIMIT, FixedPrice::FromDouble(99.5), 1000000, 9000000, CME, orders);
+
+		liveChildren[k] = OrderManager<Bond>::ChildId(orders.back().GetOrderId());
+
+	};
+
+	for (int k = 0; k < PARENTS; ++k) start(k);
+
+	std::vector<std::pair<int, long>> fills;
+
+	for (int f = 0; f < FILLS; ++f) fills.push_back(std::make_pair(rand() % PARENTS, (rand() % 5 + 1) * 100000L));
+
+	long slices = 0, completed = 0;
+
+	std::cout << "Parent order manager (" << PARENTS << " parents worked concurrently, " << FILLS << " fills)" << std::endl;
+
+	report("OrderManager::OnFill", time_it([&]() {
+
+		for (auto& fill : fills) {
+
+			int k = fill.first;
+
+			orders.clear();
+
+			manager.OnFill(liveChildren[k], fill.second, orders);
+
+			if (!orders.empty()) {
+
+				liveChildren[k] = OrderManager<Bond>::ChildId(orders.back().GetOrderId());
+
+				++slices;
+
+			}
+
+			else if (!manager.GetParentOfChild(liveChildren[k])) {
+
+				++completed;
+
+				start(k);
+
+			}
+
+		}
+
+	}), FILLS);
+
+	std::cout << "  " << slices << " children re-sliced, " << completed << " parents completed, " << manager.GetParentCount() << " live\n" << std::endl;
+
+}
+
+
+void quoting_benchmark() {
+
+	const int N = 2000, TICKS = 500;
+
+	std::vector<Bond> bonds;
+
+	for (int i = 0; i < N; ++i) {
+
+		char cusip[16];
+
+		snprintf(cusip, sizeof(cusip), "QE%07d", i);
+
+		bonds.push_back(Bond(cusip, CUSIP, "T", 0.02f, date(2027, 11, 15)));
+
+	}
+
+	std::vector<FixedPrice> mids;
+
+	for (int t = 0; t < TICKS; ++t) mids.push_back(FixedPrice::FromTicks(99 * TICKS_PER_POINT + rand() % 33 - 16));
+
+	const FixedPrice spread = 2 * ONE_TICK;
+
+	QuotingEngine<Bond> engine;
+
+	engine.SetSkew(1.0 / 256 / 1000000, 1.0 / 64);
+
+	std::vector<size_t> index, quoted;
+
+	for (int i = 0; i < N; ++i) {
+
+		index.push_back(engine.Add(bonds[i]));
+
+		engine.SetPosition(index[i], (rand() % 21 - 10) * 1000000L);
+
+	}
+
+	long sink = 0;
+
+	std::cout << "Curve quoting (" << N << " CUSIPs, " << TICKS << " ticks, every CUSIP repriced on each tick)" << std::endl;
+
+	// the old AlgoStream: a stream built from each price and stored by CUSIP, one price at a time
+
+	KeyedStore<std::string, PriceStream<Bond>> streams;
+
+	report("PriceStream per price", time_it([&]() {
+
+		for (int t = 0; t < TICKS; ++t) {
+
+			for (int i = 0; i < N; ++i) {
+
+				FixedPrice mid = mids[t] + FixedPrice::FromTicks(i % 64);
+
+				PriceStreamOrder bid(mid - ONE_TICK, 1000000, 2000000, BID), ask(mid + ONE_TICK, 1000000, 2000000, OFFER);
+
+				PriceStream<Bond>& stored = streams[bonds[i].GetProductId()];
+
+				stored = PriceStream<Bond>(bonds[i], bid, ask);
+
+				sink += stored.GetBidOrder().GetPrice().GetTicks();
+
+			}
+
+		}
+
+	}), (long)TICKS * N);
+
+	report("QuotingEngine per price", time_it([&]() {
+
+		for (int t = 0; t < TICKS; ++t) {
+
+			for (int i = 0; i < N; ++i) {
+
+				engine.SetPrice(index[i], mids[t] + FixedPrice::FromTicks(i % 64), spread);
+
+				quoted.clear();
+
+				engine.Quote(quoted);
+
+				sink += engine.GetBid(quoted[0]).GetTicks();
+
+			}
+
+		}
+
+	}), (long)TICKS * N);
+
+	report("QuotingEngine batched tick", time_it([&]() {
+
+		for (int t = 0; t < TICKS; ++t) {
+
+			for (int i = 0; i < N; ++i) engine.SetPrice(index[i], mids[t] + FixedPrice::FromTicks(i % 64), spread);
+
+			quoted.clear();
+
+			engine.Quote(quoted);
+
+			for (size_t q : quoted) sink += engine.GetBid(q).GetTicks();
+
+		}
+
+	}), (long)TICKS * N);
+
+	report("QuotingEngine::QuoteAll", time_it([&]() {
+
+		for (int t = 0; t < TICKS; ++t) {
+
+			quoted.clear();
+
+			engine.QuoteAll(quoted);
+
+			for (size_t q : quoted) sink += engine.GetBid(q).GetTicks();
+
+		}
+
+	}), (long)TICKS * N);
+
+	std::cout << "  (checksum " << sink << ")\n" << std::endl;
+
+}
+// Work parents through BondExecutionService: a LIMIT parent rests its first child, a crossing book fills it and
+// every later slice, and a cancelled parent's child comes off the venue so the same book cannot fill it. STOP
+// parents, one waiting for its trigger and one triggered on arrival, take what the book has and end
+void parent_order_check() {
+
+	Bond bond("PO0000001", CUSIP, "T", 0.02f, date(2027, 11, 15));
+
+	const long mid = 99 * TICKS_PER_POINT;
+
+	auto book = [&](long bestOffer, long quantity) {
+
+		vector<Order> bid_stack, offer_stack;
+
+		for (int level = 0; level < 5; ++level) {
+
+			bid_stack.push_back(Order(FixedPrice::FromTicks(mid - 1 - level), quantity, BID));
+
+			offer_stack.push_back(Order(FixedPrice::FromTicks(bestOffer + level), quantity, OFFER));
+
+		}
+
+		return OrderBook<Bond>(bond, bid_stack, offer_stack);
+
+	};
+
+	static struct TradeCounter : public ServiceListener<Trade<Bond>> {
+
+		long quantity = 0;
+
+		void ProcessAdd(Trade<Bond> &data) { if (data.GetProduct().GetProductId() == "PO0000001") quantity += data.GetQuantity(); }
+
+		void ProcessRemove(Trade<Bond> &data) {}
+
+		void ProcessUpdate(Trade<Bond> &data) {}
+
+	} traded;
+
+	BondExecutionService* executionService = BondExecutionService::instance();
+
+	executionService->AddListener(&traded);
+
+	MatchingEngine<Bond>& venue = executionService->GetVenue(CME);
+
+	std::streambuf* coutBuffer = std::cout.rdbuf(nullptr);
+
+	// a bid at the mid rests below offers one tick up
+	executionService->OnBook(book(mid + 1, 10000000));
+
+	uint64_t worked = executionService->ExecuteParent(bond, BID, LIMIT, FixedPrice::FromTicks(mid), 1000000, 2000000, CME);
+
+	bool rested = (venue.GetRestingQuantity(bond) == 1000000 && traded.quantity == 0);
+
+	// offers at the mid fill the resting child, and each slice after it fills on arrival
+	executionService->OnBook(book(mid, 10000000));
+
+	bool completed = (executionService->GetOrderManager().GetParent(worked) == nullptr && traded.quantity == 3000000 && venue.GetRestingQuantity(bond) == 0);
+
+	executionService->OnBook(book(mid + 1, 10000000));
+
+	uint64_t cancelled = executionService->ExecuteParent(bond, BID, LIMIT, FixedPrice::FromTicks(mid), 1000000, 2000000, CME);
+
+	bool removed = executionService->CancelParent(cancelled) && venue.GetRestingQuantity(bond) == 0;
+
+	executionService->OnBook(book(mid, 10000000));
+
+	bool unfilled = (traded.quantity == 3000000 && executionService->GetOrderManager().GetParent(cancelled) == nullptr);
+
+	// a buy stop above the best offer waits; offers reaching it fill 5M of its 8M and the venue drops the rest
+	executionService->OnBook(book(mid + 1, 1000000));
+
+	uint64_t waiting = executionService->ExecuteParent(bond, BID, STOP, FixedPrice::FromTicks(mid + 2), 1000000, 7000000, CME);
+
+	bool pending = (venue.GetPendingStops(bond) == 1 && traded.quantity == 3000000);
+
+	executionService->OnBook(book(mid + 2, 1000000));
+
+	bool fired = (executionService->GetOrderManager().GetParent(waiting) == nullptr && venue.GetPendingStops(bond) == 0 && traded.quantity == 8000000);
+
+	// a fresh 2M of offers at the stop's price triggers the next one as it arrives
+	executionService->OnBook(book(mid + 2, 400000));
+
+	uint64_t triggered = executionService->ExecuteParent(bond, BID, STOP, FixedPrice::FromTicks(mid + 2), 1000000, 7000000, CME);
+
+	bool triggeredEnded = (executionService->GetOrderManager().GetParent(triggered) == nullptr && executionService->GetOrderManager().GetChildCount() == 0
+		&& venue.GetPendingStops(bond) == 0 && traded.quantity == 10000000);
+
+	std::cout.rdbuf(coutBuffer);
+
+	std::cout << "Parent orders through the execution service" << std::endl;
+
+	std::cout << "  " << traded.quantity << " traded for a worked 3M parent, a cancelled one and two 8M stops\n" << std::endl;
+
+	check("the first child of a LIMIT parent did not rest on the venue", rested);
+
+	check("a crossing book did not fill the parent slice by slice", completed);
+
+	check("cancelling a parent left its child on the venue", removed);
+
+	check("a cancelled parent's child still filled", unfilled);
+
+	check("a STOP parent below its trigger did not wait on the venue", pending);
+
+	check("a STOP parent fired by a book stayed with the order manager", fired);
+
+	check("a STOP parent triggered on arrival stayed with the order manager", triggeredEnded);
+
+}
+
+// Feed generated market data deltas through the connector. Before each delta and at the end, the book, aggregated
+// depth and best bid/offer the deltas built are compared with those worked out from the same levels held as plain
+// vectors; at the end the levels are also sent as snapshots, which must give the service the same state again
+void market_data_delta_check() {
+
+	const char* path = "benchmark_deltas.txt";
+
+	bond_data();
+
+	struct SnapshotComparer : public ServiceListener<OrderBookDelta> {
+
+		// the levels each product should have, bids then offers
+		map<string, pair<vector<Order>, vector<Order>>> levels;
+
+		long deltas = 0;
+
+		long differing = 0;
+
+		static bool Same(const vector<Order> &a, const vector<Order> &b) {
+
+			if (a.size() != b.size()) return false;
+
+			for (size_t i = 0; i < a.size(); ++i) {
+
+				if (a[i].GetPrice() != b[i].GetPrice() || a[i].GetQuantity() != b[i].GetQuantity() || a[i].GetSide() != b[i].GetSide()) return false;
+
+			}
+
+			return true;
+
+		}
+
+		static bool Same(const BidOffer &a, const BidOffer &b) {
+
+			return Same(vector<Order>{ a.GetBidOrder(), a.GetOfferOrder() }, vector<Order>{ b.GetBidOrder(), b.GetOfferOrder() });
+
+		}
+
+		// the levels of a side merged by price, best first
+		static vector<Order> Aggregated(const vector<Order> &stack, PricingSide side) {
+
+			map<FixedPrice, long> depth;
+
+			for (auto& order : stack) if (order.GetQuantity() != 0) depth[order.GetPrice()] += order.GetQuantity();
+
+			vector<Order> result;
+
+			for (auto& level : depth) result.push_back(Order(level.first, level.second, side));
+
+			if (side == BID) reverse(result.begin(), result.end());
+
+			return result;
+
+		}
+
+		void Compare(const string &cusip) {
+
+			BondMarketDataService* service = BondMarketDataService::instance();
+
+			const vector<Order>& bids = levels.at(cusip).first;
+
+			const vector<Order>& offers = levels.at(cusip).second;
+
+			vector<Order> bidDepth = Aggregated(bids, BID), offerDepth = Aggregated(offers, OFFER);
+
+			BidOffer best(bidDepth.empty() ? Order(FixedPrice(), 0, BID) : bidDepth.front(), offerDepth.empty() ? Order(FixedPrice(), 0, OFFER) : offerDepth.front());
+
+			const OrderBook<Bond>& book = service->GetData(cusip);
+
+			const OrderBook<Bond>& depth = service->AggregateDepth(cusip);
+
+			if (!Same(book.GetBidStack(), bids) || !Same(book.GetOfferStack(), offers) || !Same(depth.GetBidStack(), bidDepth) || !Same(depth.GetOfferStack(), offerDepth) || !Same(service->GetBestBidOffer(cusip), best)) ++differing;
+
+		}
+
+		void ProcessAdd(OrderBookDelta &delta) {
+
+			Compare(delta.GetProductId());
+
+			auto& product = levels.at(delta.GetProductId());
+
+			vector<Order>& stack = (delta.GetSide() == BID ? product.first : product.second);
+
+			switch (delta.GetAction()) {
+
+			case ADD_LEVEL: stack.insert(stack.begin() + delta.GetLevel(), delta.GetOrder()); break;
+
+			case MODIFY_LEVEL: stack[delta.GetLevel()] = delta.GetOrder(); break;
+
+			case DELETE_LEVEL: stack.erase(stack.begin() + delta.GetLevel()); break;
+
+			}
+
+			++deltas;
+
+		}
+
+		void ProcessRemove(OrderBookDelta &delta) {}
+
+		void ProcessUpdate(OrderBookDelta &delta) {}
+
+	} comparer;
+
+	BondMarketDataConnector* connector = BondMarketDataConnector::instance();
+
+	// every product starts from a five level snapshot, as marketdata.txt gives it
+	for (auto& cusip : CUSIPS) {
+
+		vector<Order> bid_stack, offer_stack;
+
+		for (int level = 0; level < 5; ++level) {
+
+			bid_stack.push_back(Order(FixedPrice::FromTicks(99 * TICKS_PER_POINT + 100 - level), 1000000, BID));
+
+			offer_stack.push_back(Order(FixedPrice::FromTicks(99 * TICKS_PER_POINT + 101 + level), 1000000, OFFER));
+
+		}
+
+		OrderBook<Bond> book(BondBook::instance()->GetData(cusip), bid_stack, offer_stack);
+
+		connector->GetService()->OnMessage(book);
+
+		comparer.levels[cusip] = make_pair(bid_stack, offer_stack);
+
+	}
+
+	market_data_deltas(path);
+
+	std::streambuf* coutBuffer = std::cout.rdbuf(nullptr);
+
+	connector->SetRecorder(&comparer);
+
+	connector->SubscribeDeltas(path);
+
+	connector->SetRecorder(static_cast<ServiceListener<OrderBookDelta>*>(nullptr));
+
+	std::cout.rdbuf(coutBuffer);
+
+	for (auto& cusip : CUSIPS) {
+
+		comparer.Compare(cusip);
+
+		OrderBook<Bond> snapshot(BondBook::instance()->GetData(cusip), comparer.levels.at(cusip).first, comparer.levels.at(cusip).second);
+
+		connector->GetService()->OnMessage(snapshot);
+
+		comparer.Compare(cusip);
+
+	}
+
+	std::remove(path);
+
+	std::cout << "Market data deltas (" << comparer.deltas << " deltas over " << CUSIPS.size() << " CUSIPs)" << std::endl;
+
+	std::cout << "  " << comparer.differing << " books differing from their levels\n" << std::endl;
+
+	check("market data deltas or snapshots left a book different from its levels", comparer.deltas > 0 && comparer.differing == 0);
+
+}
+
+// Send a burst of prices through a conflating edge while its listener holds the first one: every later price
+// for a CUSIP already waiting replaces it, so each CUSIP is delivered once more, with the last price sent for it
+void conflation_check() {
+
+	const int BONDS = 4, BURST = 1000;
+
+	struct LastPrice : public ServiceListener<Price<Bond>> {
+
+		atomic<bool> entered{ false }, released{ false };
+
+		map<string, FixedPrice> last;
+
+		void ProcessAdd(Price<Bond> &data) {
+
+			entered = true;
+
+			while (!released) this_thread::yield();
+
+			last[data.GetProduct().GetProductId()] = data.GetMid();
+
+		}
+
+		void ProcessRemove(Price<Bond> &data) {}
+
+		void ProcessUpdate(Price<Bond> &data) {}
+
+	} listener;
+
+	vector<Bond> bonds;
+
+	for (int b = 0; b < BONDS; ++b) bonds.push_back(Bond("CF000000" + std::to_string(b), CUSIP, "T", 0.02f, date(2027, 11, 15)));
+
+	map<string, FixedPrice> sent;
+
+	unsigned long received, delivered, conflated;
+
+	{
+
+		BondPriceConflatingListener conflating(&listener);
+
+		for (int i = 0; i < BURST; ++i) {
+
+			Price<Bond> price(bonds[i % BONDS], FixedPrice::FromTicks(99 * TICKS_PER_POINT + i), 2 * ONE_TICK);
+
+			sent[price.GetProduct().GetProductId()] = price.GetMid();
+
+			conflating.ProcessAdd(price);
+
+			// hold the first price in the listener so the rest of the burst has to wait behind it
+			if (i == 0) while (!listener.entered) this_thread::yield();
+
+		}
+
+		listener.released = true;
+
+		conflating.Drain();
+
+		received = conflating.GetReceived();
+
+		delivered = conflating.GetDelivered();
+
+		conflated = conflating.GetConflated();
+
+	}
+
+	std::cout << "Conflating edge (" << BURST << " prices over " << BONDS << " CUSIPs)" << std::endl;
+
+	std::cout << "  " << delivered << " delivered, " << conflated << " conflated\n" << std::endl;
+
+	check("the conflating edge lost or duplicated a price", received == BURST && delivered + conflated == received);
+
+	check("the conflating edge did not collapse the burst to one price per CUSIP", delivered == 1 + BONDS && conflated == BURST - 1 - BONDS);
+
+	check("the conflating edge did not deliver the last price of each CUSIP", listener.last == sent);
+
+}
+
+// Run every benchmark; returns the number of failed checks
+int run_benchmarks() {
+
+	price_format_benchmark();
+
+	csv_ingestion_benchmark();
+
+	order_book_benchmark();
+
+	persistence_benchmark();
+
+	journal_benchmark();
+
+	product_handle_benchmark();
+
+	keyed_store_benchmark();
+
+	pv01_benchmark();
+
+	sector_risk_benchmark();
+
+	scenario_benchmark();
+
+	position_benchmark();
+
+	sharded_position_benchmark();
+
+	matching_benchmark();
+
+	limit_order_book_benchmark();
+
+	algo_execution_benchmark();
+
+	order_manager_benchmark();
+
+	parent_order_check();
+
+	market_data_delta_check();
+
+	conflation_check();
+
+	quoting_benchmark();
+
+	message_path_benchmark();
+
+	return benchmarkFailures;
+
+}
+
+#endif
@@ -0,0 +1,145 @@
+/**
+ * csvreader.hpp
+ * Memory-mapped CSV reader which tokenizes rows in place.
+ * Fields point straight into the mapped file, so no per-field strings are built.
+ */
+#ifndef CSV_READER_HPP
+#define CSV_READER_HPP
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+using namespace std;
+
+// How a connector reads its input file
+enum IngestionMode { STREAMED, MAPPED };
+
+/**
+ * A single field of a CSV row, valid while its reader is alive.
+ */
+struct CsvField
+{
+
+  const char *first;
+  const char *last;
+
+  // Number of characters in the field
+  size_t Size() const { return static_cast<size_t>(last - first); }
+
+  // Copy the field into a string
+  string ToString() const { return string(first, last); }
+
+  // Compare the field against a string literal
+  bool Equals(const char *str) const
+  {
+    size_t n = strlen(str);
+    return Size() == n && memcmp(first, str, n) == 0;
+  }
+
+  // Parse the field as a signed integer, throwing invalid_argument on bad input
+  long ToLong() const
+  {
+    const char *p = first;
+    bool negative = (p != last && *p == '-');
+    if (negative) ++p;
+    if (p == last) throw invalid_argument("invalid integer field: " + ToString());
+    long result = 0;
+    for (; p != last; ++p) {
+      if (*p < '0' || *p > '9') throw invalid_argument("invalid integer field: " + ToString());
+      result = result * 10 + (*p - '0');
+    }
+    return negative ? -result : result;
+  }
+
+};
+
+/**
+ * Maps a whole CSV file into memory and hands each row to a callback
+ * as an array of fields. Carriage returns before the newline are dropped.
+ */
+class MappedCsvReader
+{
+
+public:
+
+  // ctor maps the file read-only; throws if it cannot be opened
+  MappedCsvReader(const string &path, char _delimiter = ',');
+
+  // Size of the mapped file in bytes
+  size_t GetSize() const;
+
+  // Call f(const CsvField *fields, size_t count) for each non-empty row until it returns false.
+  // Returns the number of rows visited.
+  template<typename F>
+  size_t ForEachRow(F f, bool skipHeader = true);
+
+private:
+  boost::interprocess::file_mapping mapping;
+  boost::interprocess::mapped_region region;
+  const char *begin;
+  const char *end;
+  char delimiter;
+  vector<CsvField> fields;
+
+};
+
+MappedCsvReader::MappedCsvReader(const string &path, char _delimiter) :
+  begin(nullptr), end(nullptr), delimiter(_delimiter)
+{
+  // mapping an empty file is an error, so leave the range empty instead
+  ifstream probe(path, ios::binary | ios::ate);
+  if (!probe) throw runtime_error("cannot open " + path);
+  if (probe.tellg() <= 0) return;
+
+  mapping = boost::interprocess::file_mapping(path.c_str(), boost::interprocess::read_only);
+  region = boost::interprocess::mapped_region(mapping, boost::interprocess::read_only);
+  begin = static_cast<const char*>(region.get_address());
+  end = begin + region.get_size();
+}
+
+size_t MappedCsvReader::GetSize() const
+{
+  return static_cast<size_t>(end - begin);
+}
+
+template<typename F>
+size_t MappedCsvReader::ForEachRow(F f, bool skipHeader)
+{
+  size_t rows = 0;
+  const char *p = begin;
+
+  while (p < end) {
+    const char *eol = static_cast<const char*>(memchr(p, '\n', end - p));
+    if (eol == nullptr) eol = end;
+    const char *lineEnd = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+
+    if (skipHeader) {
+      skipHeader = false;
+    }
+    else if (lineEnd > p) {
+      fields.clear();
+      const char *fieldStart = p;
+      for (const char *q = p; q < lineEnd; ++q) {
+        if (*q == delimiter) {
+          fields.push_back(CsvField{ fieldStart, q });
+          fieldStart = q + 1;
+        }
+      }
+      fields.push_back(CsvField{ fieldStart, lineEnd });
+
+      ++rows;
+      if (!f(fields.data(), fields.size())) break;
+    }
+
+    p = eol + 1;
+  }
+
+  return rows;
+}
+
+#endif
@@ -1,229 +1,265 @@
-#ifndef DATAGENERATING_HPP
-#define DATAGENERATING_HPP
-
-#include <iostream>
-#include <iomanip>
-#include <fstream> 
-#include <string>
-#include <boost/date_time/gregorian/gregorian.hpp>
-#include "products.hpp"
-
-using namespace std;
-using namespace boost::gregorian;
-
-
-std::vector<std::string> CUSIPS = {
-
-	"9128283H1", "9128283L2", "912828M80",
-
-	"9128283J7", "9128283F5", "912810RZ3" };
-
-
-
-
-void bond_data() {
-
-	std::vector<float> BondCoupon = { static_cast<float>(0), static_cast<float>(0), static_cast<float>(0), static_cast<float>(0), static_cast<float>(0), static_cast<float>(0) };
-
-	std::vector<date> BondMaturity = { date(2019, 11, 30), date(2020, 12, 15), date(2022, 11, 30),
-
-		date(2024, 11, 30), date(2027, 11, 15), date(2047, 11, 15) };
-
-	auto bondBook = BondBook::instance();
-
-	for (int i = 0; i < 6; ++i) {
-
-		Bond bond(CUSIPS[i], CUSIP, "T", BondCoupon[i], BondMaturity[i]);
-
-		bondBook->Add(bond);
-
-	}
-
-}
-
-
-
-void trade_data() {
-
-	std::ofstream file;
-
-	file.open("trades.txt", std::ios::out | std::ios::trunc);
-
-	file << "CUSIP,Trade_ID,Book,Price,Quantity,Side\n";
-
-	for (int i = 1; i <= 6; ++i) {
-
-		std::string CUSIP = CUSIPS[i - 1];
-
-		for (int j = 1; j <= 10; ++j) {
-
-			int num, num1, num2, num3, num4;
-
-			std::string str1, str2, str3;
-
-			num = rand() % (256 * 2 + 1);
-
-			num1 = num / 256; num2 = num % 256;
-
-			num3 = num2 / 8; num4 = num2 % 8;
-
-			str1 = std::to_string(99 + num1) + "-";
-
-			str2 = std::to_string(num3);
-
-			str3 = std::to_string(num4);
-
-			if (num4 == 4)	str3 = "+";
-
-			if (num3 < 10) str2 = "0" + str2;
-
-			file << CUSIP << ",T" << (i - 1) * 10 + j << ",TRSY" << 1 + rand() % 3
-
-				<< "," << str1 + str2 + str3 << "," << (1 + rand() % 9) * 1000000 << ","
-
-				<< (rand() % 2 == 1 ? "BUY" : "SELL") << std::endl;
-
-		}
-
-	}
-
-	file.close();
-
-}
-
-void inquiries_data() {
-
-	std::ofstream file;
-
-	file.open("inquiries.txt", std::ios::out | std::ios::trunc);
-
-	file << "CUSIP, side, quantity, price, state\n";
-
-	for (int i = 0; i < 10; ++i) {
-
-		for (int j = 0; j < 6; ++j) {
-
-			file << CUSIPS[j] + ',' + (rand() % 2 == 0 ? "BUY" : "SELL") + ',' + std::to_string(rand() % 1000 * i) + ',' + "100" + ',' + "RECEIVED" << endl;
-
-		}
-
-	}
-
-}
-
-
-void market_data() {
-
-	auto Price2String = [](int num) {
-
-		int num1 = num / 256, num2 = num % 256,
-
-			num3 = num2 / 8, num4 = num2 % 8;
-
-		string str1 = std::to_string(99 + num1) + "-",
-
-			str2 = std::to_string(num3), str3 = std::to_string(num4);
-
-		if (num3 < 10) str2 = "0" + str2;
-
-		if (num4 == 4)	str3 = "+";
-
-		return str1 + str2 + str3;
-
-	};
-
-
-	std::ofstream file;
-
-	file.open("marketdata.txt", std::ios::out | std::ios::trunc);
-
-	file << "CUSIP,bidprice1,quantity,bidprice2,quantity,bidprice3,quantity,bidprice4,quantity,bidprice5,quantity,";
-
-	file << "offerprice1,quantity,offerprice2,quantity,offerprice3,quantity,offerprice4,quantity,offerprice5,quantity,\n";
-	
-	for (int j = 1; j <= 10; ++j) {
-
-		for (int i = 1; i <= 6; ++i) {
-
-			string cus_ip = CUSIPS[i - 1];
-
-			file << cus_ip << ',';
-
-			int mid_num = rand() % (256 * 2 + 1);
-
-			int bid_num = mid_num - 1;
-
-			for (int k = 1; k <= 5; ++k) {
-
-				int quantity = 1000000 * k;
-
-				file << Price2String(bid_num--) << ',' << quantity << ',';
-
-			}
-
-			int offer_num = mid_num + 1;
-
-			for (int k = 1; k <= 5; ++k) {
-
-				string offer_price = Price2String(offer_num++);
-
-				int quantity = 1000000 * k;
-
-				file << offer_price << ',' << quantity << ',';
-
-			}
-
-			file << endl;
-
-		}
-
-	}
-
-}
-
-
-void prices_data() {
-
-	auto Price2String = [](int num) {
-
-		int num1 = num / 256, num2 = num % 256,
-
-			num3 = num2 / 8, num4 = num2 % 8;
-
-		string str1 = std::to_string(99 + num1) + "-",
-
-			str2 = std::to_string(num3), str3 = std::to_string(num4);
-
-		if (num3 < 10) str2 = "0" + str2;
-
-		if (num4 == 4)	str3 = "+";
-
-		return str1 + str2 + str3;
-
-	};
-
-	std::ofstream file;
-
-	file.open("prices.txt", std::ios::out | std::ios::trunc);
-
-	file << "CUSIP,mid,bidofferspread\n";
-
-	for (int j = 1; j <= 100; ++j) {
-
-		for (int i = 1; i <= 6; ++i) {
-
-			int mid_num = rand() % (256 * 2 - 8) + 4;
-
-			int tmp = (rand() % 3 + 2);
-
-			std::string osc_str = "0-00" + (tmp == 4 ? "+" : std::to_string(tmp));
-
-			file << CUSIPS[i - 1] << "," << Price2String(mid_num) << ',' << osc_str << endl;
-
-		}
-
-	}
-
-}
-
-#endif
+#ifndef DATAGENERATING_HPP
+#define DATAGENERATING_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <fstream> 
+#include <string>
+#include <boost/date_time/gregorian/gregorian.hpp>
+#include "products.hpp"
+#include "priceformat.hpp"
+
+using namespace std;
+using namespace boost::gregorian;
+
+
+std::vector<std::string> CUSIPS = {
+
+	"9128283H1", "9128283L2", "912828M80",
+
+	"9128283J7", "9128283F5", "912810RZ3" };
+
+
+
+
+void bond_data() {
+
+	std::vector<float> BondCoupon = { static_cast<float>(0), static_cast<float>(0), static_cast<float>(0), static_cast<float>(0), static_cast<float>(0), static_cast<float>(0) };
+
+	std::vector<date> BondMaturity = { date(2019, 11, 30), date(2020, 12, 15), date(2022, 11, 30),
+
+		date(2024, 11, 30), date(2027, 11, 15), date(2047, 11, 15) };
+
+	auto bondBook = BondBook::instance();
+
+	for (int i = 0; i < 6; ++i) {
+
+		Bond bond(CUSIPS[i], CUSIP, "T", BondCoupon[i], BondMaturity[i]);
+
+		bondBook->Add(bond);
+
+	}
+
+}
+
+
+
+void trade_data() {
+
+	std::ofstream file;
+
+	file.open("trades.txt", std::ios::out | std::ios::trunc);
+
+	file << "CUSIP,Trade_ID,Book,Price,Quantity,Side\n";
+
+	for (int i = 1; i <= 6; ++i) {
+
+		std::string CUSIP = CUSIPS[i - 1];
+
+		for (int j = 1; j <= 10; ++j) {
+
+			long ticks = 99 * TICKS_PER_POINT + rand() % (256 * 2 + 1);
+
+			file << CUSIP << ",T" << (i - 1) * 10 + j << ",TRSY" << 1 + rand() % 3
+
+				<< "," << Ticks2String(ticks) << "," << (1 + rand() % 9) * 1000000 << ","
+
+				<< (rand() % 2 == 1 ? "BUY" : "SELL") << std::endl;
+
+		}
+
+	}
+
+	file.close();
+
+}
+
+void inquiries_data() {
+
+	std::ofstream file;
+
+	file.open("inquiries.txt", std::ios::out | std::ios::trunc);
+
+	file << "CUSIP, side, quantity, price, state\n";
+
+	for (int i = 0; i < 10; ++i) {
+
+		for (int j = 0; j < 6; ++j) {
+
+			file << CUSIPS[j] + ',' + (rand() % 2 == 0 ? "BUY" : "SELL") + ',' + std::to_string(rand() % 1000 * i) + ',' + "100" + ',' + "RECEIVED" << endl;
+
+		}
+
+	}
+
+}
+
+
+void market_data() {
+
+	std::ofstream file;
+
+	file.open("marketdata.txt", std::ios::out | std::ios::trunc);
+
+	file << "CUSIP,bidprice1,quantity,bidprice2,quantity,bidprice3,quantity,bidprice4,quantity,bidprice5,quantity,";
+
+	file << "offerprice1,quantity,offerprice2,quantity,offerprice3,quantity,offerprice4,quantity,offerprice5,quantity,\n";
+	
+	for (int j = 1; j <= 10; ++j) {
+
+		for (int i = 1; i <= 6; ++i) {
+
+			string cus_ip = CUSIPS[i - 1];
+
+			file << cus_ip << ',';
+
+			int mid_num = rand() % (256 * 2 + 1);
+
+			int bid_num = mid_num - 1;
+
+			for (int k = 1; k <= 5; ++k) {
+
+				int quantity = 1000000 * k;
+
+				file << Ticks2String(99 * TICKS_PER_POINT + bid_num--) << ',' << quantity << ',';
+
+			}
+
+			int offer_num = mid_num + 1;
+
+			for (int k = 1; k <= 5; ++k) {
+
+				string offer_price = Ticks2String(99 * TICKS_PER_POINT + offer_num++);
+
+				int quantity = 1000000 * k;
+
+				file << offer_price << ',' << quantity << ',';
+
+			}
+
+			file << endl;
+
+		}
+
+	}
+
+}
+
+
+// Incremental level updates, one per row: CUSIP,side,level,action,price,quantity, read by
+// BondMarketDataConnector::SubscribeDeltas after the snapshots. Each book is first set level by level
+// to a ladder around a mid; after that levels are added below the last one or just inside the touch,
+// deleted and resized, keeping each side in price order with between 1 and 10 levels.
+void market_data_deltas(const string &path = "marketdatadeltas.txt") {
+
+	std::ofstream file;
+
+	file.open(path, std::ios::out | std::ios::trunc);
+
+	file << "CUSIP,side,level,action,price,quantity\n";
+
+	for (int i = 1; i <= 6; ++i) {
+
+		string cus_ip = CUSIPS[i - 1];
+
+		int mid_num = rand() % (256 * 2 - 40) + 20;
+
+		// ticks over 99 at each level, best first
+		std::vector<int> bids, offers;
+
+		for (int k = 1; k <= 5; ++k) {
+
+			bids.push_back(mid_num - k);
+
+			offers.push_back(mid_num + k);
+
+			file << cus_ip << ",BID," << k - 1 << ",MODIFY," << Ticks2String(99 * TICKS_PER_POINT + bids.back()) << ',' << 1000000 * k << endl;
+
+			file << cus_ip << ",OFFER," << k - 1 << ",MODIFY," << Ticks2String(99 * TICKS_PER_POINT + offers.back()) << ',' << 1000000 * k << endl;
+
+		}
+
+		for (int j = 1; j <= 20; ++j) {
+
+			bool bid = (rand() % 2 == 0);
+
+			std::vector<int>& levels = (bid ? bids : offers);
+
+			string side = (bid ? ",BID," : ",OFFER,");
+
+			int quantity = 1000000 * (1 + rand() % 5);
+
+			int action = rand() % 4;
+
+			if (action == 0 && levels.size() < 10) {
+
+				int price = levels.back() + (bid ? -1 : 1);
+
+				file << cus_ip << side << levels.size() << ",ADD," << Ticks2String(99 * TICKS_PER_POINT + price) << ',' << quantity << endl;
+
+				levels.push_back(price);
+
+			}
+
+			else if (action == 1 && bids.front() + 2 < offers.front()) {
+
+				int price = levels.front() + (bid ? 1 : -1);
+
+				file << cus_ip << side << 0 << ",ADD," << Ticks2String(99 * TICKS_PER_POINT + price) << ',' << quantity << endl;
+
+				levels.insert(levels.begin(), price);
+
+			}
+
+			else if (action == 2 && levels.size() > 1) {
+
+				int level = rand() % static_cast<int>(levels.size());
+
+				file << cus_ip << side << level << ",DELETE," << Ticks2String(99 * TICKS_PER_POINT + levels[level]) << ",0" << endl;
+
+				levels.erase(levels.begin() + level);
+
+			}
+
+			else {
+
+				int level = rand() % static_cast<int>(levels.size());
+
+				file << cus_ip << side << level << ",MODIFY," << Ticks2String(99 * TICKS_PER_POINT + levels[level]) << ',' << quantity << endl;
+
+			}
+
+		}
+
+	}
+
+}
+
+
+void prices_data() {
+
+	std::ofstream file;
+
+	file.open("prices.txt", std::ios::out | std::ios::trunc);
+
+	file << "CUSIP,mid,bidofferspread\n";
+
+	for (int j = 1; j <= 100; ++j) {
+
+		for (int i = 1; i <= 6; ++i) {
+
+			int mid_num = rand() % (256 * 2 - 8) + 4;
+
+			int tmp = (rand() % 3 + 2);
+
+			std::string osc_str = "0-00" + (tmp == 4 ? "+" : std::to_string(tmp));
+
+			file << CUSIPS[i - 1] << "," << Ticks2String(99 * TICKS_PER_POINT + mid_num) << ',' << osc_str << endl;
+
+		}
+
+	}
+
+}
+
+#endif
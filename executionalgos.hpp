@@ -0,0 +1,224 @@
+/**
+ * executionalgos.hpp
+ * Execution strategies for the algo execution service.
+ * A strategy is a policy class the service is compiled with, so running it on each
+ * book is an ordinary call the compiler can inline. It keeps its per-product state in
+ * a State the service stores for each product, and sends child orders through the
+ * sink it is handed: NewParent() starts a parent order and Send(side, type, price,
+ * visible, hidden) sends a child of the current parent.
+ */
+#ifndef EXECUTION_ALGOS_HPP
+#define EXECUTION_ALGOS_HPP
+
+#include <algorithm>
+#include "marketdataservice.hpp"
+#include "matchingengine.hpp"
+
+using namespace std;
+
+/**
+ * Best bid and offer of a book, whatever order its stacks are in.
+ */
+struct Touch
+{
+  FixedPrice bid;
+  long bidQuantity;
+  FixedPrice offer;
+  long offerQuantity;
+
+  // Find the touch of a book; returns false if either side is empty
+  template<typename T>
+  bool Read(const OrderBook<T> &book);
+};
+
+/**
+ * Crosses the spread whenever it is no wider than a limit, alternating between
+ * buying the offer and selling the bid, for the size shown at the touch.
+ * Each aggression is a parent order with a single FOK child.
+ * Type T is the product type.
+ */
+template<typename T>
+class AggressWhenTight
+{
+
+public:
+
+  struct State
+  {
+    PricingSide next;
+
+    State() : next(OFFER) {}
+  };
+
+  // ctor for a strategy aggressing at spreads up to maxSpread
+  AggressWhenTight(FixedPrice _maxSpread = FixedPrice::FromTicks(2));
+
+  template<typename Orders>
+  void OnBook(const OrderBook<T> &book, State &state, Orders &orders);
+
+private:
+
+  FixedPrice maxSpread;
+
+};
+
+/**
+ * Works a parent order in equal slices, one every interval books, each a market order.
+ * A parent is started on a product with State::Start.
+ * Type T is the product type.
+ */
+template<typename T>
+class TwapSlicer
+{
+
+public:
+
+  struct State
+  {
+    PricingSide side;
+    long remaining;
+    int slicesLeft;
+    int countdown;
+    bool started;
+
+    State() : side(BID), remaining(0), slicesLeft(0), countdown(0), started(false) {}
+
+    // Work quantity on side over slices slices
+    void Start(PricingSide _side, long quantity, int slices);
+  };
+
+  // ctor for a strategy sending a slice every interval books
+  TwapSlicer(int _interval = 1);
+
+  template<typename Orders>
+  void OnBook(const OrderBook<T> &book, State &state, Orders &orders);
+
+private:
+
+  int interval;
+
+};
+
+/**
+ * Rests a parent order at the near touch as a LIMIT child showing only display
+ * quantity; the venue tops the shown quantity up from the hidden rest as it fills.
+ * A parent is started on a product with State::Start.
+ * Type T is the product type.
+ */
+template<typename T>
+class Iceberg
+{
+
+public:
+
+  struct State
+  {
+    PricingSide side;
+    long quantity;
+    long display;
+
+    State() : side(BID), quantity(0), display(0) {}
+
+    // Rest quantity on side, showing display at a time
+    void Start(PricingSide _side, long _quantity, long _display);
+  };
+
+  template<typename Orders>
+  void OnBook(const OrderBook<T> &book, State &state, Orders &orders);
+
+};
+
+template<typename T>
+bool Touch::Read(const OrderBook<T> &book)
+{
+  bidQuantity = offerQuantity = 0;
+  for (auto &order : book.GetBidStack()) {
+    if (order.GetQuantity() > 0 && (bidQuantity == 0 || order.GetPrice() > bid)) {
+      bid = order.GetPrice();
+      bidQuantity = order.GetQuantity();
+    }
+  }
+  for (auto &order : book.GetOfferStack()) {
+    if (order.GetQuantity() > 0 && (offerQuantity == 0 || order.GetPrice() < offer)) {
+      offer = order.GetPrice();
+      offerQuantity = order.GetQuantity();
+    }
+  }
+  return bidQuantity > 0 && offerQuantity > 0;
+}
+
+template<typename T>
+AggressWhenTight<T>::AggressWhenTight(FixedPrice _maxSpread) :
+  maxSpread(_maxSpread)
+{
+}
+
+template<typename T>
+template<typename Orders>
+void AggressWhenTight<T>::OnBook(const OrderBook<T> &book, State &state, Orders &orders)
+{
+  Touch touch;
+  if (!touch.Read(book) || touch.offer - touch.bid > maxSpread) return;
+
+  PricingSide side = state.next;
+  state.next = (side == BID ? OFFER : BID);
+  orders.NewParent();
+  if (side == BID) orders.Send(BID, FOK, touch.offer, touch.offerQuantity, 0);
+  else orders.Send(OFFER, FOK, touch.bid, touch.bidQuantity, 0);
+}
+
+template<typename T>
+void TwapSlicer<T>::State::Start(PricingSide _side, long quantity, int slices)
+{
+  side = _side;
+  remaining = quantity;
+  slicesLeft = max(slices, 1);
+  countdown = 0;
+  started = false;
+}
+
+template<typename T>
+TwapSlicer<T>::TwapSlicer(int _interval) :
+  interval(max(_interval, 1))
+{
+}
+
+template<typename T>
+template<typename Orders>
+void TwapSlicer<T>::OnBook(const OrderBook<T> &book, State &state, Orders &orders)
+{
+  if (state.remaining <= 0 || --state.countdown > 0) return;
+
+  if (!state.started) {
+    orders.NewParent();
+    state.started = true;
+  }
+  long slice = state.remaining / state.slicesLeft;
+  state.remaining -= slice;
+  --state.slicesLeft;
+  state.countdown = interval;
+  if (slice > 0) orders.Send(state.side, MARKET, FixedPrice(), slice, 0);
+}
+
+template<typename T>
+void Iceberg<T>::State::Start(PricingSide _side, long _quantity, long _display)
+{
+  side = _side;
+  quantity = _quantity;
+  display = max(_display, 1L);
+}
+
+template<typename T>
+template<typename Orders>
+void Iceberg<T>::OnBook(const OrderBook<T> &book, State &state, Orders &orders)
+{
+  Touch touch;
+  if (state.quantity <= 0 || !touch.Read(book)) return;
+
+  long visible = min(state.display, state.quantity);
+  orders.NewParent();
+  orders.Send(state.side, LIMIT, (state.side == BID ? touch.bid : touch.offer), visible, state.quantity - visible);
+  state.quantity = 0;
+}
+
+#endif
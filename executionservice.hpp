@@ -1,540 +1,1056 @@
-/**
- * executionservice.hpp
- * Defines the data types and Service for executions.
- *
- * @author Breman Thuraisingham
- */
-#ifndef EXECUTION_SERVICE_HPP
-#define EXECUTION_SERVICE_HPP
-
-#include <string>
-#include "soa.hpp"
-#include "marketdataservice.hpp"
-#include "datagenerating.hpp"
-#include "products.hpp"
-
-enum OrderType { FOK, IOC, MARKET, LIMIT, STOP };
-
-enum Market { BROKERTEC, ESPEED, CME };
-
-template<typename T>
-
-class ExecutionOrder
-{
-
-public:
-
-	ExecutionOrder() {};
-
-	// ctor for an order
-
-	ExecutionOrder(const T &_product, PricingSide _side, string _orderId, OrderType _orderType, double _price, double _visibleQuantity, double _hiddenQuantity, string _parentOrderId, bool _isChildOrder) :
-		product(_product)
-	{
-		side = _side;
-
-		orderId = _orderId;
-
-		orderType = _orderType;
-
-		price = _price;
-
-		visibleQuantity = _visibleQuantity;
-
-		hiddenQuantity = _hiddenQuantity;
-
-		parentOrderId = _parentOrderId;
-
-		isChildOrder = _isChildOrder;
-
-	}
-
-	const T& GetProduct() const
-
-	{
-
-		return product;
-
-	}
-
-
-	const string& GetOrderId() const
-
-	{
-
-		return orderId;
-
-	}
-
-	OrderType GetOrderType() const
-
-	{
-
-		return orderType;
-
-	}
-
-	double GetPrice() const
-
-	{
-
-		return price;
-
-	}
-
-	long GetVisibleQuantity() const
-
-	{
-
-		return static_cast<long>(visibleQuantity);
-
-	}
-
-	long GetHiddenQuantity() const
-
-	{
-
-		return static_cast<long>(hiddenQuantity);
-
-	}
-
-	const string& GetParentOrderId() const
-
-	{
-
-		return parentOrderId;
-
-	}
-
-
-	bool IsChildOrder() const
-
-	{
-
-		return isChildOrder;
-
-	}
-
-
-
-private:
-
-	T product;
-
-	PricingSide side;
-
-	string orderId;
-
-	OrderType orderType;
-
-	double price;
-
-	double visibleQuantity;
-
-	double hiddenQuantity;
-
-	string parentOrderId;
-
-	bool isChildOrder;
-
-};
-
-
-template<typename T>
-
-class AlgoExecution {
-
-public:
-	AlgoExecution() {};
-
-	ExecutionOrder<T> GetExecutionOrder() const {
-
-		return executionOrder;
-
-	}
-
-	AlgoExecution(OrderBook<T>& o) { 
-	
-		auto product = o.GetProduct();
-
-		int id = 0;
-
-		string orderID = "O" + to_string(id);
-
-		PricingSide side = ((id % 2) ? BID : OFFER);
-
-		OrderType orderType;
-
-		switch (id % 5) {
-
-		case 0: orderType = FOK; break;
-
-		case 1: orderType = MARKET; break;
-
-		case 2: orderType = LIMIT; break;
-
-		case 3: orderType = STOP; break;
-
-		case 4: orderType = IOC;
-
-		}
-
-		auto ask = o.GetOfferStack().begin();
-
-		auto bid = o.GetBidStack().begin();
-
-		double price = (side == BID ? ask->GetPrice() : bid->GetPrice());
-
-		long vQ = (side == BID ? ask->GetQuantity() : bid->GetQuantity());
-
-		long hQ = 0;
-
-		string parentID = orderID + "P";
-
-		bool isChild = false;
-
-		ExecutionOrder<Bond> Ex_tmp(product, side, orderID, orderType, price, vQ, hQ, parentID, isChild);
-
-		executionOrder = Ex_tmp;
-	
-	}
-
-private:
-
-	ExecutionOrder<T> executionOrder;
-
-};
-
-
-	
-
-class BondAlgoExecutionService : public Service<string, AlgoExecution<Bond>> {
-
-public:
-
-	static BondAlgoExecutionService* instance() {
-
-		static BondAlgoExecutionService inst;
-
-		return &inst;
-
-	}
-
-	AlgoExecution<Bond> & GetData(string product_ID) {
-
-		return algoExeData.at(product_ID);
-
-	}
-
-	void OnMessage(AlgoExecution<Bond> &b) {} 
-
-	void AddListener(ServiceListener<AlgoExecution<Bond>> *listener) {
-
-		listeners.push_back(listener);
-
-	}
-
-	const vector<ServiceListener<AlgoExecution<Bond>> *>& GetListeners() const {
-
-		return listeners;
-
-	}
-
-	void AddBook(OrderBook<Bond>& od) {
-
-		std::cout << "The algoexecution service is feeding order book of " << od.GetProduct().GetProductId() << " to the excution service." << std::endl;
-
-		Bond thisBond = od.GetProduct();
-
-		string product_ID = thisBond.GetProductId();
-
-		auto it = algoExeData.find(product_ID);
-
-		if (it == algoExeData.end()) {
-
-			AlgoExecution<Bond> newExecution(od);
-
-			algoExeData.insert(std::make_pair(product_ID, newExecution));
-
-		}
-
-		AlgoExecution<Bond> pb = algoExeData[product_ID];
-
-		for (auto& listener : listeners) 	listener->ProcessAdd(pb);
-
-	}
-
-
-
-private:
-
-	vector<ServiceListener<AlgoExecution<Bond> >*> listeners;     
-
-	std::map<std::string, AlgoExecution<Bond> > algoExeData;    
-
-	BondAlgoExecutionService() {}
-
-};
-
-
-
-
-class BondAlgoExecutionServiceListener : public ServiceListener<OrderBook<Bond>> {
-
-public:
-
-	static BondAlgoExecutionServiceListener* instance() {
-
-		static BondAlgoExecutionServiceListener inst;
-
-		return &inst;
-
-	}
-
-	void ProcessAdd(OrderBook<Bond> &data) {
-
-		bondAlgoExecutionService->AddBook(data);
-
-	}
-
-	void ProcessRemove(OrderBook<Bond> &data) {} 
-
-	void ProcessUpdate(OrderBook<Bond> &data) {} 
-
-
-	BondAlgoExecutionService* GetService() {
-
-		return bondAlgoExecutionService;
-
-	}
-
-
-
-private:
-
-	BondAlgoExecutionService* bondAlgoExecutionService;
-
-	BondAlgoExecutionServiceListener() { bondAlgoExecutionService = BondAlgoExecutionService::instance(); }
-
-};
-
-
-
-
-template<typename T>
-
-class ExecutionService : public Service<string, ExecutionOrder <T> >
-
-{
-
-public:
-
-
-	virtual void ExecuteOrder(const ExecutionOrder<T>& order, Market market) = 0;
-
-};
-
-
-
-class BondExecutionService : public ExecutionService<Bond> {
-
-public:
-
-	static BondExecutionService* instance() {
-
-		static BondExecutionService inst;
-
-		return &inst;
-
-	}
-
-
-
-	ExecutionOrder<Bond> & GetData(string product_ID) {
-
-		return executionData.at(product_ID);
-
-	}
-
-	void OnMessage(ExecutionOrder<Bond> &b) {};
-
-	void AddListener(ServiceListener<ExecutionOrder<Bond> > *listener) {
-
-		listeners.push_back(listener);
-
-	}
-
-	void AddListener(ServiceListener<Trade<Bond> > *listener) {
-
-		tradelisteners.push_back(listener);
-
-	}
-
-	const vector<ServiceListener<ExecutionOrder<Bond> > *>& GetListeners() const {
-
-		return listeners;
-
-	}
-
-
-
-	void ExecuteOrder(const ExecutionOrder<Bond> &order, Market market) {
-
-
-		Bond thisBond = order.GetProduct();
-
-		string product_ID = thisBond.GetProductId();
-
-
-
-		auto it = executionData.find(product_ID);
-
-		if (it == executionData.end()) {
-
-			ExecutionOrder<Bond> newExecution(order);
-
-			executionData.insert(std::make_pair(product_ID, newExecution));
-
-		}
-
-		auto String2Price = [](std::string& str) {
-
-			size_t idx = str.find_first_of('-');
-
-			double result = std::stoi(str.substr(0, idx));
-
-			int num1 = std::stoi(str.substr(idx + 1, 2));
-
-			char ch = str[str.size() - 1];
-
-			if (ch == '+') ch = '4';
-
-			int num2 = ch - '0';
-
-			result += (num1 * 8 + num2) / 256.0;
-
-			return result;
-
-		};
-
-		ExecutionOrder<Bond> pb = executionData[product_ID];
-
-		for (auto& listener : listeners) 	listener->ProcessAdd(pb);
-
-		std::cout << "The bond execution service is generating the trade of " << product_ID << "." << std::endl;
-
-		for (int j = 1; j <= 10; ++j) {
-
-			int num, num1, num2, num3, num4;
-
-			std::string str1, str2, str3;
-
-			num = rand() % (256 * 2 + 1);
-
-			num1 = num / 256; num2 = num % 256;
-
-			num3 = num2 / 8; num4 = num2 % 8;
-
-			str1 = std::to_string(99 + num1) + "-";
-
-			str2 = std::to_string(num3);
-
-			str3 = std::to_string(num4);
-
-			if (num4 == 4)	str3 = "+";
-
-			if (num3 < 10) str2 = "0" + str2;
-
-			string cusip, tradeId, book, price, quantity, side;
-
-			price = str1 + str2 + str3;
-
-			tradeId = "T_" + product_ID + std::to_string(j);
-
-			book = "TSRY" + std::to_string(1 + rand() % 3);
-
-			quantity = std::to_string((1 + rand() % 9) * 1000000);
-
-			side = (rand() % 2 == 1 ? "BUY" : "SELL");
-
-			Trade<Bond> trade(thisBond, tradeId, String2Price(price), book, std::stol(quantity), (side == "BUY" ? BUY : SELL));
-		
-			for (auto& listener : tradelisteners) 	listener->ProcessAdd(trade);
-		}
-
-
-	}
-
-
-	void AddAlgoExecution(const AlgoExecution<Bond>& algo) {
-
-		auto eo = algo.GetExecutionOrder();
-
-		string product_ID = eo.GetProduct().GetProductId();
-
-		executionData[product_ID] = eo;
-
-		std::cout << "The bond execution service is receiving the execution order of " << product_ID << " from the algoexecution service." << std::endl;
-
-		ExecuteOrder(eo, CME);
-
-	}
-
-
-private:
-
-	std::vector<ServiceListener<ExecutionOrder<Bond> >*> listeners;
-
-	std::vector<ServiceListener<Trade<Bond> >*> tradelisteners;
-
-	std::map<std::string, ExecutionOrder<Bond> > executionData;
-
-	BondExecutionService() {}
-
-};
-
-
-
-
-class BondExecutionServiceListener : public ServiceListener<AlgoExecution<Bond>> {
-
-public:
-
-	static BondExecutionServiceListener* instance() {
-
-		static BondExecutionServiceListener inst;
-
-		return &inst;
-
-	}
-
-	void ProcessAdd(AlgoExecution<Bond> &data) {
-
-		auto eo = data.GetExecutionOrder();
-
-		bondExecutionService->AddAlgoExecution(data);
-
-
-	}
-
-	void ProcessRemove(AlgoExecution<Bond> &data) {} 
-
-	void ProcessUpdate(AlgoExecution<Bond> &data) {}
-
-
-
-	BondExecutionService* GetService() {
-
-		return bondExecutionService;
-
-	}
-
-private:
-
-	BondExecutionService* bondExecutionService;
-
-	BondExecutionServiceListener() { bondExecutionService = BondExecutionService::instance(); }
-
-};
-
-#endif
+/**
+ * executionservice.hpp
+ * Defines the data types and Service for executions.
+ *
+ * @author Breman Thuraisingham
+ */
+#ifndef EXECUTION_SERVICE_HPP
+#define EXECUTION_SERVICE_HPP
+
+#include <string>
+#include "soa.hpp"
+#include "keyedstore.hpp"
+#include "marketdataservice.hpp"
+#include "datagenerating.hpp"
+#include "priceformat.hpp"
+#include "products.hpp"
+#include "matchingengine.hpp"
+#include "executionalgos.hpp"
+#include "orderidtable.hpp"
+
+template<typename T>
+
+class ExecutionOrder
+{
+
+public:
+
+	ExecutionOrder() : product(&ProductRegistry<T>::instance()->GetDefault()), side(BID), orderType(FOK), price(), visibleQuantity(0), hiddenQuantity(0), isChildOrder(false) {};
+
+	// ctor for an order
+
+	ExecutionOrder(const T &_product, PricingSide _side, string _orderId, OrderType _orderType, FixedPrice _price, long _visibleQuantity, long _hiddenQuantity, string _parentOrderId, bool _isChildOrder) :
+		ExecutionOrder(&ProductRegistry<T>::instance()->Intern(_product), _side, _orderId, _orderType, _price, _visibleQuantity, _hiddenQuantity, _parentOrderId, _isChildOrder)
+	{
+	}
+
+	// ctor for an order on a product already interned in the ProductRegistry, skipping the registry lookup
+
+	ExecutionOrder(const T *_product, PricingSide _side, string _orderId, OrderType _orderType, FixedPrice _price, long _visibleQuantity, long _hiddenQuantity, string _parentOrderId, bool _isChildOrder) :
+		product(_product)
+	{
+		side = _side;
+
+		orderId = _orderId;
+
+		orderType = _orderType;
+
+		price = _price;
+
+		visibleQuantity = _visibleQuantity;
+
+		hiddenQuantity = _hiddenQuantity;
+
+		parentOrderId = _parentOrderId;
+
+		isChildOrder = _isChildOrder;
+
+	}
+
+	const T& GetProduct() const
+
+	{
+
+		return *product;
+
+	}
+
+
+	PricingSide GetSide() const
+
+	{
+
+		return side;
+
+	}
+
+
+	const string& GetOrderId() const
+
+	{
+
+		return orderId;
+
+	}
+
+	OrderType GetOrderType() const
+
+	{
+
+		return orderType;
+
+	}
+
+	FixedPrice GetPrice() const
+
+	{
+
+		return price;
+
+	}
+
+	long GetVisibleQuantity() const
+
+	{
+
+		return visibleQuantity;
+
+	}
+
+	long GetHiddenQuantity() const
+
+	{
+
+		return hiddenQuantity;
+
+	}
+
+	const string& GetParentOrderId() const
+
+	{
+
+		return parentOrderId;
+
+	}
+
+
+	bool IsChildOrder() const
+
+	{
+
+		return isChildOrder;
+
+	}
+
+
+
+private:
+
+	const T* product;
+
+	PricingSide side;
+
+	string orderId;
+
+	OrderType orderType;
+
+	FixedPrice price;
+
+	long visibleQuantity;
+
+	long hiddenQuantity;
+
+	string parentOrderId;
+
+	bool isChildOrder;
+
+};
+
+
+template<typename T>
+
+class AlgoExecution {
+
+public:
+	AlgoExecution() {};
+
+	// an algo execution carries a child order sent by the service's strategy
+
+	AlgoExecution(const ExecutionOrder<T>& order) : executionOrder(order) {}
+
+	const ExecutionOrder<T>& GetExecutionOrder() const {
+
+		return executionOrder;
+
+	}
+
+private:
+
+	ExecutionOrder<T> executionOrder;
+
+};
+
+
+
+
+// Runs a strategy policy (see executionalgos.hpp) on each book, keeping every product's strategy state and current parent order
+
+template<typename T, typename Strategy>
+
+class AlgoExecutionEngine {
+
+public:
+
+	typedef typename Strategy::State State;
+
+	AlgoExecutionEngine(const Strategy& _strategy = Strategy()) : strategy(_strategy), parentCount(0), childCount(0) {}
+
+	// Run the strategy on a book, appending the child orders it sends
+
+	void OnBook(const OrderBook<T>& book, vector<ExecutionOrder<T> >& orders) {
+
+		Slot& slot = slots.AtIndex(slots.Assign(&book.GetProduct()));
+
+		Sink sink(*this, slot, book.GetProduct(), orders);
+
+		strategy.OnBook(book, slot.state, sink);
+
+	}
+
+	// Get the strategy state of a product, for instance to start a parent order on it
+
+	State& GetState(const T& product) {
+
+		return slots.AtIndex(slots.Assign(&ProductRegistry<T>::instance()->Intern(product))).state;
+
+	}
+
+	Strategy& GetStrategy() {
+
+		return strategy;
+
+	}
+
+private:
+
+	struct Slot {
+
+		State state;
+
+		string parentId;
+
+	};
+
+	// Numbers parent and child orders across all products and collects the children
+
+	class Sink {
+
+	public:
+
+		Sink(AlgoExecutionEngine& _engine, Slot& _slot, const T& _product, vector<ExecutionOrder<T> >& _orders) :
+
+			engine(_engine), slot(_slot), product(_product), orders(_orders) {}
+
+		void NewParent() {
+
+			slot.parentId = "P" + std::to_string(++engine.parentCount);
+
+		}
+
+		void Send(PricingSide side, OrderType type, FixedPrice price, long visible, long hidden) {
+
+			orders.push_back(ExecutionOrder<T>(&product, side, "O" + std::to_string(++engine.childCount), type, price, visible, hidden, slot.parentId, true));
+
+		}
+
+	private:
+
+		AlgoExecutionEngine& engine;
+
+		Slot& slot;
+
+		const T& product;
+
+		vector<ExecutionOrder<T> >& orders;
+
+	};
+
+	Strategy strategy;
+
+	// one slot per product, in the order products were first seen
+
+	KeyedStore<const T*, Slot> slots;
+
+	long parentCount;
+
+	long childCount;
+
+};
+
+
+
+
+template<typename T, typename Strategy>
+
+class AlgoExecutionService : public Service<string, AlgoExecution<T> > {
+
+public:
+
+	AlgoExecutionService(const Strategy& strategy = Strategy()) : engine(strategy) {}
+
+	AlgoExecution<T> & GetData(string product_ID) {
+
+		return algoExeData.at(product_ID);
+
+	}
+
+	void OnMessage(AlgoExecution<T> &b) {}
+
+	void AddListener(ServiceListener<AlgoExecution<T> > *listener) {
+
+		listeners.push_back(listener);
+
+	}
+
+	const vector<ServiceListener<AlgoExecution<T> > *>& GetListeners() const {
+
+		return listeners;
+
+	}
+
+	// Run the strategy on a book and hand each child order it sends to the listeners
+
+	void AddBook(OrderBook<T>& od) {
+
+		std::cout << "The algoexecution service is feeding order book of " << od.GetProduct().GetProductId() << " to the excution service." << std::endl;
+
+		children.clear();
+
+		engine.OnBook(od, children);
+
+		for (auto& child : children) {
+
+			AlgoExecution<T>& stored = algoExeData[child.GetProduct().GetProductId()];
+
+			stored = AlgoExecution<T>(child);
+
+			for (auto& listener : listeners) 	listener->ProcessAdd(stored);
+
+		}
+
+	}
+
+	AlgoExecutionEngine<T, Strategy>& GetEngine() {
+
+		return engine;
+
+	}
+
+private:
+
+	vector<ServiceListener<AlgoExecution<T> >*> listeners;
+
+	KeyedStore<std::string, AlgoExecution<T> > algoExeData;
+
+	AlgoExecutionEngine<T, Strategy> engine;
+
+	vector<ExecutionOrder<T> > children;
+
+};
+
+
+
+
+// The bond desk aggresses when the spread is at its tightest; a service with another Strategy runs another algo
+
+class BondAlgoExecutionService : public AlgoExecutionService<Bond, AggressWhenTight<Bond> > {
+
+public:
+
+	static BondAlgoExecutionService* instance() {
+
+		static BondAlgoExecutionService inst;
+
+		return &inst;
+
+	}
+
+private:
+
+	BondAlgoExecutionService() {}
+
+};
+
+
+
+
+class BondAlgoExecutionServiceListener : public ServiceListener<OrderBook<Bond>> {
+
+public:
+
+	static BondAlgoExecutionServiceListener* instance() {
+
+		static BondAlgoExecutionServiceListener inst;
+
+		return &inst;
+
+	}
+
+	void ProcessAdd(OrderBook<Bond> &data) {
+
+		bondAlgoExecutionService->AddBook(data);
+
+	}
+
+	void ProcessRemove(OrderBook<Bond> &data) {} 
+
+	// Updates carry only the changed levels, so work from the full book held by the market data service
+	void ProcessUpdate(OrderBook<Bond> &data) {
+
+		bondAlgoExecutionService->AddBook(BondMarketDataService::instance()->GetData(data.GetProduct().GetProductId()));
+
+	} 
+
+
+	BondAlgoExecutionService* GetService() {
+
+		return bondAlgoExecutionService;
+
+	}
+
+
+
+private:
+
+	BondAlgoExecutionService* bondAlgoExecutionService;
+
+	BondAlgoExecutionServiceListener() { bondAlgoExecutionService = BondAlgoExecutionService::instance(); }
+
+};
+
+
+
+
+// A parent order worked by an OrderManager
+
+template<typename T>
+
+struct ParentOrder {
+
+	uint64_t id;
+
+	const T* product;
+
+	PricingSide side;
+
+	OrderType orderType;
+
+	FixedPrice price;
+
+	Market market;
+
+	// quantity shown per child, quantity not yet sent to the venue, and quantity filled
+
+	long display;
+
+	long unsent;
+
+	long filled;
+
+	// the child on the venue, or 0
+
+	uint64_t liveChild;
+
+	long childOpen;
+
+};
+
+
+
+
+// Works parent orders a child at a time. A parent's visible quantity is the size of each child and its hidden
+// quantity is held back here, so the venue never sees more than one child's worth of it. LIMIT children rest,
+// and when one fills completely the next is sliced from what is left. IOC, FOK and MARKET children take what
+// the venue has, and one which does not fill completely ends its parent. A STOP parent goes out as a single child,
+// which ends it once it triggers and takes what the book has.
+// Parents and live children are kept in OrderIdTables keyed by integer id, so applying a fill is constant time.
+
+template<typename T>
+
+class OrderManager {
+
+public:
+
+	OrderManager(size_t capacity = 1024) : parentIndex(capacity), children(capacity), nextId(0) {}
+
+	// Start working a parent; its first child is appended to orders. Returns the parent's id, or 0 if it has no quantity
+
+	uint64_t AddParent(const T& product, PricingSide side, OrderType orderType, FixedPrice price, long visible, long hidden, Market market, vector<ExecutionOrder<T> >& orders) {
+
+		long total = visible + hidden;
+
+		if (total <= 0) return 0;
+
+		uint32_t slot;
+
+		if (!freeSlots.empty()) {
+
+			slot = freeSlots.back();
+
+			freeSlots.pop_back();
+
+		}
+
+		else {
+
+			slot = static_cast<uint32_t>(parents.size());
+
+			parents.push_back(ParentOrder<T>());
+
+		}
+
+		ParentOrder<T>& parent = parents[slot];
+
+		parent.id = ++nextId;
+
+		parent.product = &ProductRegistry<T>::instance()->Intern(product);
+
+		parent.side = side;
+
+		parent.orderType = orderType;
+
+		parent.price = price;
+
+		parent.market = market;
+
+		parent.display = (visible > 0 && orderType != STOP ? visible : total);
+
+		parent.unsent = total;
+
+		parent.filled = 0;
+
+		parent.liveChild = 0;
+
+		parent.childOpen = 0;
+
+		parentIndex.Insert(parent.id, slot);
+
+		Slice(slot, orders);
+
+		return parent.id;
+
+	}
+
+	// Apply a fill of a child; when it leaves the child complete the next child, if any, is appended to orders.
+	// Returns false for a child which is not live, such as one whose parent was cancelled
+
+	bool OnFill(uint64_t childId, long quantity, vector<ExecutionOrder<T> >& orders) {
+
+		uint32_t* slot = children.Find(childId);
+
+		if (!slot) return false;
+
+		ParentOrder<T>& parent = parents[*slot];
+
+		long applied = min(quantity, parent.childOpen);
+
+		parent.filled += applied;
+
+		parent.childOpen -= applied;
+
+		if (parent.childOpen > 0) return true;
+
+		uint32_t done = *slot;
+
+		children.Erase(childId);
+
+		parent.liveChild = 0;
+
+		if (parent.unsent > 0) Slice(done, orders);
+
+		else Finish(done);
+
+		return true;
+
+	}
+
+	// The venue has dropped what is left of a child, as it does for IOC, FOK, MARKET and triggered STOP orders; its parent ends.
+	// Returns false for a child which is not live, including one which filled completely
+
+	bool OnChildDone(uint64_t childId) {
+
+		uint32_t* slot = children.Find(childId);
+
+		if (!slot) return false;
+
+		uint32_t done = *slot;
+
+		children.Erase(childId);
+
+		Finish(done);
+
+		return true;
+
+	}
+
+	// Stop working a parent; fills of its live child are ignored from now on, so the caller takes the child off its venue.
+	// Returns false for an unknown parent
+
+	bool CancelParent(uint64_t parentId) {
+
+		uint32_t* slot = parentIndex.Find(parentId);
+
+		if (!slot) return false;
+
+		uint32_t done = *slot;
+
+		if (parents[done].liveChild) children.Erase(parents[done].liveChild);
+
+		Finish(done);
+
+		return true;
+
+	}
+
+	// Get a parent which is still being worked, or nullptr
+
+	const ParentOrder<T>* GetParent(uint64_t parentId) const {
+
+		const uint32_t* slot = parentIndex.Find(parentId);
+
+		return (slot ? &parents[*slot] : nullptr);
+
+	}
+
+	// Get the parent of a live child, or nullptr
+
+	const ParentOrder<T>* GetParentOfChild(uint64_t childId) const {
+
+		const uint32_t* slot = children.Find(childId);
+
+		return (slot ? &parents[*slot] : nullptr);
+
+	}
+
+	size_t GetParentCount() const {
+
+		return parentIndex.Size();
+
+	}
+
+	size_t GetChildCount() const {
+
+		return children.Size();
+
+	}
+
+	// Ids of managed orders as they appear on ExecutionOrders: "M<n>" for parents and "C<n>" for children
+
+	static string ParentOrderId(uint64_t id) {
+
+		return "M" + std::to_string(id);
+
+	}
+
+	static string ChildOrderId(uint64_t id) {
+
+		return "C" + std::to_string(id);
+
+	}
+
+	// Get the integer id of a child from its order id, or 0 if the order is not a managed child
+
+	static uint64_t ChildId(const string& orderId) {
+
+		if (orderId.size() < 2 || orderId[0] != 'C') return 0;
+
+		uint64_t id = 0;
+
+		for (size_t i = 1; i < orderId.size(); ++i) {
+
+			if (orderId[i] < '0' || orderId[i] > '9') return 0;
+
+			id = id * 10 + (orderId[i] - '0');
+
+		}
+
+		return id;
+
+	}
+
+private:
+
+	// Send the next child of a parent, of its display size or what is left
+
+	void Slice(uint32_t slot, vector<ExecutionOrder<T> >& orders) {
+
+		ParentOrder<T>& parent = parents[slot];
+
+		long quantity = min(parent.display, parent.unsent);
+
+		parent.unsent -= quantity;
+
+		parent.liveChild = ++nextId;
+
+		parent.childOpen = quantity;
+
+		children.Insert(parent.liveChild, slot);
+
+		orders.push_back(ExecutionOrder<T>(parent.product, parent.side, ChildOrderId(parent.liveChild), parent.orderType, parent.price, quantity, 0, ParentOrderId(parent.id), true));
+
+	}
+
+	void Finish(uint32_t slot) {
+
+		parentIndex.Erase(parents[slot].id);
+
+		parents[slot].liveChild = 0;
+
+		freeSlots.push_back(slot);
+
+	}
+
+	// parents in slots reused once they finish, found by id through parentIndex; children map to their parent's slot
+
+	vector<ParentOrder<T> > parents;
+
+	vector<uint32_t> freeSlots;
+
+	OrderIdTable<uint32_t> parentIndex;
+
+	OrderIdTable<uint32_t> children;
+
+	uint64_t nextId;
+
+};
+
+
+
+
+template<typename T>
+
+class ExecutionService : public Service<string, ExecutionOrder <T> >
+
+{
+
+public:
+
+
+	virtual void ExecuteOrder(const ExecutionOrder<T>& order, Market market) = 0;
+
+};
+
+
+
+class BondExecutionService : public ExecutionService<Bond> {
+
+public:
+
+	static BondExecutionService* instance() {
+
+		static BondExecutionService inst;
+
+		return &inst;
+
+	}
+
+
+
+	ExecutionOrder<Bond> & GetData(string product_ID) {
+
+		return executionData.at(product_ID);
+
+	}
+
+	void OnMessage(ExecutionOrder<Bond> &b) {};
+
+	void AddListener(ServiceListener<ExecutionOrder<Bond> > *listener) {
+
+		listeners.push_back(listener);
+
+	}
+
+	void AddListener(ServiceListener<Trade<Bond> > *listener) {
+
+		tradelisteners.push_back(listener);
+
+	}
+
+	const vector<ServiceListener<ExecutionOrder<Bond> > *>& GetListeners() const {
+
+		return listeners;
+
+	}
+
+
+
+	// Match the order on its venue and book whatever it fills as trades
+
+	void ExecuteOrder(const ExecutionOrder<Bond> &order, Market market) {
+
+
+		const Bond& thisBond = order.GetProduct();
+
+		const string& product_ID = thisBond.GetProductId();
+
+
+
+		// the product's latest order is kept and handed to the listeners; AddAlgoExecution passes the kept one itself
+
+		ExecutionOrder<Bond>& stored = executionData[product_ID];
+
+		if (&stored != &order) stored = order;
+
+		for (auto& listener : listeners) 	listener->ProcessAdd(stored);
+
+		std::cout << "The bond execution service is generating the trade of " << product_ID << "." << std::endl;
+
+		fills.clear();
+
+		// a managed child rests under its integer id, so cancelling its parent finds it directly
+
+		uint64_t childId = OrderManager<Bond>::ChildId(stored.GetOrderId());
+
+		venues[market].Match(stored, fills, childId);
+
+		PublishFills(thisBond, market, fills);
+
+		// the venue drops whatever an aggressive order leaves, which ends a managed child's parent
+
+		if (childId && (stored.GetOrderType() == IOC || stored.GetOrderType() == FOK || stored.GetOrderType() == MARKET)) orderManager.OnChildDone(childId);
+
+		WorkSlices();
+
+	}
+
+	// Work a parent order on a venue a child of its visible quantity at a time; returns its id, or 0 if it has no quantity
+
+	uint64_t ExecuteParent(const Bond &bond, PricingSide side, OrderType orderType, FixedPrice price, long visible, long hidden, Market market) {
+
+		uint64_t parentId = orderManager.AddParent(bond, side, orderType, price, visible, hidden, market, slices);
+
+		WorkSlices();
+
+		return parentId;
+
+	}
+
+	// Stop working a parent, taking its live child off the venue first so that it cannot fill; returns false for an unknown parent
+
+	bool CancelParent(uint64_t parentId) {
+
+		const ParentOrder<Bond>* parent = orderManager.GetParent(parentId);
+
+		if (!parent) return false;
+
+		if (parent->liveChild) venues[parent->market].Cancel(parent->liveChild);
+
+		return orderManager.CancelParent(parentId);
+
+	}
+
+	OrderManager<Bond>& GetOrderManager() {
+
+		return orderManager;
+
+	}
+
+	// Refresh every venue's liquidity for a product; resting and stop orders the book reaches are booked
+
+	void OnBook(const OrderBook<Bond> &book) {
+
+		for (auto& venue : venues) {
+
+			fills.clear();
+
+			venue.OnBook(book, fills);
+
+			PublishFills(book.GetProduct(), venue.GetMarket(), fills);
+
+		}
+
+		WorkSlices();
+
+	}
+
+	MatchingEngine<Bond>& GetVenue(Market market) {
+
+		return venues[market];
+
+	}
+
+
+	void AddAlgoExecution(const AlgoExecution<Bond>& algo) {
+
+		const ExecutionOrder<Bond>& eo = algo.GetExecutionOrder();
+
+		const string& product_ID = eo.GetProduct().GetProductId();
+
+		ExecutionOrder<Bond>& stored = executionData[product_ID];
+
+		stored = eo;
+
+		std::cout << "The bond execution service is receiving the execution order of " << product_ID << " from the algoexecution service." << std::endl;
+
+		ExecuteOrder(stored, CME);
+
+	}
+
+
+private:
+
+	std::vector<ServiceListener<ExecutionOrder<Bond> >*> listeners;
+
+	// Book each fill as a trade, in the book kept for the venue; bond is an order's or book's product, so already interned
+
+	void PublishFills(const Bond &bond, Market market, const vector<VenueFill> &venueFills) {
+
+		for (auto& fill : venueFills) {
+
+			string tradeId = "T" + std::to_string(++tradeCount);
+
+			string book = "TSRY" + std::to_string(1 + market);
+
+			Trade<Bond> trade(&bond, tradeId, fill.price, book, fill.quantity, (fill.side == BID ? BUY : SELL));
+
+			for (auto& listener : tradelisteners) 	listener->ProcessAdd(trade);
+
+			uint64_t childId = OrderManager<Bond>::ChildId(fill.orderId);
+
+			if (!childId) continue;
+
+			orderManager.OnFill(childId, fill.quantity, slices);
+
+			// a triggered stop's remainder is dropped, which ends its parent unless that fill completed the child
+
+			if (fill.done) orderManager.OnChildDone(childId);
+
+		}
+
+	}
+
+	// Send the children sliced by fills; a child sent here may fill and slice another, which joins the end of the list
+
+	void WorkSlices() {
+
+		if (working) return;
+
+		working = true;
+
+		for (size_t i = 0; i < slices.size(); ++i) {
+
+			ExecutionOrder<Bond> child = slices[i];
+
+			const ParentOrder<Bond>* parent = orderManager.GetParentOfChild(OrderManager<Bond>::ChildId(child.GetOrderId()));
+
+			if (parent) ExecuteOrder(child, parent->market);
+
+		}
+
+		slices.clear();
+
+		working = false;
+
+	}
+
+	std::vector<ServiceListener<Trade<Bond> >*> tradelisteners;
+
+	KeyedStore<std::string, ExecutionOrder<Bond> > executionData;
+
+	// one simulated venue per Market, indexed by it
+
+	vector<MatchingEngine<Bond> > venues;
+
+	vector<VenueFill> fills;
+
+	long tradeCount;
+
+	OrderManager<Bond> orderManager;
+
+	vector<ExecutionOrder<Bond> > slices;
+
+	bool working;
+
+	BondExecutionService() : venues{ MatchingEngine<Bond>(BROKERTEC), MatchingEngine<Bond>(ESPEED), MatchingEngine<Bond>(CME) }, tradeCount(0), working(false) {}
+
+};
+
+
+
+
+// Keeps the venues' liquidity current; register it on the market data service ahead of the algo execution listener
+
+class BondVenueBookListener : public ServiceListener<OrderBook<Bond>> {
+
+public:
+
+	static BondVenueBookListener* instance() {
+
+		static BondVenueBookListener inst;
+
+		return &inst;
+
+	}
+
+	void ProcessAdd(OrderBook<Bond> &data) {
+
+		bondExecutionService->OnBook(data);
+
+	}
+
+	void ProcessRemove(OrderBook<Bond> &data) {}
+
+	// Updates carry only the changed levels, so refresh from the full book held by the market data service
+	void ProcessUpdate(OrderBook<Bond> &data) {
+
+		bondExecutionService->OnBook(BondMarketDataService::instance()->GetData(data.GetProduct().GetProductId()));
+
+	}
+
+	BondExecutionService* GetService() {
+
+		return bondExecutionService;
+
+	}
+
+private:
+
+	BondExecutionService* bondExecutionService;
+
+	BondVenueBookListener() { bondExecutionService = BondExecutionService::instance(); }
+
+};
+
+
+
+
+class BondExecutionServiceListener : public ServiceListener<AlgoExecution<Bond>> {
+
+public:
+
+	static BondExecutionServiceListener* instance() {
+
+		static BondExecutionServiceListener inst;
+
+		return &inst;
+
+	}
+
+	void ProcessAdd(AlgoExecution<Bond> &data) {
+
+		bondExecutionService->AddAlgoExecution(data);
+
+
+	}
+
+	void ProcessRemove(AlgoExecution<Bond> &data) {} 
+
+	void ProcessUpdate(AlgoExecution<Bond> &data) {}
+
+
+
+	BondExecutionService* GetService() {
+
+		return bondExecutionService;
+
+	}
+
+private:
+
+	BondExecutionService* bondExecutionService;
+
+	BondExecutionServiceListener() { bondExecutionService = BondExecutionService::instance(); }
+
+};
+
+#endif
@@ -0,0 +1,641 @@
+/**
+ * journal.hpp
+ * Compact binary journal for the historical records and the connector inputs, and a
+ * reader which turns a journal back into text or replays it through a visitor.
+ *
+ * A journal starts with an 8 byte file header (magic and version) and is then a
+ * sequence of records, each a fixed 16 byte JournalHeader followed by its payload.
+ * Product ids are interned: the first record for a product in a session is preceded
+ * by a PRODUCT record mapping a 32 bit id to its id string, and a later definition of
+ * the same id replaces the mapping, so sessions can be appended to the same file.
+ * Prices are stored as 32 bit fixed point in 1/65536ths of a point, which holds every
+ * 1/256th tick and half tick exactly for prices below 32768. Fields are in host byte order.
+ */
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include "soa.hpp"
+#include "products.hpp"
+#include "priceformat.hpp"
+#include "marketdataservice.hpp"
+#include "pricingservice.hpp"
+#include "tradebookingservice.hpp"
+#include "riskservice.hpp"
+#include "executionservice.hpp"
+#include "streamingservice.hpp"
+#include "inquiryservice.hpp"
+#include "persistence.hpp"
+
+using namespace std;
+
+// Text written by the historical connectors, shared with the journal reader
+const char* const PV01_TEXT_FORMAT = "PV01 of %s is %f\n";
+const char* const EXECUTION_TEXT_FORMAT = "Executing the order of bond %s\n";
+const char* const STREAM_TEXT_FORMAT = "The bond %s has bid price %f and offer price %f\n";
+const char* const INQUIRY_TEXT_FORMAT = "The inquire ID is %s and %s Side , the product is %s, the quantity is %ld, the price is %f\n";
+
+enum JournalRecordType { JOURNAL_PRODUCT = 1, JOURNAL_PV01 = 2, JOURNAL_EXECUTION = 3, JOURNAL_STREAM = 4, JOURNAL_INQUIRY = 5,
+  JOURNAL_ORDER_BOOK = 6, JOURNAL_ORDER_BOOK_DELTA = 7, JOURNAL_PRICE = 8, JOURNAL_TRADE = 9 };
+
+const char JOURNAL_MAGIC[4] = { 'B', 'T', 'S', 'J' };
+const uint32_t JOURNAL_VERSION = 1;
+const int32_t JOURNAL_PRICE_SCALE = 65536;
+
+/**
+ * Fixed size header in front of every record.
+ */
+struct JournalHeader
+{
+
+  uint16_t type;
+  uint16_t size;
+  uint32_t productId;
+  int64_t timestamp;
+
+};
+
+static_assert(sizeof(JournalHeader) == 16, "JournalHeader must be 16 bytes");
+
+// Convert a price to and from its fixed point journal representation
+inline int32_t Price2Fixed(double price)
+{
+  return static_cast<int32_t>(lround(price * JOURNAL_PRICE_SCALE));
+}
+
+inline double Fixed2Price(int32_t fixed)
+{
+  return static_cast<double>(fixed) / JOURNAL_PRICE_SCALE;
+}
+
+// Tick prices convert exactly, as the journal scale is a whole number of ticks
+inline int32_t Price2Fixed(FixedPrice price)
+{
+  return static_cast<int32_t>(price.GetTicks() * (JOURNAL_PRICE_SCALE / TICKS_PER_POINT));
+}
+
+inline FixedPrice Fixed2FixedPrice(int32_t fixed)
+{
+  return FixedPrice::FromDouble(Fixed2Price(fixed));
+}
+
+/**
+ * Appends records to one journal file through the PersistenceEngine.
+ * Write may be called from any thread.
+ */
+class JournalWriter
+{
+
+public:
+
+  // ctor opens the journal for append, writing the file header if the file is new
+  JournalWriter(const string &path);
+
+  // Append one record
+  void Write(const PV01<Bond> &data);
+  void Write(const ExecutionOrder<Bond> &data);
+  void Write(const PriceStream<Bond> &data);
+  void Write(const Inquiry<Bond> &data);
+  void Write(const OrderBook<Bond> &data);
+  void Write(const OrderBookDelta &data);
+  void Write(const Price<Bond> &data);
+  void Write(const Trade<Bond> &data);
+
+  // Get the underlying file writer
+  BufferedFileWriter* GetWriter() const;
+
+private:
+
+  // Record being encoded on the stack; fields past RECORD_SIZE are dropped
+  // A record is built in place; a field that does not fit throws length_error rather than being left out
+  struct Record
+  {
+    char data[BufferedFileWriter::RECORD_SIZE];
+    size_t size;
+
+    template<typename V>
+    void Put(V value);
+    void PutString(const string &value);
+  };
+
+  // Get the id of a product, defining it in the journal on first use; called under lock
+  uint32_t Intern(const string &productId, int64_t timestamp);
+
+  void Begin(Record &record, JournalRecordType type, uint32_t productId, int64_t timestamp);
+  void End(Record &record);
+
+  BufferedFileWriter *writer;
+  mutex lock;
+  map<string, uint32_t> productIds;
+
+};
+
+/**
+ * Base for journal visitors which ignores every record type.
+ * Derived visitors bring these in with a using declaration and override the ones they need.
+ */
+struct JournalVisitor
+{
+
+  void OnRecord(const PV01<Bond>&, int64_t) {}
+  void OnRecord(const ExecutionOrder<Bond>&, int64_t) {}
+  void OnRecord(const PriceStream<Bond>&, int64_t) {}
+  void OnRecord(const Inquiry<Bond>&, int64_t) {}
+  void OnRecord(const OrderBook<Bond>&, int64_t) {}
+  void OnRecord(const OrderBookDelta&, int64_t) {}
+  void OnRecord(const Price<Bond>&, int64_t) {}
+  void OnRecord(const Trade<Bond>&, int64_t) {}
+
+};
+
+/**
+ * Reads a whole journal and hands each record with its timestamp to a visitor
+ * providing the OnRecord overloads of JournalVisitor.
+ * Products are taken from the BondBook when it knows them, otherwise rebuilt as
+ * bonds carrying only their CUSIP.
+ */
+class JournalReader
+{
+
+public:
+
+  // ctor reads the file; throws runtime_error if it cannot be opened or is not a journal
+  JournalReader(const string &path);
+
+  // Visit every record in order and return the number visited; throws runtime_error on a corrupt record
+  template<typename V>
+  size_t ForEachRecord(V &visitor);
+
+  // Write every record as text: historical records in the format of the historical
+  // connectors, inputs as rows of the file their connector reads
+  size_t ToText(ostream &os);
+
+private:
+
+  // Reads payload fields, throwing if a record is shorter than its fields
+  struct Cursor
+  {
+    const char *p;
+    const char *end;
+
+    template<typename V>
+    V Get();
+    string GetString();
+  };
+
+  string path;
+  vector<char> data;
+  map<uint32_t, const Bond*> products;
+
+  const Bond& GetProduct(uint32_t productId) const;
+
+};
+
+JournalWriter::JournalWriter(const string &path)
+{
+  ifstream probe(path, ios::binary | ios::ate);
+  bool empty = !probe || probe.tellg() <= 0;
+  writer = PersistenceEngine::instance()->GetWriter(path, true);
+  if (empty && writer->GetBytesAppended() == 0) {
+    writer->Append(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    writer->Append(reinterpret_cast<const char*>(&JOURNAL_VERSION), sizeof(JOURNAL_VERSION));
+  }
+}
+
+template<typename V>
+void JournalWriter::Record::Put(V value)
+{
+  if (size + sizeof(V) > sizeof(data)) throw length_error("journal record longer than " + to_string(sizeof(data)) + " bytes");
+  memcpy(data + size, &value, sizeof(V));
+  size += sizeof(V);
+}
+
+void JournalWriter::Record::PutString(const string &value)
+{
+  size_t length = value.size();
+  if (size + sizeof(uint16_t) + length > sizeof(data)) throw length_error("journal string of " + to_string(length) + " bytes does not fit its record");
+  Put(static_cast<uint16_t>(length));
+  memcpy(data + size, value.data(), length);
+  size += length;
+}
+
+uint32_t JournalWriter::Intern(const string &productId, int64_t timestamp)
+{
+  auto it = productIds.find(productId);
+  if (it != productIds.end()) return it->second;
+
+  // the id is only taken once its definition is written, so a product id too long to journal is not left undefined
+  uint32_t id = static_cast<uint32_t>(productIds.size() + 1);
+  Record record;
+  Begin(record, JOURNAL_PRODUCT, id, timestamp);
+  record.PutString(productId);
+  End(record);
+  productIds.insert(make_pair(productId, id));
+  return id;
+}
+
+void JournalWriter::Begin(Record &record, JournalRecordType type, uint32_t productId, int64_t timestamp)
+{
+  JournalHeader header = { static_cast<uint16_t>(type), 0, productId, timestamp };
+  memcpy(record.data, &header, sizeof(header));
+  record.size = sizeof(header);
+}
+
+void JournalWriter::End(Record &record)
+{
+  uint16_t size = static_cast<uint16_t>(record.size - sizeof(JournalHeader));
+  memcpy(record.data + offsetof(JournalHeader, size), &size, sizeof(size));
+  writer->Append(record.data, record.size);
+}
+
+void JournalWriter::Write(const PV01<Bond> &data)
+{
+  int64_t timestamp = NowNanos();
+  lock_guard<mutex> guard(lock);
+  Record record;
+  Begin(record, JOURNAL_PV01, Intern(data.GetProduct().GetProductId(), timestamp), timestamp);
+  record.Put(data.GetPV01());
+  record.Put(static_cast<int64_t>(data.GetQuantity()));
+  End(record);
+}
+
+void JournalWriter::Write(const ExecutionOrder<Bond> &data)
+{
+  int64_t timestamp = NowNanos();
+  lock_guard<mutex> guard(lock);
+  Record record;
+  Begin(record, JOURNAL_EXECUTION, Intern(data.GetProduct().GetProductId(), timestamp), timestamp);
+  record.Put(static_cast<uint8_t>(data.GetSide()));
+  record.Put(static_cast<uint8_t>(data.GetOrderType()));
+  record.Put(static_cast<uint8_t>(data.IsChildOrder()));
+  record.Put(Price2Fixed(data.GetPrice()));
+  record.Put(static_cast<int64_t>(data.GetVisibleQuantity()));
+  record.Put(static_cast<int64_t>(data.GetHiddenQuantity()));
+  record.PutString(data.GetOrderId());
+  record.PutString(data.GetParentOrderId());
+  End(record);
+}
+
+void JournalWriter::Write(const PriceStream<Bond> &data)
+{
+  int64_t timestamp = NowNanos();
+  lock_guard<mutex> guard(lock);
+  Record record;
+  Begin(record, JOURNAL_STREAM, Intern(data.GetProduct().GetProductId(), timestamp), timestamp);
+  for (const PriceStreamOrder *order : { &data.GetBidOrder(), &data.GetOfferOrder() }) {
+    record.Put(Price2Fixed(order->GetPrice()));
+    record.Put(static_cast<int64_t>(order->GetVisibleQuantity()));
+    record.Put(static_cast<int64_t>(order->GetHiddenQuantity()));
+  }
+  End(record);
+}
+
+void JournalWriter::Write(const Inquiry<Bond> &data)
+{
+  int64_t timestamp = NowNanos();
+  lock_guard<mutex> guard(lock);
+  Record record;
+  Begin(record, JOURNAL_INQUIRY, Intern(data.GetProduct().GetProductId(), timestamp), timestamp);
+  record.Put(static_cast<uint8_t>(data.GetSide()));
+  record.Put(static_cast<uint8_t>(data.GetState()));
+  record.Put(static_cast<int64_t>(data.GetQuantity()));
+  record.Put(Price2Fixed(data.GetPrice()));
+  record.PutString(data.GetInquiryId());
+  End(record);
+}
+
+void JournalWriter::Write(const OrderBook<Bond> &data)
+{
+  int64_t timestamp = NowNanos();
+  lock_guard<mutex> guard(lock);
+  Record record;
+  Begin(record, JOURNAL_ORDER_BOOK, Intern(data.GetProduct().GetProductId(), timestamp), timestamp);
+  record.Put(static_cast<uint8_t>(data.GetBidStack().size()));
+  record.Put(static_cast<uint8_t>(data.GetOfferStack().size()));
+  for (const vector<Order> *stack : { &data.GetBidStack(), &data.GetOfferStack() }) {
+    for (auto &order : *stack) {
+      record.Put(Price2Fixed(order.GetPrice()));
+      record.Put(static_cast<int64_t>(order.GetQuantity()));
+    }
+  }
+  End(record);
+}
+
+void JournalWriter::Write(const OrderBookDelta &data)
+{
+  int64_t timestamp = NowNanos();
+  lock_guard<mutex> guard(lock);
+  Record record;
+  Begin(record, JOURNAL_ORDER_BOOK_DELTA, Intern(data.GetProductId(), timestamp), timestamp);
+  record.Put(static_cast<uint8_t>(data.GetSide()));
+  record.Put(static_cast<uint8_t>(data.GetAction()));
+  record.Put(static_cast<uint16_t>(data.GetLevel()));
+  record.Put(Price2Fixed(data.GetOrder().GetPrice()));
+  record.Put(static_cast<int64_t>(data.GetOrder().GetQuantity()));
+  End(record);
+}
+
+void JournalWriter::Write(const Price<Bond> &data)
+{
+  int64_t timestamp = NowNanos();
+  lock_guard<mutex> guard(lock);
+  Record record;
+  Begin(record, JOURNAL_PRICE, Intern(data.GetProduct().GetProductId(), timestamp), timestamp);
+  record.Put(Price2Fixed(data.GetMid()));
+  record.Put(Price2Fixed(data.GetBidOfferSpread()));
+  End(record);
+}
+
+void JournalWriter::Write(const Trade<Bond> &data)
+{
+  int64_t timestamp = NowNanos();
+  lock_guard<mutex> guard(lock);
+  Record record;
+  Begin(record, JOURNAL_TRADE, Intern(data.GetProduct().GetProductId(), timestamp), timestamp);
+  record.Put(static_cast<uint8_t>(data.GetSide()));
+  record.Put(Price2Fixed(data.GetPrice()));
+  record.Put(static_cast<int64_t>(data.GetQuantity()));
+  record.PutString(data.GetTradeId());
+  record.PutString(data.GetBook());
+  End(record);
+}
+
+BufferedFileWriter* JournalWriter::GetWriter() const
+{
+  return writer;
+}
+
+JournalReader::JournalReader(const string &_path) :
+  path(_path)
+{
+  ifstream file(path, ios::binary | ios::ate);
+  if (!file) throw runtime_error("cannot open " + path);
+  data.resize(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(data.data(), data.size());
+
+  if (data.size() < sizeof(JOURNAL_MAGIC) + sizeof(JOURNAL_VERSION) || memcmp(data.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0)
+    throw runtime_error(path + " is not a journal");
+  uint32_t version;
+  memcpy(&version, data.data() + sizeof(JOURNAL_MAGIC), sizeof(version));
+  if (version != JOURNAL_VERSION) throw runtime_error(path + " has unsupported journal version " + to_string(version));
+}
+
+template<typename V>
+V JournalReader::Cursor::Get()
+{
+  if (end - p < static_cast<ptrdiff_t>(sizeof(V))) throw runtime_error("truncated journal record");
+  V value;
+  memcpy(&value, p, sizeof(V));
+  p += sizeof(V);
+  return value;
+}
+
+string JournalReader::Cursor::GetString()
+{
+  uint16_t length = Get<uint16_t>();
+  if (end - p < length) throw runtime_error("truncated journal record");
+  string value(p, length);
+  p += length;
+  return value;
+}
+
+const Bond& JournalReader::GetProduct(uint32_t productId) const
+{
+  auto it = products.find(productId);
+  if (it == products.end()) throw runtime_error("journal record refers to undefined product " + to_string(productId));
+  return *it->second;
+}
+
+template<typename V>
+size_t JournalReader::ForEachRecord(V &visitor)
+{
+  size_t records = 0;
+  const char *p = data.data() + sizeof(JOURNAL_MAGIC) + sizeof(JOURNAL_VERSION);
+  const char *end = data.data() + data.size();
+
+  while (p < end) {
+    if (end - p < static_cast<ptrdiff_t>(sizeof(JournalHeader))) throw runtime_error(path + ": truncated journal header");
+    JournalHeader header;
+    memcpy(&header, p, sizeof(header));
+    p += sizeof(header);
+    if (end - p < header.size) throw runtime_error(path + ": truncated journal record");
+    Cursor cursor = { p, p + header.size };
+    p += header.size;
+
+    switch (header.type) {
+    case JOURNAL_PRODUCT: {
+      string productId = cursor.GetString();
+      const Bond *bond = BondBook::instance()->Find(productId);
+      products[header.productId] = (bond ? bond : &ProductRegistry<Bond>::instance()->Intern(Bond(productId, CUSIP, "", 0, date())));
+      continue;
+    }
+    case JOURNAL_PV01: {
+      double pv01 = cursor.Get<double>();
+      long quantity = static_cast<long>(cursor.Get<int64_t>());
+      visitor.OnRecord(PV01<Bond>(GetProduct(header.productId), pv01, quantity), header.timestamp);
+      break;
+    }
+    case JOURNAL_EXECUTION: {
+      PricingSide side = static_cast<PricingSide>(cursor.Get<uint8_t>());
+      OrderType orderType = static_cast<OrderType>(cursor.Get<uint8_t>());
+      bool isChild = cursor.Get<uint8_t>() != 0;
+      FixedPrice price = Fixed2FixedPrice(cursor.Get<int32_t>());
+      long visible = static_cast<long>(cursor.Get<int64_t>());
+      long hidden = static_cast<long>(cursor.Get<int64_t>());
+      string orderId = cursor.GetString();
+      string parentOrderId = cursor.GetString();
+      visitor.OnRecord(ExecutionOrder<Bond>(&GetProduct(header.productId), side, orderId, orderType, price, visible, hidden, parentOrderId, isChild), header.timestamp);
+      break;
+    }
+    case JOURNAL_STREAM: {
+      FixedPrice bidPrice = Fixed2FixedPrice(cursor.Get<int32_t>());
+      long bidVisible = static_cast<long>(cursor.Get<int64_t>());
+      long bidHidden = static_cast<long>(cursor.Get<int64_t>());
+      FixedPrice offerPrice = Fixed2FixedPrice(cursor.Get<int32_t>());
+      long offerVisible = static_cast<long>(cursor.Get<int64_t>());
+      long offerHidden = static_cast<long>(cursor.Get<int64_t>());
+      PriceStreamOrder bid(bidPrice, bidVisible, bidHidden, BID);
+      PriceStreamOrder offer(offerPrice, offerVisible, offerHidden, OFFER);
+      visitor.OnRecord(PriceStream<Bond>(&GetProduct(header.productId), bid, offer), header.timestamp);
+      break;
+    }
+    case JOURNAL_INQUIRY: {
+      Side side = static_cast<Side>(cursor.Get<uint8_t>());
+      InquiryState state = static_cast<InquiryState>(cursor.Get<uint8_t>());
+      long quantity = static_cast<long>(cursor.Get<int64_t>());
+      double price = Fixed2Price(cursor.Get<int32_t>());
+      string inquiryId = cursor.GetString();
+      visitor.OnRecord(Inquiry<Bond>(inquiryId, &GetProduct(header.productId), side, quantity, price, state), header.timestamp);
+      break;
+    }
+    case JOURNAL_ORDER_BOOK: {
+      size_t bids = cursor.Get<uint8_t>();
+      size_t offers = cursor.Get<uint8_t>();
+      vector<Order> bid_stack, offer_stack;
+      for (size_t k = 0; k < bids + offers; ++k) {
+        FixedPrice price = Fixed2FixedPrice(cursor.Get<int32_t>());
+        long quantity = static_cast<long>(cursor.Get<int64_t>());
+        if (k < bids) bid_stack.push_back(Order(price, quantity, BID));
+        else offer_stack.push_back(Order(price, quantity, OFFER));
+      }
+      visitor.OnRecord(OrderBook<Bond>(&GetProduct(header.productId), bid_stack, offer_stack), header.timestamp);
+      break;
+    }
+    case JOURNAL_ORDER_BOOK_DELTA: {
+      PricingSide side = static_cast<PricingSide>(cursor.Get<uint8_t>());
+      LevelAction action = static_cast<LevelAction>(cursor.Get<uint8_t>());
+      int level = cursor.Get<uint16_t>();
+      FixedPrice price = Fixed2FixedPrice(cursor.Get<int32_t>());
+      long quantity = static_cast<long>(cursor.Get<int64_t>());
+      visitor.OnRecord(OrderBookDelta(GetProduct(header.productId).GetProductId(), side, level, action, price, quantity), header.timestamp);
+      break;
+    }
+    case JOURNAL_PRICE: {
+      FixedPrice mid = Fixed2FixedPrice(cursor.Get<int32_t>());
+      FixedPrice spread = Fixed2FixedPrice(cursor.Get<int32_t>());
+      visitor.OnRecord(Price<Bond>(&GetProduct(header.productId), mid, spread, header.timestamp), header.timestamp);
+      break;
+    }
+    case JOURNAL_TRADE: {
+      Side side = static_cast<Side>(cursor.Get<uint8_t>());
+      FixedPrice price = Fixed2FixedPrice(cursor.Get<int32_t>());
+      long quantity = static_cast<long>(cursor.Get<int64_t>());
+      string tradeId = cursor.GetString();
+      string book = cursor.GetString();
+      visitor.OnRecord(Trade<Bond>(&GetProduct(header.productId), tradeId, price, book, quantity, side), header.timestamp);
+      break;
+    }
+    default:
+      // records from a newer writer are skipped
+      continue;
+    }
+
+    ++records;
+  }
+
+  return records;
+}
+
+size_t JournalReader::ToText(ostream &os)
+{
+  struct TextVisitor
+  {
+    ostream &os;
+    char line[BufferedFileWriter::RECORD_SIZE];
+
+    TextVisitor(ostream &_os) : os(_os), line() {}
+
+    void Emit(int size)
+    {
+      if (size < 0) return;
+      os.write(line, static_cast<size_t>(size) < sizeof(line) ? size : sizeof(line) - 1);
+    }
+
+    void OnRecord(const PV01<Bond> &data, int64_t)
+    {
+      Emit(snprintf(line, sizeof(line), PV01_TEXT_FORMAT, data.GetProduct().GetProductId().c_str(), data.GetPV01()));
+    }
+
+    void OnRecord(const ExecutionOrder<Bond> &data, int64_t)
+    {
+      Emit(snprintf(line, sizeof(line), EXECUTION_TEXT_FORMAT, data.GetProduct().GetProductId().c_str()));
+    }
+
+    void OnRecord(const PriceStream<Bond> &data, int64_t)
+    {
+      Emit(snprintf(line, sizeof(line), STREAM_TEXT_FORMAT, data.GetProduct().GetProductId().c_str(), data.GetBidOrder().GetPrice().ToDouble(), data.GetOfferOrder().GetPrice().ToDouble()));
+    }
+
+    void OnRecord(const Inquiry<Bond> &data, int64_t)
+    {
+      Emit(snprintf(line, sizeof(line), INQUIRY_TEXT_FORMAT, data.GetInquiryId().c_str(), (data.GetSide() == BUY ? "BUY" : "SELL"),
+        data.GetProduct().GetProductId().c_str(), data.GetQuantity(), data.GetPrice()));
+    }
+
+    void OnRecord(const OrderBook<Bond> &data, int64_t)
+    {
+      os << data.GetProduct().GetProductId() << ',';
+      for (auto &order : data.GetBidStack()) os << Price2String(order.GetPrice()) << ',' << order.GetQuantity() << ',';
+      for (auto &order : data.GetOfferStack()) os << Price2String(order.GetPrice()) << ',' << order.GetQuantity() << ',';
+      os << '\n';
+    }
+
+    void OnRecord(const OrderBookDelta &data, int64_t)
+    {
+      static const char* const actions[] = { "ADD", "MODIFY", "DELETE" };
+      os << data.GetProductId() << ',' << (data.GetSide() == BID ? "BID" : "OFFER") << ',' << data.GetLevel() << ',' << actions[data.GetAction()] << ','
+        << Price2String(data.GetOrder().GetPrice()) << ',' << data.GetOrder().GetQuantity() << '\n';
+    }
+
+    void OnRecord(const Price<Bond> &data, int64_t)
+    {
+      os << data.GetProduct().GetProductId() << ',' << Price2String(data.GetMid()) << ',' << Price2String(data.GetBidOfferSpread()) << '\n';
+    }
+
+    void OnRecord(const Trade<Bond> &data, int64_t)
+    {
+      os << data.GetProduct().GetProductId() << ',' << data.GetTradeId() << ',' << data.GetBook() << ',' << Price2String(data.GetPrice()) << ','
+        << data.GetQuantity() << ',' << (data.GetSide() == BUY ? "BUY" : "SELL") << '\n';
+    }
+  };
+
+  TextVisitor visitor(os);
+  return ForEachRecord(visitor);
+}
+
+/**
+ * Listener which appends every added value to a journal; connectors use it to record their inputs.
+ */
+template<typename V>
+class JournalServiceListener : public ServiceListener<V>
+{
+
+public:
+
+  // ctor for a listener writing to a journal it does not own
+  JournalServiceListener(JournalWriter *_journal);
+
+  void ProcessAdd(V &data);
+  void ProcessRemove(V &data);
+  void ProcessUpdate(V &data);
+
+private:
+  JournalWriter *journal;
+
+};
+
+template<typename V>
+JournalServiceListener<V>::JournalServiceListener(JournalWriter *_journal) :
+  journal(_journal)
+{
+}
+
+template<typename V>
+void JournalServiceListener<V>::ProcessAdd(V &data)
+{
+  journal->Write(data);
+}
+
+template<typename V>
+void JournalServiceListener<V>::ProcessRemove(V &data)
+{
+}
+
+template<typename V>
+void JournalServiceListener<V>::ProcessUpdate(V &data)
+{
+}
+
+#endif
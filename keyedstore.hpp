@@ -0,0 +1,213 @@
+/**
+ * keyedstore.hpp
+ * Keyed store for service data: each key is given a dense index the first time
+ * it is seen, values are kept in insertion order in a deque, and a hash index
+ * maps keys to their dense index.
+ */
+#ifndef KEYED_STORE_HPP
+#define KEYED_STORE_HPP
+
+#include <deque>
+#include <unordered_map>
+#include <utility>
+#include <tuple>
+#include <functional>
+#include <stdexcept>
+
+using namespace std;
+
+/**
+ * Store of values keyed on K with dense indices.
+ * Offers the part of the std::map interface the services use (at, operator[],
+ * insert, find, count and iteration, in insertion order), so it can replace a
+ * map member as is; callers which keep an index can skip the hash with AtIndex.
+ * The deque keeps values contiguous in blocks, and references stay valid as keys are added.
+ * Type K is the key type and V the value type.
+ */
+template<typename K, typename V, typename H = hash<K> >
+class KeyedStore
+{
+
+public:
+
+  typedef pair<K, V> value_type;
+  typedef typename deque<value_type>::iterator iterator;
+  typedef typename deque<value_type>::const_iterator const_iterator;
+
+  static const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+  // Get the dense index of a key, or NOT_FOUND
+  size_t IndexOf(const K &key) const;
+
+  // Get the dense index of a key, adding it with a default value on first use
+  size_t Assign(const K &key);
+
+  // Get the key and value at a dense index
+  const K& KeyAt(size_t index) const;
+  V& AtIndex(size_t index);
+  const V& AtIndex(size_t index) const;
+
+  // Get the value for a key, throwing out_of_range if it is absent
+  V& at(const K &key);
+  const V& at(const K &key) const;
+
+  // Get the value for a key, adding a default value if it is absent
+  V& operator[](const K &key);
+
+  // Add an entry unless its key is present; returns the entry for the key and whether it was added
+  pair<iterator, bool> insert(const value_type &entry);
+
+  // Find the entry for a key, or end()
+  iterator find(const K &key);
+  const_iterator find(const K &key) const;
+
+  // Get 1 if the key is present, otherwise 0
+  size_t count(const K &key) const;
+
+  iterator begin();
+  iterator end();
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  size_t size() const;
+  bool empty() const;
+
+  // Size the hash index for an expected number of keys
+  void reserve(size_t keys);
+
+private:
+  deque<value_type> entries;
+  unordered_map<K, size_t, H> index;
+
+};
+
+template<typename K, typename V, typename H>
+size_t KeyedStore<K, V, H>::IndexOf(const K &key) const
+{
+  auto it = index.find(key);
+  return (it == index.end() ? NOT_FOUND : it->second);
+}
+
+template<typename K, typename V, typename H>
+size_t KeyedStore<K, V, H>::Assign(const K &key)
+{
+  auto it = index.find(key);
+  if (it != index.end()) return it->second;
+  entries.emplace_back(piecewise_construct, forward_as_tuple(key), forward_as_tuple());
+  index.insert(make_pair(key, entries.size() - 1));
+  return entries.size() - 1;
+}
+
+template<typename K, typename V, typename H>
+const K& KeyedStore<K, V, H>::KeyAt(size_t i) const
+{
+  return entries[i].first;
+}
+
+template<typename K, typename V, typename H>
+V& KeyedStore<K, V, H>::AtIndex(size_t i)
+{
+  return entries[i].second;
+}
+
+template<typename K, typename V, typename H>
+const V& KeyedStore<K, V, H>::AtIndex(size_t i) const
+{
+  return entries[i].second;
+}
+
+template<typename K, typename V, typename H>
+V& KeyedStore<K, V, H>::at(const K &key)
+{
+  size_t i = IndexOf(key);
+  if (i == NOT_FOUND) throw out_of_range("KeyedStore::at: key not found");
+  return entries[i].second;
+}
+
+template<typename K, typename V, typename H>
+const V& KeyedStore<K, V, H>::at(const K &key) const
+{
+  size_t i = IndexOf(key);
+  if (i == NOT_FOUND) throw out_of_range("KeyedStore::at: key not found");
+  return entries[i].second;
+}
+
+template<typename K, typename V, typename H>
+V& KeyedStore<K, V, H>::operator[](const K &key)
+{
+  return entries[Assign(key)].second;
+}
+
+template<typename K, typename V, typename H>
+pair<typename KeyedStore<K, V, H>::iterator, bool> KeyedStore<K, V, H>::insert(const value_type &entry)
+{
+  auto it = index.find(entry.first);
+  if (it != index.end()) return make_pair(entries.begin() + it->second, false);
+  entries.push_back(entry);
+  index.insert(make_pair(entry.first, entries.size() - 1));
+  return make_pair(entries.end() - 1, true);
+}
+
+template<typename K, typename V, typename H>
+typename KeyedStore<K, V, H>::iterator KeyedStore<K, V, H>::find(const K &key)
+{
+  size_t i = IndexOf(key);
+  return (i == NOT_FOUND ? entries.end() : entries.begin() + i);
+}
+
+template<typename K, typename V, typename H>
+typename KeyedStore<K, V, H>::const_iterator KeyedStore<K, V, H>::find(const K &key) const
+{
+  size_t i = IndexOf(key);
+  return (i == NOT_FOUND ? entries.end() : entries.begin() + i);
+}
+
+template<typename K, typename V, typename H>
+size_t KeyedStore<K, V, H>::count(const K &key) const
+{
+  return index.count(key);
+}
+
+template<typename K, typename V, typename H>
+typename KeyedStore<K, V, H>::iterator KeyedStore<K, V, H>::begin()
+{
+  return entries.begin();
+}
+
+template<typename K, typename V, typename H>
+typename KeyedStore<K, V, H>::iterator KeyedStore<K, V, H>::end()
+{
+  return entries.end();
+}
+
+template<typename K, typename V, typename H>
+typename KeyedStore<K, V, H>::const_iterator KeyedStore<K, V, H>::begin() const
+{
+  return entries.begin();
+}
+
+template<typename K, typename V, typename H>
+typename KeyedStore<K, V, H>::const_iterator KeyedStore<K, V, H>::end() const
+{
+  return entries.end();
+}
+
+template<typename K, typename V, typename H>
+size_t KeyedStore<K, V, H>::size() const
+{
+  return entries.size();
+}
+
+template<typename K, typename V, typename H>
+bool KeyedStore<K, V, H>::empty() const
+{
+  return entries.empty();
+}
+
+template<typename K, typename V, typename H>
+void KeyedStore<K, V, H>::reserve(size_t keys)
+{
+  index.reserve(keys);
+}
+
+#endif
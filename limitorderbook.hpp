@@ -0,0 +1,420 @@
+/**
+ * limitorderbook.hpp
+ * Full-depth limit order book with price-time priority.
+ * Price levels are 1/256 ticks held in an array indexed from a base tick, and
+ * recentred as prices move outside it. Each level queues its orders in an
+ * intrusive doubly-linked list of pooled nodes, and an OrderIdTable finds the
+ * node of any order, so adding, cancelling and executing an order take constant time.
+ */
+#ifndef LIMIT_ORDER_BOOK_HPP
+#define LIMIT_ORDER_BOOK_HPP
+
+#include <vector>
+#include <cstdint>
+#include "priceformat.hpp"
+#include "orderidtable.hpp"
+#include "marketdataservice.hpp"
+
+using namespace std;
+
+/**
+ * Order-level book for one product.
+ * Orders at a price are filled in the order they arrived; the best bid is the
+ * highest bid level and the best offer the lowest offer level.
+ * Type T is the product type.
+ */
+template<typename T>
+class LimitOrderBook
+{
+
+public:
+
+  // ctor for an empty book with room for levels ticks around the first price seen
+  LimitOrderBook(size_t levels = 1024);
+
+  // Add an order at the back of its level; returns false if the id is live
+  bool AddOrder(uint64_t id, PricingSide side, long ticks, long quantity);
+
+  // Remove an order; returns false if the id is not live
+  bool CancelOrder(uint64_t id);
+
+  // Fill part of an order, removing it once it is filled; returns the quantity filled
+  long ExecuteOrder(uint64_t id, long quantity);
+
+  // Fill an incoming order on side against the other side, best price first and in time
+  // priority within a price, up to limitTicks; onFill(id, ticks, quantity) is called for
+  // each resting order filled. Returns the quantity filled.
+  template<typename F>
+  long Sweep(PricingSide side, long limitTicks, long quantity, F onFill);
+
+  // Best prices in ticks, valid only while the side has orders
+  bool HasBid() const;
+  bool HasOffer() const;
+  long GetBestBid() const;
+  long GetBestOffer() const;
+
+  // Get the quantity and number of orders resting at a price on one side
+  long GetQuantity(PricingSide side, long ticks) const;
+  size_t GetOrderCount(PricingSide side, long ticks) const;
+
+  // Get the number of live orders
+  size_t Size() const;
+
+  // Get the top depth levels of each side as a level snapshot
+  OrderBook<T> ToOrderBook(const T &product, int depth) const;
+
+private:
+
+  static const uint32_t NIL = 0xFFFFFFFFu;
+
+  struct Node
+  {
+    uint64_t id;
+    long ticks;
+    long quantity;
+    uint32_t prev;
+    uint32_t next;
+    PricingSide side;
+  };
+
+  struct Queue
+  {
+    uint32_t head;
+    uint32_t tail;
+    long quantity;
+    uint32_t count;
+  };
+
+  struct Level
+  {
+    Queue sides[2];
+  };
+
+  // Get the level of a price, moving or growing the window to cover it
+  Level& LevelAt(long ticks);
+  const Level* FindLevel(long ticks) const;
+
+  // Unlink a node from its level and return it to the pool
+  void Remove(uint32_t node);
+
+  // Move the best price of a side past levels that have emptied
+  void RefreshBest(PricingSide side);
+
+  uint32_t Allocate();
+
+  vector<Level> levels;
+  long baseTick;
+  bool centred;
+  vector<Node> nodes;
+  uint32_t freeList;
+  OrderIdTable<uint32_t> index;
+  long bestBid;
+  long bestOffer;
+  size_t bidCount;
+  size_t offerCount;
+
+};
+
+template<typename T>
+LimitOrderBook<T>::LimitOrderBook(size_t _levels) :
+  levels(_levels < 16 ? 16 : _levels), baseTick(0), centred(false),
+  freeList(NIL), bestBid(0), bestOffer(0), bidCount(0), offerCount(0)
+{
+  for (auto &level : levels) level.sides[BID] = level.sides[OFFER] = Queue{ NIL, NIL, 0, 0 };
+}
+
+template<typename T>
+typename LimitOrderBook<T>::Level& LimitOrderBook<T>::LevelAt(long ticks)
+{
+  if (!centred) {
+    baseTick = ticks - static_cast<long>(levels.size() / 2);
+    centred = true;
+  }
+  long offset = ticks - baseTick;
+  if (offset < 0 || offset >= static_cast<long>(levels.size())) {
+    // keep the levels in use and centre them with the new price in a window at least twice the span
+    long low = min(ticks, baseTick), high = max(ticks, baseTick + static_cast<long>(levels.size()) - 1);
+    size_t size = levels.size();
+    while (static_cast<long>(size) < 2 * (high - low + 1)) size *= 2;
+    long newBase = (low + high) / 2 - static_cast<long>(size / 2);
+    vector<Level> moved(size);
+    for (auto &level : moved) level.sides[BID] = level.sides[OFFER] = Queue{ NIL, NIL, 0, 0 };
+    for (size_t i = 0; i < levels.size(); ++i) moved[baseTick + i - newBase] = levels[i];
+    levels.swap(moved);
+    baseTick = newBase;
+    offset = ticks - baseTick;
+  }
+  return levels[offset];
+}
+
+template<typename T>
+const typename LimitOrderBook<T>::Level* LimitOrderBook<T>::FindLevel(long ticks) const
+{
+  long offset = ticks - baseTick;
+  if (!centred || offset < 0 || offset >= static_cast<long>(levels.size())) return nullptr;
+  return &levels[offset];
+}
+
+template<typename T>
+uint32_t LimitOrderBook<T>::Allocate()
+{
+  if (freeList != NIL) {
+    uint32_t node = freeList;
+    freeList = nodes[node].next;
+    return node;
+  }
+  nodes.push_back(Node());
+  return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+template<typename T>
+bool LimitOrderBook<T>::AddOrder(uint64_t id, PricingSide side, long ticks, long quantity)
+{
+  if (quantity <= 0 || index.Find(id)) return false;
+
+  Queue &queue = LevelAt(ticks).sides[side];
+  uint32_t node = Allocate();
+  nodes[node] = Node{ id, ticks, quantity, queue.tail, NIL, side };
+  if (queue.tail != NIL) nodes[queue.tail].next = node;
+  else queue.head = node;
+  queue.tail = node;
+  queue.quantity += quantity;
+  ++queue.count;
+  index.Insert(id, node);
+
+  if (side == BID) {
+    if (bidCount++ == 0 || ticks > bestBid) bestBid = ticks;
+  }
+  else {
+    if (offerCount++ == 0 || ticks < bestOffer) bestOffer = ticks;
+  }
+  return true;
+}
+
+template<typename T>
+bool LimitOrderBook<T>::CancelOrder(uint64_t id)
+{
+  uint32_t *node = index.Find(id);
+  if (!node) return false;
+  Remove(*node);
+  return true;
+}
+
+template<typename T>
+long LimitOrderBook<T>::ExecuteOrder(uint64_t id, long quantity)
+{
+  uint32_t *found = index.Find(id);
+  if (!found || quantity <= 0) return 0;
+  uint32_t node = *found;
+  Node &order = nodes[node];
+  long filled = min(quantity, order.quantity);
+  if (filled == order.quantity) {
+    Remove(node);
+  }
+  else {
+    order.quantity -= filled;
+    levels[order.ticks - baseTick].sides[order.side].quantity -= filled;
+  }
+  return filled;
+}
+
+template<typename T>
+void LimitOrderBook<T>::Remove(uint32_t node)
+{
+  Node &order = nodes[node];
+  Queue &queue = levels[order.ticks - baseTick].sides[order.side];
+  if (order.prev != NIL) nodes[order.prev].next = order.next;
+  else queue.head = order.next;
+  if (order.next != NIL) nodes[order.next].prev = order.prev;
+  else queue.tail = order.prev;
+  queue.quantity -= order.quantity;
+  --queue.count;
+
+  index.Erase(order.id);
+  PricingSide side = order.side;
+  order.next = freeList;
+  freeList = node;
+
+  if (side == BID) --bidCount;
+  else --offerCount;
+  if (queue.count == 0) RefreshBest(side);
+}
+
+template<typename T>
+void LimitOrderBook<T>::RefreshBest(PricingSide side)
+{
+  if (side == BID) {
+    if (bidCount == 0) return;
+    while (levels[bestBid - baseTick].sides[BID].count == 0) --bestBid;
+  }
+  else {
+    if (offerCount == 0) return;
+    while (levels[bestOffer - baseTick].sides[OFFER].count == 0) ++bestOffer;
+  }
+}
+
+template<typename T>
+template<typename F>
+long LimitOrderBook<T>::Sweep(PricingSide side, long limitTicks, long quantity, F onFill)
+{
+  PricingSide other = (side == BID ? OFFER : BID);
+  long filled = 0;
+  while (filled < quantity && (other == OFFER ? offerCount > 0 && bestOffer <= limitTicks : bidCount > 0 && bestBid >= limitTicks)) {
+    long ticks = (other == OFFER ? bestOffer : bestBid);
+    uint32_t node = levels[ticks - baseTick].sides[other].head;
+    uint64_t id = nodes[node].id;
+    long taken = ExecuteOrder(id, quantity - filled);
+    onFill(id, ticks, taken);
+    filled += taken;
+  }
+  return filled;
+}
+
+template<typename T>
+bool LimitOrderBook<T>::HasBid() const
+{
+  return bidCount > 0;
+}
+
+template<typename T>
+bool LimitOrderBook<T>::HasOffer() const
+{
+  return offerCount > 0;
+}
+
+template<typename T>
+long LimitOrderBook<T>::GetBestBid() const
+{
+  return bestBid;
+}
+
+template<typename T>
+long LimitOrderBook<T>::GetBestOffer() const
+{
+  return bestOffer;
+}
+
+template<typename T>
+long LimitOrderBook<T>::GetQuantity(PricingSide side, long ticks) const
+{
+  const Level *level = FindLevel(ticks);
+  return (level ? level->sides[side].quantity : 0);
+}
+
+template<typename T>
+size_t LimitOrderBook<T>::GetOrderCount(PricingSide side, long ticks) const
+{
+  const Level *level = FindLevel(ticks);
+  return (level ? level->sides[side].count : 0);
+}
+
+template<typename T>
+size_t LimitOrderBook<T>::Size() const
+{
+  return index.Size();
+}
+
+template<typename T>
+OrderBook<T> LimitOrderBook<T>::ToOrderBook(const T &product, int depth) const
+{
+  vector<Order> bid_stack, offer_stack;
+  if (bidCount > 0) {
+    for (long ticks = bestBid; ticks >= baseTick && static_cast<int>(bid_stack.size()) < depth; --ticks) {
+      const Queue &queue = levels[ticks - baseTick].sides[BID];
+      if (queue.count > 0) bid_stack.push_back(Order(FixedPrice::FromTicks(ticks), queue.quantity, BID));
+    }
+  }
+  if (offerCount > 0) {
+    long last = baseTick + static_cast<long>(levels.size());
+    for (long ticks = bestOffer; ticks < last && static_cast<int>(offer_stack.size()) < depth; ++ticks) {
+      const Queue &queue = levels[ticks - baseTick].sides[OFFER];
+      if (queue.count > 0) offer_stack.push_back(Order(FixedPrice::FromTicks(ticks), queue.quantity, OFFER));
+    }
+  }
+  return OrderBook<T>(product, bid_stack, offer_stack);
+}
+
+/**
+ * Order-level storage for bond market data.
+ * Venues which send individual orders rather than level snapshots are kept here
+ * in a LimitOrderBook per CUSIP; after every change the top levels are handed to
+ * BondMarketDataService as an ordinary OrderBook<Bond>, so its best bid/offer,
+ * aggregated depth and listeners work unchanged.
+ */
+class BondLimitOrderBookService
+{
+
+public:
+
+  static BondLimitOrderBookService* instance();
+
+  // Set the number of levels per side published to the market data service
+  void SetDepth(int _depth);
+
+  // Order-level feed; returns false for an id which is already live, or not live, as the call requires
+  bool OnOrderAdd(const Bond &bond, uint64_t id, PricingSide side, FixedPrice price, long quantity);
+  bool OnOrderCancel(const string &productId, uint64_t id);
+  long OnOrderExecute(const string &productId, uint64_t id, long quantity);
+
+  // Get the full book of a CUSIP, throwing out_of_range if no order was ever added for it
+  LimitOrderBook<Bond>& GetBook(const string &productId);
+
+private:
+
+  BondLimitOrderBookService() : depth(5) {}
+
+  // Hand the top levels of a book to the market data service
+  void Publish(const string &productId);
+
+  KeyedStore<string, LimitOrderBook<Bond> > books;
+  int depth;
+
+};
+
+BondLimitOrderBookService* BondLimitOrderBookService::instance()
+{
+  static BondLimitOrderBookService inst;
+  return &inst;
+}
+
+void BondLimitOrderBookService::SetDepth(int _depth)
+{
+  depth = _depth;
+}
+
+bool BondLimitOrderBookService::OnOrderAdd(const Bond &bond, uint64_t id, PricingSide side, FixedPrice price, long quantity)
+{
+  // the book's view is published against the registered bond
+  ProductRegistry<Bond>::instance()->Intern(bond);
+  if (!books[bond.GetProductId()].AddOrder(id, side, price.GetTicks(), quantity)) return false;
+  Publish(bond.GetProductId());
+  return true;
+}
+
+bool BondLimitOrderBookService::OnOrderCancel(const string &productId, uint64_t id)
+{
+  if (!books.at(productId).CancelOrder(id)) return false;
+  Publish(productId);
+  return true;
+}
+
+long BondLimitOrderBookService::OnOrderExecute(const string &productId, uint64_t id, long quantity)
+{
+  long filled = books.at(productId).ExecuteOrder(id, quantity);
+  if (filled > 0) Publish(productId);
+  return filled;
+}
+
+LimitOrderBook<Bond>& BondLimitOrderBookService::GetBook(const string &productId)
+{
+  return books.at(productId);
+}
+
+void BondLimitOrderBookService::Publish(const string &productId)
+{
+  const Bond *bond = ProductRegistry<Bond>::instance()->Find(productId);
+  OrderBook<Bond> view = books.at(productId).ToOrderBook(*bond, depth);
+  BondMarketDataService::instance()->OnMessage(view);
+}
+
+#endif
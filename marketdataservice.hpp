@@ -1,391 +1,1039 @@
-/**
- * marketdataservice.hpp
- * Defines the data types and Service for order book market data.
- *
- * @author Breman Thuraisingham
- */
-#ifndef MARKET_DATA_SERVICE_HPP
-#define MARKET_DATA_SERVICE_HPP
-
-#include <string>
-#include <vector>
-#include <fstream>
-#include "soa.hpp"
-#include "products.hpp"
-
-using namespace std;
-
-// Side for market data
-enum PricingSide { BID, OFFER };
-
-/**
- * A market data order with price, quantity, and side.
- */
-class Order
-{
-
-public:
-
-  // ctor for an order
-  Order(double _price, long _quantity, PricingSide _side);
-
-  // Get the price on the order
-  double GetPrice() const;
-
-  // Get the quantity on the order
-  long GetQuantity() const;
-
-  // Get the side on the order
-  PricingSide GetSide() const;
-
-private:
-  double price;
-  long quantity;
-  PricingSide side;
-
-};
-
-/**
- * Class representing a bid and offer order
- */
-class BidOffer
-{
-
-public:
-
-  // ctor for bid/offer
-  BidOffer(const Order &_bidOrder, const Order &_offerOrder);
-
-  // Get the bid order
-  const Order& GetBidOrder() const;
-
-  // Get the offer order
-  const Order& GetOfferOrder() const;
-
-private:
-  Order bidOrder;
-  Order offerOrder;
-
-};
-
-/**
- * Order book with a bid and offer stack.
- * Type T is the product type.
- */
-template<typename T>
-class OrderBook
-{
-
-public:
-
-  // ctor for the order book
-  OrderBook(const T &_product, const vector<Order> &_bidStack, const vector<Order> &_offerStack);
-
-  // Get the product
-  const T& GetProduct() const;
-
-  // Get the bid stack
-  const vector<Order>& GetBidStack() const;
-
-  // Get the offer stack
-  const vector<Order>& GetOfferStack() const;
-
-private:
-  T product;
-  vector<Order> bidStack;
-  vector<Order> offerStack;
-
-};
-
-/**
- * Market Data Service which distributes market data
- * Keyed on product identifier.
- * Type T is the product type.
- */
-template<typename T>
-class MarketDataService : public Service<string,OrderBook <T> >
-{
-
-public:
-
-  // Get the best bid/offer order
-  virtual void GetBestBidOffer(const string &productId) = 0;
-
-  // Aggregate the order book
-  virtual void AggregateDepth(const string &productId) = 0;
-
-};
-
-Order::Order(double _price, long _quantity, PricingSide _side)
-{
-  price = _price;
-  quantity = _quantity;
-  side = _side;
-}
-
-double Order::GetPrice() const
-{
-  return price;
-}
- 
-long Order::GetQuantity() const
-{
-  return quantity;
-}
- 
-PricingSide Order::GetSide() const
-{
-  return side;
-}
-
-BidOffer::BidOffer(const Order &_bidOrder, const Order &_offerOrder) :
-  bidOrder(_bidOrder), offerOrder(_offerOrder)
-{
-}
-
-const Order& BidOffer::GetBidOrder() const
-{
-  return bidOrder;
-}
-
-const Order& BidOffer::GetOfferOrder() const
-{
-  return offerOrder;
-}
-
-template<typename T>
-OrderBook<T>::OrderBook(const T &_product, const vector<Order> &_bidStack, const vector<Order> &_offerStack) :
-  product(_product), bidStack(_bidStack), offerStack(_offerStack)
-{
-}
-
-template<typename T>
-const T& OrderBook<T>::GetProduct() const
-{
-  return product;
-}
-
-template<typename T>
-const vector<Order>& OrderBook<T>::GetBidStack() const
-{
-  return bidStack;
-}
-
-template<typename T>
-const vector<Order>& OrderBook<T>::GetOfferStack() const
-{
-  return offerStack;
-}
-
-
-
-class BondMarketDataService : MarketDataService<Bond> {
-
-public:
-
-	static BondMarketDataService* instance() {
-
-		static BondMarketDataService inst;
-
-		return &inst;
-
-	}
-
-
-
-	virtual void OnMessage(OrderBook <Bond> &data) {
-
-		for (auto listener : listeners) {
-
-			listener->ProcessAdd(data);
-
-		}
-
-	}
-
-	//BidOffer GetBestBidOffer(const string &productId) {};
-
-	//OrderBook<Bond> AggregateDepth(const string &productId) {};
-
-	void GetBestBidOffer(const string &productId) {};
-
-	void AggregateDepth(const string &productId) {};
-
-
-	OrderBook<Bond>& GetData(std::string _cusip) {
-
-		return marketData.at(_cusip);
-
-	}
-
-
-
-	void AddListener(ServiceListener<OrderBook<Bond>> *listener) {
-
-		listeners.push_back(listener);
-
-	}
-
-	const vector< ServiceListener<OrderBook<Bond>>* >& GetListeners() const {
-
-		return listeners;
-
-	}
-
-private:
-
-	std::map<std::string, OrderBook<Bond>> marketData;
-
-	std::vector<ServiceListener<OrderBook<Bond>>*> listeners;
-
-	BondMarketDataService() {}
-
-};
-
-
-
-class BondMarketDataConnector : public Connector<OrderBook <Bond>> {
-
-public:
-
-	static BondMarketDataConnector* instance() {
-
-		static BondMarketDataConnector inst;
-
-		return &inst;
-
-	}
-
-	void Publish(OrderBook<Bond> &data) {}
-
-	void Subscribe() {
-
-		auto SplitLine = [](std::string& line) {
-
-			stringstream enter_line(line);
-
-			std::string item;
-
-			std::vector<std::string> tmp;
-
-			while (getline(enter_line, item, ',')) 	tmp.push_back(item);
-
-			return tmp;
-
-		};
-
-		auto String2Price = [](std::string& str) {
-
-			size_t idx = str.find_first_of('-');
-
-			double result = std::stoi(str.substr(0, idx));
-
-			int num1 = std::stoi(str.substr(idx + 1, 2));
-
-			char ch = str[str.size() - 1];
-
-			if (ch == '+') ch = '4';
-
-			int num2 = ch - '0';
-
-			result += (num1 * 8 + num2) / 256.0;
-
-			return result;
-
-		};
-
-
-
-		ifstream file("marketdata.txt");
-
-		string line, cusip;
-
-		getline(file, line);
-
-		for (int i = 0; i < 12; ++i) {
-
-			getline(file, line);
-
-			std::vector<std::string> elems = SplitLine(line);
-
-			cusip = elems[0];
-
-			PricingSide side;
-
-			vector<Order> bid_stack, offer_stack;
-
-			double price;	long quantity;
-
-			int idx = 1;
-
-			for (int k = 1; k <= 5; ++k) {
-
-				price = String2Price(elems[idx++]);
-
-				quantity = std::stol(elems[idx++]);
-
-				side = BID;
-
-				Order bid_order(price, quantity, side);
-
-				bid_stack.push_back(bid_order);
-
-			}
-
-			for (int k = 1; k <= 5; ++k) {
-
-				price = String2Price(elems[idx++]);
-
-				quantity = std::stol(elems[idx++]);
-
-				side = OFFER;
-
-				Order offer_order(price, quantity, side);
-
-				offer_stack.push_back(offer_order);
-
-			}
-
-
-
-			auto bond = bondBook->GetData(cusip);
-
-			OrderBook<Bond> order_book(bond, bid_stack, offer_stack);
-
-			bondMarketDataService->OnMessage(order_book);
-
-		}
-
-		std::cout << "The marketdata service finished subscribing.\n" << std::endl;
-
-	}
-
-
-
-	BondMarketDataService* GetService() {
-
-		return bondMarketDataService;
-
-	}
-
-
-
-private:
-
-	BondMarketDataConnector() {
-
-		bondMarketDataService = BondMarketDataService::instance();
-
-		bondBook = BondBook::instance();
-
-	}
-
-	BondMarketDataService * bondMarketDataService;
-
-	BondBook * bondBook;
-
-
-
-};
-
-#endif
+/**
+ * marketdataservice.hpp
+ * Defines the data types and Service for order book market data.
+ *
+ * @author Breman Thuraisingham
+ */
+#ifndef MARKET_DATA_SERVICE_HPP
+#define MARKET_DATA_SERVICE_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include "soa.hpp"
+#include "keyedstore.hpp"
+#include "products.hpp"
+#include "priceformat.hpp"
+#include "csvreader.hpp"
+
+using namespace std;
+
+// Side for market data
+enum PricingSide { BID, OFFER };
+
+/**
+ * A market data order with price, quantity, and side.
+ */
+class Order
+{
+
+public:
+
+  // ctor for an order
+  Order(FixedPrice _price, long _quantity, PricingSide _side);
+
+  // Get the price on the order
+  FixedPrice GetPrice() const;
+
+  // Get the quantity on the order
+  long GetQuantity() const;
+
+  // Get the side on the order
+  PricingSide GetSide() const;
+
+private:
+  FixedPrice price;
+  long quantity;
+  PricingSide side;
+
+};
+
+/**
+ * Class representing a bid and offer order
+ */
+class BidOffer
+{
+
+public:
+
+  // ctor for bid/offer
+  BidOffer(const Order &_bidOrder, const Order &_offerOrder);
+
+  // Get the bid order
+  const Order& GetBidOrder() const;
+
+  // Get the offer order
+  const Order& GetOfferOrder() const;
+
+private:
+  Order bidOrder;
+  Order offerOrder;
+
+};
+
+// Actions for an incremental order book update
+enum LevelAction { ADD_LEVEL, MODIFY_LEVEL, DELETE_LEVEL };
+
+/**
+ * Incremental change to a single level of an order book.
+ * Keyed on product identifier, side and level, level 0 being the top of book.
+ * ADD_LEVEL inserts at the level, MODIFY_LEVEL replaces it and DELETE_LEVEL removes it.
+ */
+class OrderBookDelta
+{
+
+public:
+
+  // ctor for a delta; price and quantity are ignored for DELETE_LEVEL
+  OrderBookDelta(string _productId, PricingSide _side, int _level, LevelAction _action, FixedPrice _price, long _quantity);
+
+  // Get the product identifier
+  const string& GetProductId() const;
+
+  // Get the side of the book
+  PricingSide GetSide() const;
+
+  // Get the level within the side
+  int GetLevel() const;
+
+  // Get the action
+  LevelAction GetAction() const;
+
+  // Get the order for the level
+  Order GetOrder() const;
+
+private:
+  string productId;
+  PricingSide side;
+  int level;
+  LevelAction action;
+  FixedPrice price;
+  long quantity;
+
+};
+
+/**
+ * Order book with a bid and offer stack.
+ * Type T is the product type.
+ */
+template<typename T>
+class OrderBook
+{
+
+public:
+
+  // ctor for the order book
+  OrderBook(const T &_product, const vector<Order> &_bidStack, const vector<Order> &_offerStack);
+
+  // ctor for a book on a product already interned in the ProductRegistry, skipping the registry lookup
+  OrderBook(const T *_product, const vector<Order> &_bidStack, const vector<Order> &_offerStack);
+
+  // Get the product
+  const T& GetProduct() const;
+
+  // Get the bid stack
+  const vector<Order>& GetBidStack() const;
+
+  // Get the offer stack
+  const vector<Order>& GetOfferStack() const;
+
+  // Get the order at a level on one side
+  const Order& GetOrder(PricingSide side, int level) const;
+
+  // Insert, replace or remove the order at a level on the order's side, shifting the levels below
+  void InsertOrder(int level, const Order &order);
+  void ReplaceOrder(int level, const Order &order);
+  void RemoveOrder(PricingSide side, int level);
+
+  // Remove every level on both sides, keeping the storage for the next levels
+  void Clear();
+
+private:
+  const T *product;
+  vector<Order> bidStack;
+  vector<Order> offerStack;
+
+};
+
+/**
+ * Fixed-depth order book with N price levels on each side.
+ * Prices and quantities are held in separate arrays per side and the product
+ * is referenced rather than copied, so the whole book lives in a few cache lines
+ * and construction never touches the heap.
+ * Type T is the product type.
+ */
+template<typename T, int N>
+class FlatOrderBook
+{
+
+public:
+
+  // ctor for an empty book; all levels have zero price and quantity
+  FlatOrderBook();
+  FlatOrderBook(const T &_product);
+
+  // Get the product
+  const T& GetProduct() const;
+
+  // Get the number of levels on each side
+  static int GetDepth() { return N; }
+
+  // Get the price and quantity at a level, level 0 being the top of book
+  FixedPrice GetBidPrice(int level) const;
+  long GetBidQuantity(int level) const;
+  FixedPrice GetOfferPrice(int level) const;
+  long GetOfferQuantity(int level) const;
+
+  // Set the price and quantity at a level
+  void SetBid(int level, FixedPrice price, long quantity);
+  void SetOffer(int level, FixedPrice price, long quantity);
+
+  // Get the top of book
+  BidOffer GetBestBidOffer() const;
+
+  // Merge adjacent levels quoted at the same price; freed levels at the bottom are zeroed
+  FlatOrderBook Aggregate() const;
+
+  // Copy into a vector-backed OrderBook for consumers of the snapshot type
+  OrderBook<T> ToOrderBook() const;
+
+private:
+  const T *product;
+  FixedPrice bidPrices[N];
+  long bidQuantities[N];
+  FixedPrice offerPrices[N];
+  long offerQuantities[N];
+
+};
+
+/**
+ * Market Data Service which distributes market data
+ * Keyed on product identifier.
+ * Type T is the product type.
+ * Type B is the order book type, OrderBook<T> unless a flat book is used.
+ */
+template<typename T, typename B = OrderBook<T> >
+class MarketDataService : public Service<string, B>
+{
+
+public:
+
+  // Get the best bid/offer order
+  virtual const BidOffer& GetBestBidOffer(const string &productId) = 0;
+
+  // Aggregate the order book
+  virtual const B& AggregateDepth(const string &productId) = 0;
+
+};
+
+Order::Order(FixedPrice _price, long _quantity, PricingSide _side)
+{
+  price = _price;
+  quantity = _quantity;
+  side = _side;
+}
+
+FixedPrice Order::GetPrice() const
+{
+  return price;
+}
+ 
+long Order::GetQuantity() const
+{
+  return quantity;
+}
+ 
+PricingSide Order::GetSide() const
+{
+  return side;
+}
+
+BidOffer::BidOffer(const Order &_bidOrder, const Order &_offerOrder) :
+  bidOrder(_bidOrder), offerOrder(_offerOrder)
+{
+}
+
+const Order& BidOffer::GetBidOrder() const
+{
+  return bidOrder;
+}
+
+const Order& BidOffer::GetOfferOrder() const
+{
+  return offerOrder;
+}
+
+OrderBookDelta::OrderBookDelta(string _productId, PricingSide _side, int _level, LevelAction _action, FixedPrice _price, long _quantity) :
+  productId(_productId)
+{
+  side = _side;
+  level = _level;
+  action = _action;
+  price = _price;
+  quantity = _quantity;
+}
+
+const string& OrderBookDelta::GetProductId() const
+{
+  return productId;
+}
+
+PricingSide OrderBookDelta::GetSide() const
+{
+  return side;
+}
+
+int OrderBookDelta::GetLevel() const
+{
+  return level;
+}
+
+LevelAction OrderBookDelta::GetAction() const
+{
+  return action;
+}
+
+Order OrderBookDelta::GetOrder() const
+{
+  return Order(price, quantity, side);
+}
+
+template<typename T>
+OrderBook<T>::OrderBook(const T &_product, const vector<Order> &_bidStack, const vector<Order> &_offerStack) :
+  OrderBook(&ProductRegistry<T>::instance()->Intern(_product), _bidStack, _offerStack)
+{
+}
+
+template<typename T>
+OrderBook<T>::OrderBook(const T *_product, const vector<Order> &_bidStack, const vector<Order> &_offerStack) :
+  product(_product), bidStack(_bidStack), offerStack(_offerStack)
+{
+}
+
+template<typename T>
+const T& OrderBook<T>::GetProduct() const
+{
+  return *product;
+}
+
+template<typename T>
+const vector<Order>& OrderBook<T>::GetBidStack() const
+{
+  return bidStack;
+}
+
+template<typename T>
+const vector<Order>& OrderBook<T>::GetOfferStack() const
+{
+  return offerStack;
+}
+
+template<typename T>
+const Order& OrderBook<T>::GetOrder(PricingSide side, int level) const
+{
+  return (side == BID ? bidStack : offerStack).at(level);
+}
+
+template<typename T>
+void OrderBook<T>::InsertOrder(int level, const Order &order)
+{
+  vector<Order> &stack = (order.GetSide() == BID ? bidStack : offerStack);
+  if (level < 0 || level > static_cast<int>(stack.size())) throw out_of_range("order book level out of range");
+  stack.insert(stack.begin() + level, order);
+}
+
+template<typename T>
+void OrderBook<T>::ReplaceOrder(int level, const Order &order)
+{
+  (order.GetSide() == BID ? bidStack : offerStack).at(level) = order;
+}
+
+template<typename T>
+void OrderBook<T>::RemoveOrder(PricingSide side, int level)
+{
+  vector<Order> &stack = (side == BID ? bidStack : offerStack);
+  if (level < 0 || level >= static_cast<int>(stack.size())) throw out_of_range("order book level out of range");
+  stack.erase(stack.begin() + level);
+}
+
+template<typename T>
+void OrderBook<T>::Clear()
+{
+  bidStack.clear();
+  offerStack.clear();
+}
+
+template<typename T, int N>
+FlatOrderBook<T, N>::FlatOrderBook() :
+  product(&ProductRegistry<T>::instance()->GetDefault()), bidPrices(), bidQuantities(), offerPrices(), offerQuantities()
+{
+}
+
+template<typename T, int N>
+FlatOrderBook<T, N>::FlatOrderBook(const T &_product) :
+  product(&ProductRegistry<T>::instance()->Intern(_product)), bidPrices(), bidQuantities(), offerPrices(), offerQuantities()
+{
+}
+
+template<typename T, int N>
+const T& FlatOrderBook<T, N>::GetProduct() const
+{
+  return *product;
+}
+
+template<typename T, int N>
+FixedPrice FlatOrderBook<T, N>::GetBidPrice(int level) const
+{
+  return bidPrices[level];
+}
+
+template<typename T, int N>
+long FlatOrderBook<T, N>::GetBidQuantity(int level) const
+{
+  return bidQuantities[level];
+}
+
+template<typename T, int N>
+FixedPrice FlatOrderBook<T, N>::GetOfferPrice(int level) const
+{
+  return offerPrices[level];
+}
+
+template<typename T, int N>
+long FlatOrderBook<T, N>::GetOfferQuantity(int level) const
+{
+  return offerQuantities[level];
+}
+
+template<typename T, int N>
+void FlatOrderBook<T, N>::SetBid(int level, FixedPrice price, long quantity)
+{
+  bidPrices[level] = price;
+  bidQuantities[level] = quantity;
+}
+
+template<typename T, int N>
+void FlatOrderBook<T, N>::SetOffer(int level, FixedPrice price, long quantity)
+{
+  offerPrices[level] = price;
+  offerQuantities[level] = quantity;
+}
+
+template<typename T, int N>
+BidOffer FlatOrderBook<T, N>::GetBestBidOffer() const
+{
+  return BidOffer(Order(bidPrices[0], bidQuantities[0], BID), Order(offerPrices[0], offerQuantities[0], OFFER));
+}
+
+template<typename T, int N>
+FlatOrderBook<T, N> FlatOrderBook<T, N>::Aggregate() const
+{
+  FlatOrderBook<T, N> result(*product);
+  int bids = 0, offers = 0;
+  for (int i = 0; i < N; ++i) {
+    if (bids > 0 && result.bidPrices[bids - 1] == bidPrices[i]) result.bidQuantities[bids - 1] += bidQuantities[i];
+    else result.SetBid(bids++, bidPrices[i], bidQuantities[i]);
+    if (offers > 0 && result.offerPrices[offers - 1] == offerPrices[i]) result.offerQuantities[offers - 1] += offerQuantities[i];
+    else result.SetOffer(offers++, offerPrices[i], offerQuantities[i]);
+  }
+  return result;
+}
+
+template<typename T, int N>
+OrderBook<T> FlatOrderBook<T, N>::ToOrderBook() const
+{
+  vector<Order> bidStack, offerStack;
+  bidStack.reserve(N);
+  offerStack.reserve(N);
+  for (int i = 0; i < N; ++i) {
+    bidStack.push_back(Order(bidPrices[i], bidQuantities[i], BID));
+    offerStack.push_back(Order(offerPrices[i], offerQuantities[i], OFFER));
+  }
+  return OrderBook<T>(product, bidStack, offerStack);
+}
+
+
+
+class BondMarketDataService : MarketDataService<Bond> {
+
+public:
+
+	static BondMarketDataService* instance() {
+
+		static BondMarketDataService inst;
+
+		return &inst;
+
+	}
+
+
+
+	// Store the book and fold it into the cached depth and best bid/offer before notifying listeners
+	virtual void OnMessage(OrderBook <Bond> &data) {
+
+		string cusip = data.GetProduct().GetProductId();
+
+		OrderBook<Bond>& aggregate = Aggregate(data.GetProduct());
+
+		auto it = marketData.find(cusip);
+
+		if (it == marketData.end()) {
+
+			marketData.insert(std::make_pair(cusip, data));
+
+		}
+
+		else {
+
+			ApplyLevels(aggregate, it->second, -1);
+
+			it->second = data;
+
+		}
+
+		ApplyLevels(aggregate, data, 1);
+
+		UpdateBestBidOffer(cusip, aggregate);
+
+		for (auto listener : listeners) {
+
+			listener->ProcessAdd(data);
+
+		}
+
+	}
+
+	// Apply a level change to the stored book in place and notify listeners of just that level.
+	// A snapshot must have been received for the product first; deleted levels are sent with zero quantity.
+	void OnDelta(const OrderBookDelta &delta) {
+
+		const string& cusip = delta.GetProductId();
+
+		OrderBook<Bond>& book = marketData.at(cusip);
+
+		OrderBook<Bond>& aggregate = aggregatedData.at(cusip);
+
+		PricingSide side = delta.GetSide();
+
+		Order changed = delta.GetOrder();
+
+		switch (delta.GetAction()) {
+
+		case ADD_LEVEL:
+
+			book.InsertOrder(delta.GetLevel(), changed);
+
+			break;
+
+		case MODIFY_LEVEL:
+
+			AdjustDepth(aggregate, book.GetOrder(side, delta.GetLevel()), -1);
+
+			book.ReplaceOrder(delta.GetLevel(), changed);
+
+			break;
+
+		case DELETE_LEVEL:
+
+			changed = book.GetOrder(side, delta.GetLevel());
+
+			AdjustDepth(aggregate, changed, -1);
+
+			book.RemoveOrder(side, delta.GetLevel());
+
+			changed = Order(changed.GetPrice(), 0, side);
+
+			break;
+
+		}
+
+		AdjustDepth(aggregate, changed, 1);
+
+		UpdateBestBidOffer(cusip, aggregate);
+
+		// the one-level update is built in a book kept per product, so a delta does not allocate once the product has seen one
+
+		auto levelUpdate = levelUpdates.find(cusip);
+
+		if (levelUpdate == levelUpdates.end()) levelUpdate = levelUpdates.insert(std::make_pair(cusip, OrderBook<Bond>(&book.GetProduct(), vector<Order>(), vector<Order>()))).first;
+
+		OrderBook<Bond>& update = levelUpdate->second;
+
+		update.Clear();
+
+		update.InsertOrder(0, changed);
+
+		for (auto listener : listeners) {
+
+			listener->ProcessUpdate(update);
+
+		}
+
+	}
+
+	// Constant time: the best bid/offer is cached on every update
+	const BidOffer& GetBestBidOffer(const string &productId) {
+
+		return bestBidOffer.at(productId);
+
+	}
+
+	// Constant time: levels at the same price are merged on every update
+	const OrderBook<Bond>& AggregateDepth(const string &productId) {
+
+		return aggregatedData.at(productId);
+
+	}
+
+
+	OrderBook<Bond>& GetData(std::string _cusip) {
+
+		return marketData.at(_cusip);
+
+	}
+
+
+
+	void AddListener(ServiceListener<OrderBook<Bond>> *listener) {
+
+		listeners.push_back(listener);
+
+	}
+
+	const vector< ServiceListener<OrderBook<Bond>>* >& GetListeners() const {
+
+		return listeners;
+
+	}
+
+private:
+
+	// Get the aggregated book of a product, a book's own and so interned, adding an empty one the first time it is seen
+	OrderBook<Bond>& Aggregate(const Bond &bond) {
+
+		auto agg = aggregatedData.find(bond.GetProductId());
+
+		if (agg != aggregatedData.end()) return agg->second;
+
+		return aggregatedData.insert(std::make_pair(bond.GetProductId(), OrderBook<Bond>(&bond, vector<Order>(), vector<Order>()))).first->second;
+
+	}
+
+	// Add (sign = 1) or remove (sign = -1) the levels of a book from its aggregated book
+	void ApplyLevels(OrderBook<Bond> &aggregate, const OrderBook<Bond> &book, long sign) {
+
+		for (auto& order : book.GetBidStack()) AdjustDepth(aggregate, order, sign);
+
+		for (auto& order : book.GetOfferStack()) AdjustDepth(aggregate, order, sign);
+
+	}
+
+	// Add (sign = 1) or remove (sign = -1) one order at its price level of the aggregated book, in place;
+	// bids are kept highest first and offers lowest first, and a level left with no quantity is removed
+	void AdjustDepth(OrderBook<Bond> &aggregate, const Order &order, long sign) {
+
+		PricingSide side = order.GetSide();
+
+		FixedPrice price = order.GetPrice();
+
+		const vector<Order>& stack = (side == BID ? aggregate.GetBidStack() : aggregate.GetOfferStack());
+
+		auto level = std::lower_bound(stack.begin(), stack.end(), price, [side](const Order &o, FixedPrice p) { return (side == BID ? o.GetPrice() > p : o.GetPrice() < p); });
+
+		int index = static_cast<int>(level - stack.begin());
+
+		long change = sign * order.GetQuantity();
+
+		if (level == stack.end() || level->GetPrice() != price) {
+
+			if (change != 0) aggregate.InsertOrder(index, Order(price, change, side));
+
+			return;
+
+		}
+
+		long quantity = level->GetQuantity() + change;
+
+		if (quantity == 0) aggregate.RemoveOrder(side, index);
+
+		else aggregate.ReplaceOrder(index, Order(price, quantity, side));
+
+	}
+
+	// Refresh the cached best bid/offer of a product from the top of its aggregated book
+	void UpdateBestBidOffer(const string &cusip, const OrderBook<Bond> &aggregate) {
+
+		const vector<Order>& bids = aggregate.GetBidStack();
+
+		const vector<Order>& offers = aggregate.GetOfferStack();
+
+		BidOffer best(bids.empty() ? Order(FixedPrice(), 0, BID) : bids.front(), offers.empty() ? Order(FixedPrice(), 0, OFFER) : offers.front());
+
+		auto bbo = bestBidOffer.find(cusip);
+
+		if (bbo == bestBidOffer.end()) bestBidOffer.insert(std::make_pair(cusip, best));
+
+		else bbo->second = best;
+
+	}
+
+	KeyedStore<std::string, OrderBook<Bond>> marketData;
+
+	KeyedStore<std::string, BidOffer> bestBidOffer;
+
+	KeyedStore<std::string, OrderBook<Bond>> aggregatedData;
+
+	KeyedStore<std::string, OrderBook<Bond>> levelUpdates;
+
+	std::vector<ServiceListener<OrderBook<Bond>>*> listeners;
+
+	BondMarketDataService() {}
+
+};
+
+
+
+typedef FlatOrderBook<Bond, 5> BondFlatOrderBook;
+
+
+
+class BondFlatMarketDataService : public MarketDataService<Bond, BondFlatOrderBook> {
+
+public:
+
+	static BondFlatMarketDataService* instance() {
+
+		static BondFlatMarketDataService inst;
+
+		return &inst;
+
+	}
+
+
+
+	void OnMessage(BondFlatOrderBook &data) {
+
+		const string& cusip = data.GetProduct().GetProductId();
+
+		marketData[cusip] = data;
+
+		aggregatedData[cusip] = data.Aggregate();
+
+		auto bbo = bestBidOffer.find(cusip);
+
+		if (bbo == bestBidOffer.end()) bestBidOffer.insert(std::make_pair(cusip, data.GetBestBidOffer()));
+
+		else bbo->second = data.GetBestBidOffer();
+
+		for (auto listener : listeners) listener->ProcessAdd(data);
+
+	}
+
+	const BidOffer& GetBestBidOffer(const string &productId) {
+
+		return bestBidOffer.at(productId);
+
+	}
+
+	const BondFlatOrderBook& AggregateDepth(const string &productId) {
+
+		return aggregatedData.at(productId);
+
+	}
+
+
+	BondFlatOrderBook& GetData(std::string _cusip) {
+
+		return marketData.at(_cusip);
+
+	}
+
+
+
+	void AddListener(ServiceListener<BondFlatOrderBook> *listener) {
+
+		listeners.push_back(listener);
+
+	}
+
+	const vector< ServiceListener<BondFlatOrderBook>* >& GetListeners() const {
+
+		return listeners;
+
+	}
+
+private:
+
+	KeyedStore<std::string, BondFlatOrderBook> marketData;
+
+	KeyedStore<std::string, BondFlatOrderBook> aggregatedData;
+
+	KeyedStore<std::string, BidOffer> bestBidOffer;
+
+	std::vector<ServiceListener<BondFlatOrderBook>*> listeners;
+
+	BondFlatMarketDataService() {}
+
+};
+
+
+
+class BondMarketDataConnector : public Connector<OrderBook <Bond>> {
+
+public:
+
+	static BondMarketDataConnector* instance() {
+
+		static BondMarketDataConnector inst;
+
+		return &inst;
+
+	}
+
+	void Publish(OrderBook<Bond> &data) {}
+
+	void Subscribe(IngestionMode mode = MAPPED) {
+
+		if (mode == MAPPED) {
+
+			SubscribeMapped();
+
+			return;
+
+		}
+
+		auto SplitLine = [](std::string& line) {
+
+			stringstream enter_line(line);
+
+			std::string item;
+
+			std::vector<std::string> tmp;
+
+			while (getline(enter_line, item, ',')) 	tmp.push_back(item);
+
+			return tmp;
+
+		};
+
+
+		ifstream file("marketdata.txt");
+
+		string line, cusip;
+
+		getline(file, line);
+
+		for (int i = 0; i < 12; ++i) {
+
+			getline(file, line);
+
+			std::vector<std::string> elems = SplitLine(line);
+
+			cusip = elems[0];
+
+			PricingSide side;
+
+			vector<Order> bid_stack, offer_stack;
+
+			FixedPrice price;	long quantity;
+
+			int idx = 1;
+
+			for (int k = 1; k <= 5; ++k) {
+
+				price = String2FixedPrice(elems[idx++]);
+
+				quantity = std::stol(elems[idx++]);
+
+				side = BID;
+
+				Order bid_order(price, quantity, side);
+
+				bid_stack.push_back(bid_order);
+
+			}
+
+			for (int k = 1; k <= 5; ++k) {
+
+				price = String2FixedPrice(elems[idx++]);
+
+				quantity = std::stol(elems[idx++]);
+
+				side = OFFER;
+
+				Order offer_order(price, quantity, side);
+
+				offer_stack.push_back(offer_order);
+
+			}
+
+
+
+			const Bond& bond = bondBook->GetData(cusip);
+
+			OrderBook<Bond> order_book(&bond, bid_stack, offer_stack);
+
+			if (recorder) recorder->ProcessAdd(order_book);
+
+			bondMarketDataService->OnMessage(order_book);
+
+		}
+
+		std::cout << "The marketdata service finished subscribing.\n" << std::endl;
+
+	}
+
+
+
+	// Read incremental level updates, one per row: CUSIP,side,level,action,price,quantity
+	// with side BID or OFFER and action ADD, MODIFY or DELETE. Snapshots must be subscribed first.
+	void SubscribeDeltas(const string &path = "marketdatadeltas.txt") {
+
+		MappedCsvReader reader(path);
+
+		reader.ForEachRow([&](const CsvField* elems, size_t count) {
+
+			if (count < 6) throw invalid_argument("malformed market data delta for " + elems[0].ToString());
+
+			PricingSide side = elems[1].Equals("BID") ? BID : OFFER;
+
+			LevelAction action = elems[3].Equals("ADD") ? ADD_LEVEL : (elems[3].Equals("DELETE") ? DELETE_LEVEL : MODIFY_LEVEL);
+
+			FixedPrice price = (action == DELETE_LEVEL ? FixedPrice() : String2FixedPrice(elems[4].first, elems[4].last));
+
+			long quantity = (action == DELETE_LEVEL ? 0 : elems[5].ToLong());
+
+			OrderBookDelta delta(elems[0].ToString(), side, static_cast<int>(elems[2].ToLong()), action, price, quantity);
+
+			if (deltaRecorder) deltaRecorder->ProcessAdd(delta);
+
+			bondMarketDataService->OnDelta(delta);
+
+			return true;
+
+		});
+
+		std::cout << "The marketdata service finished subscribing to deltas.\n" << std::endl;
+
+	}
+
+	// Read marketdata.txt straight into flat books for the flat market data service
+	void SubscribeFlat() {
+
+		auto bondFlatMarketDataService = BondFlatMarketDataService::instance();
+
+		MappedCsvReader reader("marketdata.txt");
+
+		int books = 0;
+
+		reader.ForEachRow([&](const CsvField* elems, size_t count) {
+
+			if (count < 21) throw invalid_argument("malformed market data row for " + elems[0].ToString());
+
+			BondFlatOrderBook order_book(bondBook->GetData(elems[0].ToString()));
+
+			int idx = 1;
+
+			for (int k = 0; k < 5; ++k, idx += 2) order_book.SetBid(k, String2FixedPrice(elems[idx].first, elems[idx].last), elems[idx + 1].ToLong());
+
+			for (int k = 0; k < 5; ++k, idx += 2) order_book.SetOffer(k, String2FixedPrice(elems[idx].first, elems[idx].last), elems[idx + 1].ToLong());
+
+			bondFlatMarketDataService->OnMessage(order_book);
+
+			return ++books < 12;
+
+		});
+
+	}
+
+
+
+	// Pass every book and delta read to a recorder before the service sees it, e.g. a JournalServiceListener
+	void SetRecorder(ServiceListener<OrderBook<Bond>>* _recorder) {
+
+		recorder = _recorder;
+
+	}
+
+	void SetRecorder(ServiceListener<OrderBookDelta>* _recorder) {
+
+		deltaRecorder = _recorder;
+
+	}
+
+
+
+	BondMarketDataService* GetService() {
+
+		return bondMarketDataService;
+
+	}
+
+
+
+private:
+
+	// Tokenize marketdata.txt in place from a memory mapping instead of getline + SplitLine
+	void SubscribeMapped() {
+
+		MappedCsvReader reader("marketdata.txt");
+
+		vector<Order> bid_stack, offer_stack;
+
+		int books = 0;
+
+		reader.ForEachRow([&](const CsvField* elems, size_t count) {
+
+			if (count < 21) throw invalid_argument("malformed market data row for " + elems[0].ToString());
+
+			bid_stack.clear();
+
+			offer_stack.clear();
+
+			int idx = 1;
+
+			for (int k = 1; k <= 5; ++k, idx += 2) bid_stack.push_back(Order(String2FixedPrice(elems[idx].first, elems[idx].last), elems[idx + 1].ToLong(), BID));
+
+			for (int k = 1; k <= 5; ++k, idx += 2) offer_stack.push_back(Order(String2FixedPrice(elems[idx].first, elems[idx].last), elems[idx + 1].ToLong(), OFFER));
+
+			const Bond& bond = bondBook->GetData(elems[0].ToString());
+
+			OrderBook<Bond> order_book(&bond, bid_stack, offer_stack);
+
+			if (recorder) recorder->ProcessAdd(order_book);
+
+			bondMarketDataService->OnMessage(order_book);
+
+			return ++books < 12;
+
+		});
+
+		std::cout << "The marketdata service finished subscribing.\n" << std::endl;
+
+	}
+
+
+	BondMarketDataConnector() {
+
+		bondMarketDataService = BondMarketDataService::instance();
+
+		bondBook = BondBook::instance();
+
+		recorder = nullptr;
+
+		deltaRecorder = nullptr;
+
+	}
+
+	BondMarketDataService * bondMarketDataService;
+
+	BondBook * bondBook;
+
+	ServiceListener<OrderBook<Bond>>* recorder;
+
+	ServiceListener<OrderBookDelta>* deltaRecorder;
+
+};
+
+#endif
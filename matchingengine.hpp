@@ -0,0 +1,396 @@
+/**
+ * matchingengine.hpp
+ * Simulated venue matching for execution orders.
+ * Each venue holds, per product, the liquidity of the latest order book it was
+ * given; orders take from it level by level until the next book replaces it.
+ * Limit orders left over rest on the venue and stop orders wait for their trigger,
+ * and both are matched against each new book. The queues holding them take their
+ * nodes from the engine's MessagePool, so orders coming and going do not allocate,
+ * and an OrderIdTable finds the queue entry of any order given an id, so cancelling
+ * one takes constant time.
+ */
+#ifndef MATCHING_ENGINE_HPP
+#define MATCHING_ENGINE_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "keyedstore.hpp"
+#include "messagepool.hpp"
+#include "orderidtable.hpp"
+#include "marketdataservice.hpp"
+
+using namespace std;
+
+enum OrderType { FOK, IOC, MARKET, LIMIT, STOP };
+
+enum Market { BROKERTEC, ESPEED, CME };
+
+template<typename T>
+class ExecutionOrder;
+
+/**
+ * One fill on a venue: a BID order buys and an OFFER order sells.
+ * A passive fill belongs to a resting limit or triggered stop order, filled by a new book.
+ * The last fill of a triggered stop is marked done: the venue drops whatever the stop had left.
+ */
+struct VenueFill
+{
+  string orderId;
+  PricingSide side;
+  FixedPrice price;
+  long quantity;
+  bool passive;
+  bool done;
+};
+
+/**
+ * Matching engine for one Market.
+ * Order types:
+ *   MARKET takes whatever the book offers and cancels the rest;
+ *   IOC takes what is at or better than its price and cancels the rest;
+ *   FOK fills completely at or better than its price, or not at all;
+ *   LIMIT takes what it can and rests the remainder at its price;
+ *   STOP becomes a market order once the book reaches its price: a buy stop when
+ *   the best offer is at or above it, a sell stop when the best bid is at or below it;
+ *   like MARKET, it cancels whatever the book cannot fill.
+ * An aggressive order takes its visible and hidden quantity alike. A resting order
+ * shows only its visible quantity; when that is filled it is topped up from the hidden
+ * quantity and goes to the back of the queue, as an iceberg would.
+ * The id index points into the queues, so an engine is only copied before orders rest on it.
+ * Type T is the product type.
+ */
+template<typename T>
+class MatchingEngine
+{
+
+public:
+
+  // ctor for a venue
+  MatchingEngine(Market _market);
+
+  // Get the venue
+  Market GetMarket() const;
+
+  // Replace a product's liquidity with a book, then fill any resting and stop orders it reaches into fills
+  void OnBook(const OrderBook<T> &book, vector<VenueFill> &fills);
+
+  // Match an order against its product's liquidity, appending its fills; returns the quantity filled.
+  // A limit or stop order left on the venue with a nonzero id can be cancelled by it
+  long Match(const ExecutionOrder<T> &order, vector<VenueFill> &fills, uint64_t id = 0);
+
+  // Take a resting limit or stop order off its venue; returns the quantity it still had, or 0 if it is not there
+  long Cancel(uint64_t id);
+
+  // Get the quantity resting in limit orders and the number of stops waiting for a product
+  long GetRestingQuantity(const T &product) const;
+  size_t GetPendingStops(const T &product) const;
+
+private:
+
+  struct Level
+  {
+    FixedPrice price;
+    long quantity;
+  };
+
+  struct RestingOrder
+  {
+    uint64_t id;
+    string orderId;
+    PricingSide side;
+    FixedPrice price;
+    long visible;
+    long hidden;
+    long display;
+  };
+
+  // Orders waiting on a venue, keyed so that the first is the next to match; equal keys keep arrival order
+  typedef multimap<FixedPrice, RestingOrder, less<FixedPrice>, PoolAllocator<pair<const FixedPrice, RestingOrder> > > Queue;
+
+  // Entry of a resting order or stop in its queue
+  struct Location
+  {
+    Queue *queue;
+    typename Queue::iterator entry;
+  };
+
+  // Liquidity of one product; levels above top have been taken
+  struct Venue
+  {
+    vector<Level> bids;
+    vector<Level> offers;
+    size_t bidTop;
+    size_t offerTop;
+    Queue restingBids;
+    Queue restingOffers;
+    Queue buyStops;
+    Queue sellStops;
+
+    Venue() : bidTop(0), offerTop(0) {}
+    Venue(const shared_ptr<MessagePool> &pool) :
+      bidTop(0), offerTop(0), restingBids(less<FixedPrice>(), pool), restingOffers(less<FixedPrice>(), pool),
+      buyStops(less<FixedPrice>(), pool), sellStops(less<FixedPrice>(), pool) {}
+  };
+
+  Venue& GetVenue(const T &product);
+
+  // Quantity an order on side could take at or better than limit (any price unless limited)
+  static long Available(const Venue &venue, PricingSide side, FixedPrice limit, bool limited);
+
+  // Take up to quantity for an order on side, appending fills; returns the quantity taken
+  static long Take(Venue &venue, const string &orderId, PricingSide side, FixedPrice limit, bool limited, long quantity, bool passive, vector<VenueFill> &fills);
+
+  // Whether the book has reached a stop order's price
+  static bool Triggered(const Venue &venue, PricingSide side, FixedPrice price);
+
+  // Key of a resting order or stop in its queue: best bids and the highest sell stops sort first
+  static FixedPrice RestingKey(PricingSide side, FixedPrice price);
+  static FixedPrice StopKey(PricingSide side, FixedPrice price);
+
+  // Add an order to a queue, indexing it if it has an id
+  void Rest(Queue &queue, FixedPrice key, const RestingOrder &order);
+
+  // Remove the front of a queue and its index entry
+  void PopFront(Queue &queue);
+
+  // Fill resting orders from the front of a queue until the book no longer reaches them
+  void MatchResting(Venue &venue, Queue &queue, vector<VenueFill> &fills);
+
+  // Fire stops from the front of a queue until the book no longer reaches them
+  void FireStops(Venue &venue, Queue &queue, vector<VenueFill> &fills);
+
+  Market market;
+  shared_ptr<MessagePool> pool;
+  KeyedStore<const T*, Venue> venues;
+  OrderIdTable<Location> index;
+
+};
+
+template<typename T>
+MatchingEngine<T>::MatchingEngine(Market _market) :
+  market(_market), pool(make_shared<MessagePool>())
+{
+}
+
+template<typename T>
+Market MatchingEngine<T>::GetMarket() const
+{
+  return market;
+}
+
+template<typename T>
+typename MatchingEngine<T>::Venue& MatchingEngine<T>::GetVenue(const T &product)
+{
+  // books and orders hold the registered product, so its address is the key
+  size_t i = venues.IndexOf(&product);
+  if (i != KeyedStore<const T*, Venue>::NOT_FOUND) return venues.AtIndex(i);
+  Venue &venue = venues.AtIndex(venues.Assign(&product));
+  venue = Venue(pool);
+  return venue;
+}
+
+template<typename T>
+void MatchingEngine<T>::OnBook(const OrderBook<T> &book, vector<VenueFill> &fills)
+{
+  Venue &venue = GetVenue(book.GetProduct());
+
+  venue.bids.clear();
+  for (auto &order : book.GetBidStack()) {
+    if (order.GetQuantity() > 0) venue.bids.push_back(Level{ order.GetPrice(), order.GetQuantity() });
+  }
+  venue.offers.clear();
+  for (auto &order : book.GetOfferStack()) {
+    if (order.GetQuantity() > 0) venue.offers.push_back(Level{ order.GetPrice(), order.GetQuantity() });
+  }
+  sort(venue.bids.begin(), venue.bids.end(), [](const Level &a, const Level &b) { return a.price > b.price; });
+  sort(venue.offers.begin(), venue.offers.end(), [](const Level &a, const Level &b) { return a.price < b.price; });
+  venue.bidTop = 0;
+  venue.offerTop = 0;
+
+  MatchResting(venue, venue.restingBids, fills);
+  MatchResting(venue, venue.restingOffers, fills);
+  FireStops(venue, venue.buyStops, fills);
+  FireStops(venue, venue.sellStops, fills);
+}
+
+template<typename T>
+void MatchingEngine<T>::Rest(Queue &queue, FixedPrice key, const RestingOrder &order)
+{
+  auto entry = queue.insert(make_pair(key, order));
+  if (!order.id) return;
+  Location *location = index.Find(order.id);
+  if (location) location->entry = entry;
+  else index.Insert(order.id, Location{ &queue, entry });
+}
+
+template<typename T>
+void MatchingEngine<T>::PopFront(Queue &queue)
+{
+  auto first = queue.begin();
+  Location *location = (first->second.id ? index.Find(first->second.id) : nullptr);
+  // a refilled iceberg is indexed at its new entry already
+  if (location && location->entry == first) index.Erase(first->second.id);
+  queue.erase(first);
+}
+
+template<typename T>
+void MatchingEngine<T>::MatchResting(Venue &venue, Queue &queue, vector<VenueFill> &fills)
+{
+  while (!queue.empty()) {
+    auto first = queue.begin();
+    RestingOrder &order = first->second;
+    order.visible -= Take(venue, order.orderId, order.side, order.price, true, order.visible, true, fills);
+    if (order.visible > 0) return;
+    // an iceberg whose visible quantity is used up re-queues behind the others at its price
+    if (order.hidden > 0) {
+      RestingOrder refilled = order;
+      refilled.visible = min(refilled.display, refilled.hidden);
+      refilled.hidden -= refilled.visible;
+      Rest(queue, first->first, refilled);
+    }
+    PopFront(queue);
+  }
+}
+
+template<typename T>
+void MatchingEngine<T>::FireStops(Venue &venue, Queue &queue, vector<VenueFill> &fills)
+{
+  while (!queue.empty() && Triggered(venue, queue.begin()->second.side, queue.begin()->second.price)) {
+    RestingOrder &stop = queue.begin()->second;
+    Take(venue, stop.orderId, stop.side, FixedPrice(), false, stop.visible + stop.hidden, true, fills);
+    // a triggered book has a level to take from, so the stop filled at least once
+    fills.back().done = true;
+    PopFront(queue);
+  }
+}
+
+template<typename T>
+long MatchingEngine<T>::Match(const ExecutionOrder<T> &order, vector<VenueFill> &fills, uint64_t id)
+{
+  Venue &venue = GetVenue(order.GetProduct());
+  PricingSide side = order.GetSide();
+  long quantity = order.GetVisibleQuantity() + order.GetHiddenQuantity();
+  long filled = 0;
+
+  switch (order.GetOrderType()) {
+
+  case MARKET:
+    return Take(venue, order.GetOrderId(), side, FixedPrice(), false, quantity, false, fills);
+
+  case IOC:
+    return Take(venue, order.GetOrderId(), side, order.GetPrice(), true, quantity, false, fills);
+
+  case FOK:
+    if (Available(venue, side, order.GetPrice(), true) < quantity) return 0;
+    return Take(venue, order.GetOrderId(), side, order.GetPrice(), true, quantity, false, fills);
+
+  case LIMIT:
+    filled = Take(venue, order.GetOrderId(), side, order.GetPrice(), true, quantity, false, fills);
+    if (filled < quantity) {
+      // the remainder shows its visible quantity first, or all of it if none was visible
+      long display = (order.GetVisibleQuantity() > 0 ? order.GetVisibleQuantity() : quantity);
+      long visible = min(display, quantity - filled);
+      RestingOrder resting{ id, order.GetOrderId(), side, order.GetPrice(), visible, quantity - filled - visible, display };
+      Rest(side == BID ? venue.restingBids : venue.restingOffers, RestingKey(side, order.GetPrice()), resting);
+    }
+    return filled;
+
+  case STOP:
+    if (Triggered(venue, side, order.GetPrice())) {
+      filled = Take(venue, order.GetOrderId(), side, FixedPrice(), false, quantity, false, fills);
+      fills.back().done = true;
+      return filled;
+    }
+    {
+      RestingOrder stop{ id, order.GetOrderId(), side, order.GetPrice(), order.GetVisibleQuantity(), order.GetHiddenQuantity(), order.GetVisibleQuantity() };
+      Rest(side == BID ? venue.buyStops : venue.sellStops, StopKey(side, order.GetPrice()), stop);
+    }
+    return 0;
+
+  }
+  return 0;
+}
+
+template<typename T>
+long MatchingEngine<T>::Available(const Venue &venue, PricingSide side, FixedPrice limit, bool limited)
+{
+  const vector<Level> &levels = (side == BID ? venue.offers : venue.bids);
+  long available = 0;
+  for (size_t i = (side == BID ? venue.offerTop : venue.bidTop); i < levels.size(); ++i) {
+    if (limited && (side == BID ? levels[i].price > limit : levels[i].price < limit)) break;
+    available += levels[i].quantity;
+  }
+  return available;
+}
+
+template<typename T>
+long MatchingEngine<T>::Take(Venue &venue, const string &orderId, PricingSide side, FixedPrice limit, bool limited, long quantity, bool passive, vector<VenueFill> &fills)
+{
+  vector<Level> &levels = (side == BID ? venue.offers : venue.bids);
+  size_t &top = (side == BID ? venue.offerTop : venue.bidTop);
+  long taken = 0;
+
+  while (taken < quantity && top < levels.size()) {
+    Level &level = levels[top];
+    if (limited && (side == BID ? level.price > limit : level.price < limit)) break;
+    long quantityFilled = min(quantity - taken, level.quantity);
+    fills.push_back(VenueFill{ orderId, side, level.price, quantityFilled, passive, false });
+    taken += quantityFilled;
+    level.quantity -= quantityFilled;
+    if (level.quantity == 0) ++top;
+  }
+  return taken;
+}
+
+template<typename T>
+bool MatchingEngine<T>::Triggered(const Venue &venue, PricingSide side, FixedPrice price)
+{
+  if (side == BID) return venue.offerTop < venue.offers.size() && venue.offers[venue.offerTop].price >= price;
+  return venue.bidTop < venue.bids.size() && venue.bids[venue.bidTop].price <= price;
+}
+
+template<typename T>
+FixedPrice MatchingEngine<T>::RestingKey(PricingSide side, FixedPrice price)
+{
+  return (side == BID ? -price : price);
+}
+
+template<typename T>
+FixedPrice MatchingEngine<T>::StopKey(PricingSide side, FixedPrice price)
+{
+  // a buy stop fires once the offer rises to it, so the lowest fires first; a sell stop the other way
+  return (side == BID ? price : -price);
+}
+
+template<typename T>
+long MatchingEngine<T>::Cancel(uint64_t id)
+{
+  Location *location = (id ? index.Find(id) : nullptr);
+  if (!location) return 0;
+  long quantity = location->entry->second.visible + location->entry->second.hidden;
+  location->queue->erase(location->entry);
+  index.Erase(id);
+  return quantity;
+}
+
+template<typename T>
+long MatchingEngine<T>::GetRestingQuantity(const T &product) const
+{
+  size_t i = venues.IndexOf(&ProductRegistry<T>::instance()->Intern(product));
+  if (i == KeyedStore<const T*, Venue>::NOT_FOUND) return 0;
+  long quantity = 0;
+  for (auto &entry : venues.AtIndex(i).restingBids) quantity += entry.second.visible + entry.second.hidden;
+  for (auto &entry : venues.AtIndex(i).restingOffers) quantity += entry.second.visible + entry.second.hidden;
+  return quantity;
+}
+
+template<typename T>
+size_t MatchingEngine<T>::GetPendingStops(const T &product) const
+{
+  size_t i = venues.IndexOf(&ProductRegistry<T>::instance()->Intern(product));
+  return (i == KeyedStore<const T*, Venue>::NOT_FOUND ? 0 : venues.AtIndex(i).buyStops.size() + venues.AtIndex(i).sellStops.size());
+}
+
+#endif
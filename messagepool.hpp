@@ -0,0 +1,202 @@
+/**
+ * messagepool.hpp
+ * Recycled storage for messages a service holds from one tick to the next.
+ * Blocks are carved from large chunks into free lists by size class, and a freed
+ * block goes back on its list for the next message of that size, so a container
+ * whose elements come and go stops touching the heap once its pool has warmed up.
+ */
+#ifndef MESSAGE_POOL_HPP
+#define MESSAGE_POOL_HPP
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <new>
+
+using namespace std;
+
+/**
+ * Pool of fixed-size blocks in size classes of 16 bytes, up to 256 bytes.
+ * Larger or over-aligned requests go to the heap. Chunks are kept until the pool
+ * is destroyed. A pool is not thread safe; share one only between containers used on one thread.
+ */
+class MessagePool
+{
+
+public:
+
+  // ctor for a pool adding blocksPerChunk blocks to a size class each time it runs dry
+  MessagePool(size_t _blocksPerChunk = 256);
+
+  // Get storage for bytes
+  void* Allocate(size_t bytes);
+
+  // Return storage from Allocate with the same bytes
+  void Deallocate(void *block, size_t bytes);
+
+  // Get the number of chunks taken from the heap
+  size_t GetChunkCount() const;
+
+  static const size_t GRANULE = 16;
+  static const size_t CLASSES = 16;
+
+private:
+
+  struct FreeBlock
+  {
+    FreeBlock *next;
+  };
+
+  // Carve a new chunk into blocks of a size class
+  void Refill(size_t sizeClass);
+
+  FreeBlock *freeLists[CLASSES];
+  vector<unique_ptr<char[]> > chunks;
+  size_t blocksPerChunk;
+
+  MessagePool(const MessagePool&);
+  MessagePool& operator=(const MessagePool&);
+
+};
+
+/**
+ * Standard allocator drawing from a shared MessagePool, for node containers such as
+ * map and list. A default-constructed allocator has no pool and uses the heap.
+ * The pool travels with the container on copy, move and swap.
+ * Type T is the value type.
+ */
+template<typename T>
+class PoolAllocator
+{
+
+public:
+
+  typedef T value_type;
+  typedef true_type propagate_on_container_copy_assignment;
+  typedef true_type propagate_on_container_move_assignment;
+  typedef true_type propagate_on_container_swap;
+
+  PoolAllocator();
+  PoolAllocator(const shared_ptr<MessagePool> &_pool);
+
+  template<typename U>
+  PoolAllocator(const PoolAllocator<U> &other);
+
+  T* allocate(size_t n);
+  void deallocate(T *p, size_t n);
+
+  // Get the pool, or nullptr for the heap
+  const shared_ptr<MessagePool>& GetPool() const;
+
+private:
+
+  // Whether n elements can come from the pool
+  static bool Pooled(size_t n);
+
+  shared_ptr<MessagePool> pool;
+
+};
+
+template<typename T, typename U>
+bool operator==(const PoolAllocator<T> &a, const PoolAllocator<U> &b)
+{
+  return a.GetPool() == b.GetPool();
+}
+
+template<typename T, typename U>
+bool operator!=(const PoolAllocator<T> &a, const PoolAllocator<U> &b)
+{
+  return !(a == b);
+}
+
+MessagePool::MessagePool(size_t _blocksPerChunk) :
+  blocksPerChunk(_blocksPerChunk < 1 ? 1 : _blocksPerChunk)
+{
+  for (size_t i = 0; i < CLASSES; ++i) freeLists[i] = nullptr;
+}
+
+void* MessagePool::Allocate(size_t bytes)
+{
+  size_t sizeClass = (bytes == 0 ? 0 : (bytes - 1) / GRANULE);
+  if (sizeClass >= CLASSES) return ::operator new(bytes);
+  if (!freeLists[sizeClass]) Refill(sizeClass);
+  FreeBlock *block = freeLists[sizeClass];
+  freeLists[sizeClass] = block->next;
+  return block;
+}
+
+void MessagePool::Deallocate(void *block, size_t bytes)
+{
+  size_t sizeClass = (bytes == 0 ? 0 : (bytes - 1) / GRANULE);
+  if (sizeClass >= CLASSES) {
+    ::operator delete(block);
+    return;
+  }
+  FreeBlock *freed = static_cast<FreeBlock*>(block);
+  freed->next = freeLists[sizeClass];
+  freeLists[sizeClass] = freed;
+}
+
+void MessagePool::Refill(size_t sizeClass)
+{
+  // new[] aligns the chunk for any fundamental type, and blocks are a multiple of GRANULE apart
+  size_t blockSize = (sizeClass + 1) * GRANULE;
+  chunks.push_back(unique_ptr<char[]>(new char[blockSize * blocksPerChunk]));
+  char *chunk = chunks.back().get();
+  for (size_t i = blocksPerChunk; i-- > 0;) {
+    FreeBlock *block = reinterpret_cast<FreeBlock*>(chunk + i * blockSize);
+    block->next = freeLists[sizeClass];
+    freeLists[sizeClass] = block;
+  }
+}
+
+size_t MessagePool::GetChunkCount() const
+{
+  return chunks.size();
+}
+
+template<typename T>
+PoolAllocator<T>::PoolAllocator()
+{
+}
+
+template<typename T>
+PoolAllocator<T>::PoolAllocator(const shared_ptr<MessagePool> &_pool) :
+  pool(_pool)
+{
+}
+
+template<typename T>
+template<typename U>
+PoolAllocator<T>::PoolAllocator(const PoolAllocator<U> &other) :
+  pool(other.GetPool())
+{
+}
+
+template<typename T>
+bool PoolAllocator<T>::Pooled(size_t n)
+{
+  return n == 1 && alignof(T) <= MessagePool::GRANULE && alignof(T) <= alignof(max_align_t);
+}
+
+template<typename T>
+T* PoolAllocator<T>::allocate(size_t n)
+{
+  if (pool && Pooled(n)) return static_cast<T*>(pool->Allocate(sizeof(T)));
+  return static_cast<T*>(::operator new(n * sizeof(T)));
+}
+
+template<typename T>
+void PoolAllocator<T>::deallocate(T *p, size_t n)
+{
+  if (pool && Pooled(n)) pool->Deallocate(p, sizeof(T));
+  else ::operator delete(p);
+}
+
+template<typename T>
+const shared_ptr<MessagePool>& PoolAllocator<T>::GetPool() const
+{
+  return pool;
+}
+
+#endif
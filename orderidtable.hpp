@@ -0,0 +1,171 @@
+/**
+ * orderidtable.hpp
+ * Open-addressed hash table keyed by integer order id.
+ * Slots live in one power-of-two array probed linearly, and erasing shifts the
+ * following entries back instead of leaving tombstones, so lookups stay short
+ * however many orders have come and gone.
+ */
+#ifndef ORDER_ID_TABLE_HPP
+#define ORDER_ID_TABLE_HPP
+
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * Map from order id to V with constant time find, insert and erase.
+ * The table doubles when it is half full; pointers returned by Find last until the next insert.
+ * Type V is the value type and must be default constructible and copyable.
+ */
+template<typename V>
+class OrderIdTable
+{
+
+public:
+
+  // ctor for a table sized for about capacity orders
+  OrderIdTable(size_t capacity = 1024);
+
+  // Get the value of an order, or nullptr
+  V* Find(uint64_t id);
+  const V* Find(uint64_t id) const;
+
+  // Add an order; returns false, leaving the table as it is, if the id is present
+  bool Insert(uint64_t id, const V &value);
+
+  // Remove an order; returns false if the id is absent
+  bool Erase(uint64_t id);
+
+  // Get the number of orders
+  size_t Size() const;
+
+  // Remove every order
+  void Clear();
+
+private:
+
+  struct Slot
+  {
+    uint64_t id;
+    V value;
+    bool used;
+  };
+
+  // Home slot of an id
+  size_t Home(uint64_t id) const;
+
+  // Slot holding an id, or the empty slot where it would go
+  size_t Probe(uint64_t id) const;
+
+  void Grow();
+
+  vector<Slot> slots;
+  size_t mask;
+  size_t size;
+
+};
+
+template<typename V>
+OrderIdTable<V>::OrderIdTable(size_t capacity) :
+  size(0)
+{
+  size_t n = 16;
+  while (n < capacity * 2) n *= 2;
+  slots.assign(n, Slot{ 0, V(), false });
+  mask = n - 1;
+}
+
+template<typename V>
+size_t OrderIdTable<V>::Home(uint64_t id) const
+{
+  // ids are often sequential, so spread them with a multiplicative hash
+  return static_cast<size_t>((id * 0x9E3779B97F4A7C15ULL) >> 20) & mask;
+}
+
+template<typename V>
+size_t OrderIdTable<V>::Probe(uint64_t id) const
+{
+  size_t i = Home(id);
+  while (slots[i].used && slots[i].id != id) i = (i + 1) & mask;
+  return i;
+}
+
+template<typename V>
+V* OrderIdTable<V>::Find(uint64_t id)
+{
+  size_t i = Probe(id);
+  return (slots[i].used ? &slots[i].value : nullptr);
+}
+
+template<typename V>
+const V* OrderIdTable<V>::Find(uint64_t id) const
+{
+  size_t i = Probe(id);
+  return (slots[i].used ? &slots[i].value : nullptr);
+}
+
+template<typename V>
+bool OrderIdTable<V>::Insert(uint64_t id, const V &value)
+{
+  if ((size + 1) * 2 > slots.size()) Grow();
+  size_t i = Probe(id);
+  if (slots[i].used) return false;
+  slots[i].id = id;
+  slots[i].value = value;
+  slots[i].used = true;
+  ++size;
+  return true;
+}
+
+template<typename V>
+bool OrderIdTable<V>::Erase(uint64_t id)
+{
+  size_t i = Probe(id);
+  if (!slots[i].used) return false;
+
+  // move back any later entry of the run whose home is not between the hole and itself
+  size_t j = i;
+  for (;;) {
+    j = (j + 1) & mask;
+    if (!slots[j].used) break;
+    size_t home = Home(slots[j].id);
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      slots[i] = slots[j];
+      i = j;
+    }
+  }
+  slots[i].used = false;
+  slots[i].value = V();
+  --size;
+  return true;
+}
+
+template<typename V>
+size_t OrderIdTable<V>::Size() const
+{
+  return size;
+}
+
+template<typename V>
+void OrderIdTable<V>::Clear()
+{
+  for (auto &slot : slots) slot = Slot{ 0, V(), false };
+  size = 0;
+}
+
+template<typename V>
+void OrderIdTable<V>::Grow()
+{
+  vector<Slot> old;
+  old.swap(slots);
+  slots.assign(old.size() * 2, Slot{ 0, V(), false });
+  mask = slots.size() - 1;
+  for (auto &slot : old) {
+    if (!slot.used) continue;
+    size_t i = Probe(slot.id);
+    slots[i] = slot;
+  }
+}
+
+#endif
@@ -0,0 +1,282 @@
+/**
+ * persistence.hpp
+ * Shared buffered persistence engine for the historical data connectors.
+ * Each file is opened once; records are appended to an in-memory buffer and a
+ * single background thread writes the buffers out when they pass a size
+ * threshold or a time interval elapses, so records reach each file in order.
+ */
+#ifndef PERSISTENCE_HPP
+#define PERSISTENCE_HPP
+
+#include <string>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdarg>
+
+using namespace std;
+
+class PersistenceEngine;
+
+/**
+ * Buffered appender for one file, obtained from the PersistenceEngine.
+ * Append may be called from any thread.
+ */
+class BufferedFileWriter
+{
+
+public:
+
+  // Append raw bytes as part of the current record
+  void Append(const char *data, size_t size);
+  void Append(const string &data);
+
+  // Format a record printf-style and append it; records up to RECORD_SIZE bytes are formatted on the stack,
+  // longer ones in a heap buffer of their exact size
+  void AppendFormat(const char *format, ...);
+
+  // Get the path of the file
+  const string& GetPath() const;
+
+  // Get the number of bytes appended and written so far
+  unsigned long GetBytesAppended() const;
+  unsigned long GetBytesWritten() const;
+
+  static const size_t RECORD_SIZE = 512;
+
+private:
+  friend class PersistenceEngine;
+
+  BufferedFileWriter(const string &_path, PersistenceEngine *_engine, bool binary);
+
+  // Write out whatever is buffered; only called on the engine's thread or under its flush lock
+  void WriteOut();
+
+  string path;
+  PersistenceEngine *engine;
+  ofstream file;
+  mutable mutex lock;
+  string buffer;
+  string spare;
+  unsigned long bytesAppended;
+  unsigned long bytesWritten;
+
+};
+
+/**
+ * Owns the open files and the background flushing thread.
+ */
+class PersistenceEngine
+{
+
+public:
+
+  static PersistenceEngine* instance() {
+
+    static PersistenceEngine inst;
+
+    return &inst;
+
+  }
+
+  // Get the writer for a file, opening it for append on first use; binary files skip newline translation
+  BufferedFileWriter* GetWriter(const string &path, bool binary = false);
+
+  // Write out every buffer now and wait until it has reached the files
+  void Flush();
+
+  // Set the buffer size that triggers a write and the longest time data may sit in a buffer
+  void SetThresholds(size_t _flushBytes, chrono::milliseconds _flushInterval);
+
+  // Get the buffer size that triggers a write
+  size_t GetFlushBytes() const;
+
+  ~PersistenceEngine();
+
+private:
+  friend class BufferedFileWriter;
+
+  PersistenceEngine();
+
+  // Ask the background thread for an early write
+  void RequestFlush();
+
+  void WriteAll();
+  void Run();
+
+  map<string, unique_ptr<BufferedFileWriter> > writers;
+  mutex writersLock;
+  mutex flushLock;
+  mutex wakeLock;
+  condition_variable wake;
+  bool flushRequested;
+  bool running;
+  atomic<size_t> flushBytes;
+  chrono::milliseconds flushInterval;
+  thread worker;
+
+};
+
+BufferedFileWriter::BufferedFileWriter(const string &_path, PersistenceEngine *_engine, bool binary) :
+  path(_path), engine(_engine), file(_path, binary ? ios_base::app | ios_base::binary : ios_base::app), bytesAppended(0), bytesWritten(0)
+{
+  if (!file) throw runtime_error("cannot open " + _path);
+  buffer.reserve(engine->GetFlushBytes() * 2);
+  spare.reserve(engine->GetFlushBytes() * 2);
+}
+
+void BufferedFileWriter::Append(const char *data, size_t size)
+{
+  bool full;
+  {
+    lock_guard<mutex> guard(lock);
+    buffer.append(data, size);
+    bytesAppended += size;
+    full = buffer.size() >= engine->GetFlushBytes();
+  }
+  if (full) engine->RequestFlush();
+}
+
+void BufferedFileWriter::Append(const string &data)
+{
+  Append(data.data(), data.size());
+}
+
+void BufferedFileWriter::AppendFormat(const char *format, ...)
+{
+  char record[RECORD_SIZE];
+  va_list args, retry;
+  va_start(args, format);
+  va_copy(retry, args);
+  int size = vsnprintf(record, sizeof(record), format, args);
+  va_end(args);
+  if (size < 0) {
+    va_end(retry);
+    throw runtime_error("cannot format a record for " + path);
+  }
+  if (static_cast<size_t>(size) < sizeof(record)) {
+    va_end(retry);
+    Append(record, static_cast<size_t>(size));
+    return;
+  }
+
+  // vsnprintf returned the full length, so format again into a buffer that holds it and its terminator
+  unique_ptr<char[]> large(new char[size + 1]);
+  vsnprintf(large.get(), size + 1, format, retry);
+  va_end(retry);
+  Append(large.get(), static_cast<size_t>(size));
+}
+
+const string& BufferedFileWriter::GetPath() const
+{
+  return path;
+}
+
+unsigned long BufferedFileWriter::GetBytesAppended() const
+{
+  lock_guard<mutex> guard(lock);
+  return bytesAppended;
+}
+
+unsigned long BufferedFileWriter::GetBytesWritten() const
+{
+  lock_guard<mutex> guard(lock);
+  return bytesWritten;
+}
+
+void BufferedFileWriter::WriteOut()
+{
+  {
+    lock_guard<mutex> guard(lock);
+    if (buffer.empty()) return;
+    buffer.swap(spare);
+  }
+
+  // appenders keep filling the other buffer while this one is written
+  file.write(spare.data(), spare.size());
+  file.flush();
+
+  lock_guard<mutex> guard(lock);
+  bytesWritten += spare.size();
+  spare.clear();
+}
+
+PersistenceEngine::PersistenceEngine() :
+  flushRequested(false), running(true), flushBytes(64 * 1024), flushInterval(100)
+{
+  worker = thread(&PersistenceEngine::Run, this);
+}
+
+PersistenceEngine::~PersistenceEngine()
+{
+  {
+    lock_guard<mutex> guard(wakeLock);
+    running = false;
+  }
+  wake.notify_one();
+  worker.join();
+  WriteAll();
+}
+
+BufferedFileWriter* PersistenceEngine::GetWriter(const string &path, bool binary)
+{
+  lock_guard<mutex> guard(writersLock);
+  auto it = writers.find(path);
+  if (it == writers.end()) it = writers.insert(make_pair(path, unique_ptr<BufferedFileWriter>(new BufferedFileWriter(path, this, binary)))).first;
+  return it->second.get();
+}
+
+void PersistenceEngine::Flush()
+{
+  WriteAll();
+}
+
+void PersistenceEngine::SetThresholds(size_t _flushBytes, chrono::milliseconds _flushInterval)
+{
+  lock_guard<mutex> guard(wakeLock);
+  flushBytes = _flushBytes;
+  flushInterval = _flushInterval;
+}
+
+size_t PersistenceEngine::GetFlushBytes() const
+{
+  return flushBytes.load();
+}
+
+void PersistenceEngine::RequestFlush()
+{
+  {
+    lock_guard<mutex> guard(wakeLock);
+    flushRequested = true;
+  }
+  wake.notify_one();
+}
+
+void PersistenceEngine::WriteAll()
+{
+  // one writer at a time, so buffers reach each file in the order they were filled
+  lock_guard<mutex> flushGuard(flushLock);
+  lock_guard<mutex> guard(writersLock);
+  for (auto &writer : writers) writer.second->WriteOut();
+}
+
+void PersistenceEngine::Run()
+{
+  unique_lock<mutex> guard(wakeLock);
+  while (running) {
+    wake.wait_for(guard, flushInterval, [this]() { return flushRequested || !running; });
+    flushRequested = false;
+    guard.unlock();
+    WriteAll();
+    guard.lock();
+  }
+}
+
+#endif
@@ -1,240 +1,294 @@
-/**
- * positionservice.hpp
- * Defines the data types and Service for positions.
- *
- * @author Breman Thuraisingham
- */
-#ifndef POSITION_SERVICE_HPP
-#define POSITION_SERVICE_HPP
-
-#include <string>
-#include <map>
-#include "soa.hpp"
-#include "tradebookingservice.hpp"
-
-using namespace std;
-
-/**
- * Position class in a particular book.
- * Type T is the product type.
- */
-template<typename T>
-class Position
-{
-
-public:
-
-  // ctor for a position
-	Position() {};
-	Position(const T &_product);
-
-  // Get the product
-	const T& GetProduct() const;
-
-  // Get the position quantity
-	long GetPosition(std::string &book);
-
-  // Get the aggregate position
-	long GetAggregatePosition();
-
-	void AddPosition(const std::string &book, long amount) {
-
-		auto it = positions.find(book);
-
-		if (it == positions.end()) {
-
-			positions.insert(std::make_pair(book, amount));
-		
-		}
-
-		else 
-			
-			positions[book] += amount;
-	
-	}
-
-
-
-private:
-	T product;
-	map<std::string,long> positions;
-
-};
-
-/**
- * Position Service to manage positions across multiple books and secruties.
- * Keyed on product identifier.
- * Type T is the product type.
- */
-
-template<typename T>
-class PositionService : public Service<string, Position <T> >
-{
-
-public:
-
-	// Add a trade to the service
-	virtual void AddTrade(const Trade<T> &trade) = 0;
-
-};
-
-class BondPositionService : PositionService<Bond>
-{
-
-public:
-
-	static BondPositionService* instance() {
-
-		static BondPositionService inst; 
-		
-		return &inst;
-
-	}
-
-	void Add(Position<Bond> &position) {
-
-		positionData.insert(std::make_pair(position.GetProduct().GetProductId(), position));
-
-	}
-
-
-
-	void OnMessage(Position<Bond> &data) {
-
-		for (auto& listener : listeners) 	listener->ProcessAdd(data);
-
-	}
-
-	void AddTrade(const Trade<Bond> &trade)  {
-
-		std::cout << "The position service is taking trade " << trade.GetTradeId() << " from trading book service." << std::endl;
-
-		Bond thisBond = trade.GetProduct();
-
-		string product_ID = thisBond.GetProductId();
-
-		long quantity = (trade.GetSide() == BUY ? trade.GetQuantity() : -trade.GetQuantity());
-
-		auto it = positionData.find(product_ID);
-
-		if (it == positionData.end()) {
-
-			Position<Bond> pb(thisBond);
-
-			Add(pb);
-
-		}
-
-		positionData[product_ID].AddPosition(trade.GetBook(), quantity);
-
-		Position<Bond> pb = positionData[product_ID];
-
-		quantity = pb.GetAggregatePosition();
-
-		std::cout << "The updated position of product " << product_ID << " is " << quantity << std::endl;
-
-		OnMessage(pb);
-
-	}
-
-	Position<Bond>& GetData(std::string cusip) {
-
-		return positionData.at(cusip);
-
-	}
-
-
-	void AddListener(ServiceListener<Position<Bond>> *listener) {
-
-		listeners.push_back(listener);
-
-	}
-
-
-	const vector< ServiceListener<Position<Bond>>* >& GetListeners() const {
-
-		return listeners;
-
-	}
-
-private:
-
-	std::map<std::string, Position<Bond>> positionData;
-	
-	std::vector<ServiceListener<Position<Bond>>*> listeners;
-
-	BondPositionService() { positionData = std::map<std::string, Position<Bond>>(); };
-
-};
-
-class BondPositionServiceListener : public ServiceListener<Trade<Bond>> {
-
-public:
-
-	static BondPositionServiceListener* instance() {
-
-		static BondPositionServiceListener inst;
-
-		return &inst;
-
-	}
-
-	void ProcessAdd(Trade<Bond> &data) {
-
-		bondPositionService->AddTrade(data);
-
-	}
-
-
-	void ProcessRemove(Trade<Bond> &data) {}
-
-
-	void ProcessUpdate(Trade<Bond> &data) {}
-
-
-
-	BondPositionService* GetService() {
-
-		return bondPositionService;
-
-	}
-
-private:
-
-	BondPositionService * bondPositionService;
-
-	BondPositionServiceListener() { bondPositionService = BondPositionService::instance(); }
-
-};
-
-template<typename T>
-Position<T>::Position(const T &_product) :
-  product(_product)
-{
-	positions = std::map<std::string, long>();
-
-}
-
-template<typename T>
-const T& Position<T>::GetProduct() const
-{
-  return product;
-}
-
-template<typename T>
-long Position<T>::GetPosition(string &book)
-{
-  return positions[book];
-}
-
-template<typename T>
-long Position<T>::GetAggregatePosition()
-{
-	long result = 0;
-
-	for (auto pair : positions) 	result += pair.second;
-
-	return result;
-}
-
-#endif
+/**
+ * positionservice.hpp
+ * Defines the data types and Service for positions.
+ *
+ * @author Breman Thuraisingham
+ */
+#ifndef POSITION_SERVICE_HPP
+#define POSITION_SERVICE_HPP
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include "soa.hpp"
+#include "keyedstore.hpp"
+#include "tradebookingservice.hpp"
+
+using namespace std;
+
+/**
+ * Small integer ids for book names, handed out in order of first use.
+ * Positions index their per-book quantities by these ids.
+ */
+class BookRegistry
+{
+
+public:
+
+  static BookRegistry* instance();
+
+  // Get the id of a book, giving it the next id on first use
+  size_t Intern(const string &book);
+
+  // Get the name of a book id
+  string GetName(size_t id);
+
+private:
+
+  BookRegistry() {};
+
+  mutex lock;
+  KeyedStore<string, bool> books;
+
+};
+
+/**
+ * Position class in a particular book.
+ * Quantities are kept per book in a flat array indexed by BookRegistry id, and
+ * the aggregate across books is kept up to date as positions are added.
+ * Type T is the product type.
+ */
+template<typename T>
+class Position
+{
+
+public:
+
+  // ctor for a position
+	Position() : product(&ProductRegistry<T>::instance()->GetDefault()), aggregate(0) {};
+	Position(const T &_product);
+
+  // Get the product
+	const T& GetProduct() const;
+
+  // Get the position quantity
+	long GetPosition(const std::string &book) const;
+	long GetPosition(size_t bookId) const;
+
+  // Get the aggregate position
+	long GetAggregatePosition() const;
+
+	// Add to the quantity in a book, by name or by BookRegistry id
+
+	void AddPosition(const std::string &book, long amount) {
+
+		AddPosition(BookRegistry::instance()->Intern(book), amount);
+
+	}
+
+	void AddPosition(size_t bookId, long amount) {
+
+		if (bookId >= positions.size()) positions.resize(bookId + 1, 0);
+
+		positions[bookId] += amount;
+
+		aggregate += amount;
+
+	}
+
+
+
+private:
+	const T *product;
+	vector<long> positions;
+	long aggregate;
+
+};
+
+/**
+ * Position Service to manage positions across multiple books and secruties.
+ * Keyed on product identifier.
+ * Type T is the product type.
+ */
+
+template<typename T>
+class PositionService : public Service<string, Position <T> >
+{
+
+public:
+
+	// Add a trade to the service
+	virtual void AddTrade(const Trade<T> &trade) = 0;
+
+};
+
+class BondPositionService : PositionService<Bond>
+{
+
+public:
+
+	static BondPositionService* instance() {
+
+		static BondPositionService inst; 
+		
+		return &inst;
+
+	}
+
+	void Add(Position<Bond> &position) {
+
+		positionData.insert(std::make_pair(position.GetProduct().GetProductId(), position));
+
+	}
+
+
+
+	void OnMessage(Position<Bond> &data) {
+
+		for (auto& listener : listeners) 	listener->ProcessAdd(data);
+
+	}
+
+	void AddTrade(const Trade<Bond> &trade)  {
+
+		std::cout << "The position service is taking trade " << trade.GetTradeId() << " from trading book service." << std::endl;
+
+		const Bond& thisBond = trade.GetProduct();
+
+		string product_ID = thisBond.GetProductId();
+
+		long quantity = (trade.GetSide() == BUY ? trade.GetQuantity() : -trade.GetQuantity());
+
+		size_t i = positionData.IndexOf(product_ID);
+
+		if (i == KeyedStore<std::string, Position<Bond>>::NOT_FOUND) {
+
+			i = positionData.Assign(product_ID);
+
+			positionData.AtIndex(i) = Position<Bond>(thisBond);
+
+		}
+
+		// listeners get the stored position itself, which carries the new aggregate
+
+		Position<Bond>& pb = positionData.AtIndex(i);
+
+		pb.AddPosition(trade.GetBook(), quantity);
+
+		quantity = pb.GetAggregatePosition();
+
+		std::cout << "The updated position of product " << product_ID << " is " << quantity << std::endl;
+
+		OnMessage(pb);
+
+	}
+
+	Position<Bond>& GetData(std::string cusip) {
+
+		return positionData.at(cusip);
+
+	}
+
+
+	void AddListener(ServiceListener<Position<Bond>> *listener) {
+
+		listeners.push_back(listener);
+
+	}
+
+
+	const vector< ServiceListener<Position<Bond>>* >& GetListeners() const {
+
+		return listeners;
+
+	}
+
+private:
+
+	KeyedStore<std::string, Position<Bond>> positionData;
+	
+	std::vector<ServiceListener<Position<Bond>>*> listeners;
+
+	BondPositionService() {};
+
+};
+
+class BondPositionServiceListener : public ServiceListener<Trade<Bond>> {
+
+public:
+
+	static BondPositionServiceListener* instance() {
+
+		static BondPositionServiceListener inst;
+
+		return &inst;
+
+	}
+
+	void ProcessAdd(Trade<Bond> &data) {
+
+		bondPositionService->AddTrade(data);
+
+	}
+
+
+	void ProcessRemove(Trade<Bond> &data) {}
+
+
+	void ProcessUpdate(Trade<Bond> &data) {}
+
+
+
+	BondPositionService* GetService() {
+
+		return bondPositionService;
+
+	}
+
+private:
+
+	BondPositionService * bondPositionService;
+
+	BondPositionServiceListener() { bondPositionService = BondPositionService::instance(); }
+
+};
+
+BookRegistry* BookRegistry::instance()
+{
+  static BookRegistry inst;
+  return &inst;
+}
+
+size_t BookRegistry::Intern(const string &book)
+{
+  lock_guard<mutex> guard(lock);
+  return books.Assign(book);
+}
+
+string BookRegistry::GetName(size_t id)
+{
+  lock_guard<mutex> guard(lock);
+  return books.KeyAt(id);
+}
+
+template<typename T>
+Position<T>::Position(const T &_product) :
+  product(&ProductRegistry<T>::instance()->Intern(_product)), aggregate(0)
+{
+}
+
+template<typename T>
+const T& Position<T>::GetProduct() const
+{
+  return *product;
+}
+
+template<typename T>
+long Position<T>::GetPosition(const string &book) const
+{
+  return GetPosition(BookRegistry::instance()->Intern(book));
+}
+
+template<typename T>
+long Position<T>::GetPosition(size_t bookId) const
+{
+  return (bookId < positions.size() ? positions[bookId] : 0);
+}
+
+template<typename T>
+long Position<T>::GetAggregatePosition() const
+{
+	return aggregate;
+}
+
+#endif
@@ -0,0 +1,217 @@
+/**
+ * priceformat.hpp
+ * Parses and formats US Treasury fractional prices quoted in 32nds with an
+ * optional eighth-of-a-32nd digit, e.g. "100-18+" or "99-051".
+ * A tick is 1/256 of a point; "100-18+" is 100 * 256 + 18 * 8 + 4 ticks.
+ */
+#ifndef PRICE_FORMAT_HPP
+#define PRICE_FORMAT_HPP
+
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+// Number of ticks in one point of par
+const long TICKS_PER_POINT = 256;
+
+// Large enough for any formatted long tick value
+const size_t PRICE_STRING_SIZE = 32;
+
+/**
+ * Parse the characters in [first, last) into ticks without allocating.
+ * Returns false and leaves ticks untouched if the text is not of the form
+ * <points>-<two digit 32nds>[<eighth digit 0-7> or '+'].
+ */
+inline bool ParsePriceTicks(const char *first, const char *last, long &ticks)
+{
+  const char *p = first;
+
+  if (p == last || *p < '0' || *p > '9') return false;
+
+  long points = 0;
+  int digits = 0;
+  while (p != last && *p >= '0' && *p <= '9') {
+    points = points * 10 + (*p++ - '0');
+    if (++digits > 9) return false;
+  }
+
+  if (p == last || *p++ != '-') return false;
+
+  if (last - p < 2 || p[0] < '0' || p[0] > '3' || p[1] < '0' || p[1] > '9') return false;
+  int thirtySeconds = (p[0] - '0') * 10 + (p[1] - '0');
+  if (thirtySeconds > 31) return false;
+  p += 2;
+
+  int eighths = 0;
+  if (p != last) {
+    if (*p == '+') eighths = 4;
+    else if (*p >= '0' && *p <= '7') eighths = *p - '0';
+    else return false;
+    ++p;
+  }
+
+  if (p != last) return false;
+
+  ticks = points * TICKS_PER_POINT + thirtySeconds * 8 + eighths;
+  return true;
+}
+
+// Parse a fractional price into ticks, throwing invalid_argument on bad input
+inline long String2Ticks(const char *first, const char *last)
+{
+  long ticks;
+  if (!ParsePriceTicks(first, last, ticks)) throw invalid_argument("invalid fractional price: " + string(first, last));
+  return ticks;
+}
+
+inline long String2Ticks(const string &str)
+{
+  return String2Ticks(str.data(), str.data() + str.size());
+}
+
+// Convert between ticks and decimal prices
+inline double Ticks2Price(long ticks)
+{
+  return ticks / static_cast<double>(TICKS_PER_POINT);
+}
+
+inline long Price2Ticks(double price)
+{
+  return static_cast<long>(std::lround(price * TICKS_PER_POINT));
+}
+
+/**
+ * A price held exactly as a whole number of ticks.
+ * Conversions are constexpr, and arithmetic and comparisons are integer operations,
+ * so books can compare and index levels by price without floating point.
+ */
+class FixedPrice
+{
+
+public:
+
+  // ctor for a zero price
+  constexpr FixedPrice() : ticks(0) {}
+
+  // Make a price from ticks, or from a decimal price rounded to the nearest tick
+  static constexpr FixedPrice FromTicks(long ticks) { return FixedPrice(ticks); }
+  static constexpr FixedPrice FromDouble(double price) { return FixedPrice(static_cast<long>(price * TICKS_PER_POINT + (price < 0 ? -0.5 : 0.5))); }
+
+  // Make a price from a decimal price rounded down or up to a tick
+  static FixedPrice Floor(double price) { return FixedPrice(static_cast<long>(std::floor(price * TICKS_PER_POINT))); }
+  static FixedPrice Ceil(double price) { return FixedPrice(static_cast<long>(std::ceil(price * TICKS_PER_POINT))); }
+
+  constexpr long GetTicks() const { return ticks; }
+  constexpr double ToDouble() const { return ticks / static_cast<double>(TICKS_PER_POINT); }
+
+  FixedPrice& operator+=(FixedPrice other) { ticks += other.ticks; return *this; }
+  FixedPrice& operator-=(FixedPrice other) { ticks -= other.ticks; return *this; }
+
+private:
+
+  explicit constexpr FixedPrice(long _ticks) : ticks(_ticks) {}
+
+  long ticks;
+
+};
+
+constexpr FixedPrice operator+(FixedPrice a, FixedPrice b) { return FixedPrice::FromTicks(a.GetTicks() + b.GetTicks()); }
+constexpr FixedPrice operator-(FixedPrice a, FixedPrice b) { return FixedPrice::FromTicks(a.GetTicks() - b.GetTicks()); }
+constexpr FixedPrice operator-(FixedPrice a) { return FixedPrice::FromTicks(-a.GetTicks()); }
+constexpr FixedPrice operator*(FixedPrice a, long n) { return FixedPrice::FromTicks(a.GetTicks() * n); }
+constexpr FixedPrice operator*(long n, FixedPrice a) { return FixedPrice::FromTicks(a.GetTicks() * n); }
+
+constexpr bool operator==(FixedPrice a, FixedPrice b) { return a.GetTicks() == b.GetTicks(); }
+constexpr bool operator!=(FixedPrice a, FixedPrice b) { return a.GetTicks() != b.GetTicks(); }
+constexpr bool operator<(FixedPrice a, FixedPrice b) { return a.GetTicks() < b.GetTicks(); }
+constexpr bool operator<=(FixedPrice a, FixedPrice b) { return a.GetTicks() <= b.GetTicks(); }
+constexpr bool operator>(FixedPrice a, FixedPrice b) { return a.GetTicks() > b.GetTicks(); }
+constexpr bool operator>=(FixedPrice a, FixedPrice b) { return a.GetTicks() >= b.GetTicks(); }
+
+// One tick
+constexpr FixedPrice ONE_TICK = FixedPrice::FromTicks(1);
+
+// Parse a fractional price into a decimal price, throwing invalid_argument on bad input
+inline double String2Price(const char *first, const char *last)
+{
+  return Ticks2Price(String2Ticks(first, last));
+}
+
+inline double String2Price(const string &str)
+{
+  return Ticks2Price(String2Ticks(str));
+}
+
+// Parse a fractional price exactly, throwing invalid_argument on bad input
+inline FixedPrice String2FixedPrice(const char *first, const char *last)
+{
+  return FixedPrice::FromTicks(String2Ticks(first, last));
+}
+
+inline FixedPrice String2FixedPrice(const string &str)
+{
+  return FixedPrice::FromTicks(String2Ticks(str));
+}
+
+/**
+ * Format ticks into buf (at least PRICE_STRING_SIZE chars) without allocating.
+ * Returns the number of characters written; buf is also null terminated.
+ */
+inline size_t FormatPriceTicks(long ticks, char *buf)
+{
+  char *p = buf;
+
+  if (ticks < 0) {
+    *p++ = '-';
+    ticks = -ticks;
+  }
+
+  long points = ticks / TICKS_PER_POINT;
+  int fraction = static_cast<int>(ticks % TICKS_PER_POINT);
+  int thirtySeconds = fraction / 8, eighths = fraction % 8;
+
+  char digits[20];
+  int n = 0;
+  do {
+    digits[n++] = static_cast<char>('0' + points % 10);
+    points /= 10;
+  } while (points > 0);
+  while (n > 0) *p++ = digits[--n];
+
+  *p++ = '-';
+  *p++ = static_cast<char>('0' + thirtySeconds / 10);
+  *p++ = static_cast<char>('0' + thirtySeconds % 10);
+  *p++ = (eighths == 4 ? '+' : static_cast<char>('0' + eighths));
+  *p = '\0';
+
+  return static_cast<size_t>(p - buf);
+}
+
+inline size_t FormatPrice(FixedPrice price, char *buf)
+{
+  return FormatPriceTicks(price.GetTicks(), buf);
+}
+
+inline string Ticks2String(long ticks)
+{
+  char buf[PRICE_STRING_SIZE];
+  size_t n = FormatPriceTicks(ticks, buf);
+  return string(buf, n);
+}
+
+// Format a fixed-point price
+inline string Price2String(FixedPrice price)
+{
+  return Ticks2String(price.GetTicks());
+}
+
+// Format a decimal price, rounded to the nearest tick
+inline string Price2String(double price)
+{
+  return Ticks2String(Price2Ticks(price));
+}
+
+#endif
@@ -1,251 +1,322 @@
-/**
- * pricingservice.hpp
- * Defines the data types and Service for internal prices.
- *
- * @author Breman Thuraisingham
- */
-#ifndef PRICING_SERVICE_HPP
-#define PRICING_SERVICE_HPP
-
-#include <string>
-#include "soa.hpp"
-#include "products.hpp"
-
-/**
- * A price object consisting of mid and bid/offer spread.
- * Type T is the product type.
- */
-template<typename T>
-class Price
-{
-
-public:
-
-  // ctor for a price
-  Price() {};
-  Price(const T &_product, double _mid, double _bidOfferSpread);
-
-  // Get the product
-  const T& GetProduct() const;
-
-  // Get the mid price
-  double GetMid() const;
-
-  // Get the bid/offer spread around the mid
-  double GetBidOfferSpread() const;
-
-private:
-  const T& product;
-  double mid;
-  double bidOfferSpread;
-
-};
-
-/**
- * Pricing Service managing mid prices and bid/offers.
- * Keyed on product identifier.
- * Type T is the product type.
- */
-template<typename T>
-class PricingService : public Service<string,Price <T> >
-{
-};
-
-template<typename T>
-Price<T>::Price(const T &_product, double _mid, double _bidOfferSpread) :
-  product(_product)
-{
-  mid = _mid;
-  bidOfferSpread = _bidOfferSpread;
-}
-
-template<typename T>
-const T& Price<T>::GetProduct() const
-{
-  return product;
-}
-
-template<typename T>
-double Price<T>::GetMid() const
-{
-  return mid;
-}
-
-template<typename T>
-double Price<T>::GetBidOfferSpread() const
-{
-  return bidOfferSpread;
-}
-
-
-class BondPricingService : public Service<string, Price<Bond>>
-
-{
-
-public:
-
-	static BondPricingService* instance() {
-
-		static BondPricingService instance;
-
-		return &instance;
-
-	}
-
-	void OnMessage(Price<Bond> &p)
-	{
-		auto cusip = p.GetProduct().GetProductId();
-
-		PriceData.insert(std::make_pair(cusip, p));
-
-		for (auto& listener : listeners) 	listener->ProcessAdd(p);
-
-	}
-
-	Price<Bond>& GetData(std::string _cusip) {
-
-		return PriceData.at(_cusip);
-
-	}
-
-	void AddListener(ServiceListener<Price<Bond>> *listener) {
-
-		listeners.push_back(listener);
-
-	}
-
-	const vector< ServiceListener<Price<Bond>>* >& GetListeners() const {
-
-		return listeners;
-
-	}
-
-
-
-private:
-
-	std::map<std::string, Price<Bond> > PriceData;
-
-	std::vector<ServiceListener<Price<Bond> >*> listeners; 
-
-	BondPricingService() {}
-
-};
-
-
-
-class BondPricingServiceConnector : public Connector<Price<Bond>> {
-
-public:
-
-	static BondPricingServiceConnector* instance() {
-
-		static BondPricingServiceConnector inst;
-
-		return &inst;
-
-	}
-
-	void Publish(Price<Bond> &data) {}
-
-
-	void Subscribe ()
-	{
-
-		auto SplitLine = [](std::string& line) {
-
-			stringstream enter_line(line);
-
-			std::string item;
-
-			std::vector<std::string> tmp;
-
-			while (getline(enter_line, item, ',')) 	tmp.push_back(item);
-
-			return tmp;
-
-		};
-
-		auto String2Price = [](std::string& str) {
-
-			size_t idx = str.find_first_of('-');
-
-			double result = std::stoi(str.substr(0, idx));
-
-			int num1 = std::stoi(str.substr(idx + 1, 2));
-
-			char ch = str[str.size() - 1];
-
-			if (ch == '+') ch = '4';
-
-			int num2 = ch - '0';
-
-			result += (num1 * 8 + num2) / 256.0;
-
-			return result;
-
-		};
-
-
-
-		ifstream file("prices.txt");
-
-		string line;
-
-		getline(file, line);
-
-		string cusip, mid, bidofferspread;
-
-		while (getline(file, line)) {
-
-			std::vector<std::string> elems = SplitLine(line);
-
-			cusip = elems[0]; mid = elems[1]; bidofferspread = elems[2];
-
-			double mid_price = String2Price(mid);
-
-			double spread = String2Price(bidofferspread);
-
-			auto bond = bondBook->GetData(cusip);
-
-			Price<Bond> price(bond, mid_price, spread);
-
-			bondPricingService->OnMessage(price);
-
-		}
-
-		std::cout << "The pricing service finished subscribing.\n" << std::endl;
-
-	}
-
-	BondPricingService* GetService() {
-
-		return bondPricingService;
-
-	}
-
-
-
-private:
-
-	BondPricingServiceConnector()
-
-	{
-
-		bondPricingService = BondPricingService::instance();
-
-		bondBook = BondBook::instance();
-
-	}
-
-
-
-	BondPricingService * bondPricingService;;
-
-	BondBook * bondBook;
-
-};
-
-
-
-#endif
+/**
+ * pricingservice.hpp
+ * Defines the data types and Service for internal prices.
+ *
+ * @author Breman Thuraisingham
+ */
+#ifndef PRICING_SERVICE_HPP
+#define PRICING_SERVICE_HPP
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <type_traits>
+#include "soa.hpp"
+#include "keyedstore.hpp"
+#include "products.hpp"
+#include "priceformat.hpp"
+#include "csvreader.hpp"
+
+// Nanoseconds since the epoch; prices are stamped and journal records timed with this one clock
+inline int64_t NowNanos()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * A price object consisting of mid and bid/offer spread.
+ * Holds an interned product handle and fixed-point prices, so it is trivially copyable:
+ * services overwrite the latest price in place and queues can copy it as raw bytes.
+ * Type T is the product type.
+ */
+template<typename T>
+class Price
+{
+
+public:
+
+  // ctor for a price, timestamped in nanoseconds since the epoch
+  Price();
+  Price(const T &_product, FixedPrice _mid, FixedPrice _bidOfferSpread, int64_t _timestamp = 0);
+
+  // ctor for a price on a product already interned in the ProductRegistry, such as another message's
+  // GetProduct() or a BondBook entry; the registry lookup is skipped
+  Price(const T *_product, FixedPrice _mid, FixedPrice _bidOfferSpread, int64_t _timestamp = 0);
+
+  // Get the product
+  const T& GetProduct() const;
+
+  // Get the mid price
+  FixedPrice GetMid() const;
+
+  // Get the bid/offer spread around the mid
+  FixedPrice GetBidOfferSpread() const;
+
+  // Get the time the price was taken, or 0 if it was not stamped
+  int64_t GetTimestamp() const;
+
+private:
+  const T *product;
+  FixedPrice mid;
+  FixedPrice bidOfferSpread;
+  int64_t timestamp;
+
+};
+
+static_assert(is_trivially_copyable<Price<Bond> >::value, "Price<Bond> must stay trivially copyable");
+
+/**
+ * Pricing Service managing mid prices and bid/offers.
+ * Keyed on product identifier.
+ * Type T is the product type.
+ */
+template<typename T>
+class PricingService : public Service<string,Price <T> >
+{
+};
+
+template<typename T>
+Price<T>::Price() :
+  product(&ProductRegistry<T>::instance()->GetDefault()), mid(), bidOfferSpread(), timestamp(0)
+{
+}
+
+template<typename T>
+Price<T>::Price(const T &_product, FixedPrice _mid, FixedPrice _bidOfferSpread, int64_t _timestamp) :
+  Price(&ProductRegistry<T>::instance()->Intern(_product), _mid, _bidOfferSpread, _timestamp)
+{
+}
+
+template<typename T>
+Price<T>::Price(const T *_product, FixedPrice _mid, FixedPrice _bidOfferSpread, int64_t _timestamp) :
+  product(_product), mid(_mid), bidOfferSpread(_bidOfferSpread), timestamp(_timestamp)
+{
+}
+
+template<typename T>
+const T& Price<T>::GetProduct() const
+{
+  return *product;
+}
+
+template<typename T>
+FixedPrice Price<T>::GetMid() const
+{
+  return mid;
+}
+
+template<typename T>
+FixedPrice Price<T>::GetBidOfferSpread() const
+{
+  return bidOfferSpread;
+}
+
+template<typename T>
+int64_t Price<T>::GetTimestamp() const
+{
+  return timestamp;
+}
+
+
+class BondPricingService : public Service<string, Price<Bond>>
+
+{
+
+public:
+
+	static BondPricingService* instance() {
+
+		static BondPricingService instance;
+
+		return &instance;
+
+	}
+
+	void OnMessage(Price<Bond> &p)
+	{
+		// keep the latest price per CUSIP, overwritten in place, and hand listeners the stored copy
+
+		Price<Bond>& stored = PriceData[p.GetProduct().GetProductId()];
+
+		stored = p;
+
+		for (auto& listener : listeners) 	listener->ProcessAdd(stored);
+
+	}
+
+	Price<Bond>& GetData(std::string _cusip) {
+
+		return PriceData.at(_cusip);
+
+	}
+
+	void AddListener(ServiceListener<Price<Bond>> *listener) {
+
+		listeners.push_back(listener);
+
+	}
+
+	const vector< ServiceListener<Price<Bond>>* >& GetListeners() const {
+
+		return listeners;
+
+	}
+
+
+
+private:
+
+	KeyedStore<std::string, Price<Bond> > PriceData;
+
+	std::vector<ServiceListener<Price<Bond> >*> listeners; 
+
+	BondPricingService() {}
+
+};
+
+
+
+class BondPricingServiceConnector : public Connector<Price<Bond>> {
+
+public:
+
+	static BondPricingServiceConnector* instance() {
+
+		static BondPricingServiceConnector inst;
+
+		return &inst;
+
+	}
+
+	void Publish(Price<Bond> &data) {}
+
+
+	void Subscribe(IngestionMode mode = MAPPED)
+	{
+
+		if (mode == MAPPED) {
+
+			SubscribeMapped();
+
+			return;
+
+		}
+
+		auto SplitLine = [](std::string& line) {
+
+			stringstream enter_line(line);
+
+			std::string item;
+
+			std::vector<std::string> tmp;
+
+			while (getline(enter_line, item, ',')) 	tmp.push_back(item);
+
+			return tmp;
+
+		};
+
+
+		ifstream file("prices.txt");
+
+		string line;
+
+		getline(file, line);
+
+		string cusip, mid, bidofferspread;
+
+		while (getline(file, line)) {
+
+			std::vector<std::string> elems = SplitLine(line);
+
+			cusip = elems[0]; mid = elems[1]; bidofferspread = elems[2];
+
+			FixedPrice mid_price = String2FixedPrice(mid);
+
+			FixedPrice spread = String2FixedPrice(bidofferspread);
+
+			const Bond& bond = bondBook->GetData(cusip);
+
+			Price<Bond> price(&bond, mid_price, spread, NowNanos());
+
+			if (recorder) recorder->ProcessAdd(price);
+
+			bondPricingService->OnMessage(price);
+
+		}
+
+		std::cout << "The pricing service finished subscribing.\n" << std::endl;
+
+	}
+
+	// Pass every price read to a recorder before the service sees it, e.g. a JournalServiceListener
+	void SetRecorder(ServiceListener<Price<Bond>>* _recorder) {
+
+		recorder = _recorder;
+
+	}
+
+	BondPricingService* GetService() {
+
+		return bondPricingService;
+
+	}
+
+
+
+private:
+
+	// Tokenize prices.txt in place from a memory mapping instead of getline + SplitLine
+	void SubscribeMapped() {
+
+		MappedCsvReader reader("prices.txt");
+
+		reader.ForEachRow([&](const CsvField* elems, size_t count) {
+
+			if (count < 3) throw invalid_argument("malformed price row for " + elems[0].ToString());
+
+			FixedPrice mid_price = String2FixedPrice(elems[1].first, elems[1].last);
+
+			FixedPrice spread = String2FixedPrice(elems[2].first, elems[2].last);
+
+			const Bond& bond = bondBook->GetData(elems[0].ToString());
+
+			Price<Bond> price(&bond, mid_price, spread, NowNanos());
+
+			if (recorder) recorder->ProcessAdd(price);
+
+			bondPricingService->OnMessage(price);
+
+			return true;
+
+		});
+
+		std::cout << "The pricing service finished subscribing.\n" << std::endl;
+
+	}
+
+	BondPricingServiceConnector()
+
+	{
+
+		bondPricingService = BondPricingService::instance();
+
+		bondBook = BondBook::instance();
+
+		recorder = nullptr;
+
+	}
+
+
+
+	BondPricingService * bondPricingService;;
+
+	BondBook * bondBook;
+
+	ServiceListener<Price<Bond>>* recorder;
+
+};
+
+
+
+#endif
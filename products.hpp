@@ -1,429 +1,591 @@
-/**
- * products.hpp
- * Defines Bond and Interest Rate Swap products.
- *
- * @author Breman Thuraisingham
- */
-#ifndef PRODUCTS_HPP
-#define PRODUCTS_HPP
-
-#include <iostream>
-#include <fstream>
-#include <string>
-
-#include "boost/date_time/gregorian/gregorian.hpp"
-
-using namespace std;
-using namespace boost::gregorian;
-
-enum ProductType { IRSWAP, BOND };
-
-/**
- * Base class for a product.
- */
-class Product
-{
-
-public:
-
-  // ctor for a prduct
-  Product(string _productId, ProductType _productType);
-
-  // Get the product identifier
-  const string& GetProductId() const;
-
-  // Ge the product type
-  ProductType GetProductType() const;
-
-private:
-  string productId;
-  ProductType productType;
-
-};
-
-enum BondIdType { CUSIP, ISIN };
-
-/**
- * Bond product class
- */
-class Bond : public Product
-{
-
-public:
-
-  // ctor for a bond
-  Bond(string _productId, BondIdType _bondIdType, string _ticker, float _coupon, date _maturityDate);
-  Bond();
-
-  // Get the ticker
-  const string& GetTicker() const;
-
-  // Get the coupon
-  float GetCoupon() const;
-
-  // Get the maturity date
-  const date& GetMaturityDate() const;
-
-  // Get the bond identifier type
-  BondIdType GetBondIdType() const;
-
-  // Print the bond
-  friend ostream& operator<<(ostream &output, const Bond &bond);
-
-private:
-  string productId;
-  BondIdType bondIdType;
-  string ticker;
-  float coupon;
-  date maturityDate;
-
-};
-
-
-/**
- * Interest Rate Swap enums
- */
-enum DayCountConvention { THIRTY_THREE_SIXTY, ACT_THREE_SIXTY };
-enum PaymentFrequency { QUARTERLY, SEMI_ANNUAL, ANNUAL };
-enum FloatingIndex { LIBOR, EURIBOR };
-enum FloatingIndexTenor { TENOR_1M, TENOR_3M, TENOR_6M, TENOR_12M };
-enum Currency { USD, EUR, GBP };
-enum SwapType { STANDARD, FORWARD, IMM, MAC, BASIS };
-enum SwapLegType { OUTRIGHT, CURVE, FLY };
-
-/**
- * Interest Rate Swap product
- */
-class IRSwap : public Product
-{
-
-public:
-
-  // ctor for a swap
-  IRSwap(string productId, DayCountConvention _fixedLegDayCountConvention, DayCountConvention _floatingLegDayCountConvention, PaymentFrequency _fixedLegPaymentFrequency, FloatingIndex _floatingIndex, FloatingIndexTenor _floatingIndexTenor, date _effectiveDate, date _terminationDate, Currency _currency, int termYears, SwapType _swapType, SwapLegType _swapLegType);
-  IRSwap();
-
-  // Get the fixed leg daycount convention
-  DayCountConvention GetFixedLegDayCountConvention() const;
-
-  // Get the floating leg daycount convention
-  DayCountConvention GetFloatingLegDayCountConvention() const;
-
-  // Get the payment frequency on the fixed leg
-  PaymentFrequency GetFixedLegPaymentFrequency() const;
-
-  // Get the flaotig leg index
-  FloatingIndex GetFloatingIndex() const;
-
-  // Get the floating leg index tenor
-  FloatingIndexTenor GetFloatingIndexTenor() const;
-
-  // Get the effective date
-  const date& GetEffectiveDate() const;
-
-  // Get the termination date
-  const date& GetTerminationDate() const;
-
-  // Get the currency
-  Currency GetCurrency() const;
-
-  // Get the term in years
-  int GetTermYears() const;
-
-  // Get the swap type
-  SwapType GetSwapType() const;
-
-  // Get the swap leg type
-  SwapLegType GetSwapLegType() const;
-
-  // Print the swap
-  friend ostream& operator<<(ostream &output, const IRSwap &swap);
-
-private:
-  DayCountConvention fixedLegDayCountConvention;
-  DayCountConvention floatingLegDayCountConvention;
-  PaymentFrequency fixedLegPaymentFrequency;
-  FloatingIndex floatingIndex;
-  FloatingIndexTenor floatingIndexTenor;
-  date effectiveDate;
-  date terminationDate;
-  Currency currency;
-  int termYears;
-  SwapType swapType;
-  SwapLegType swapLegType;
-  string ToString(DayCountConvention dayCountConvention) const;
-  string ToString(PaymentFrequency paymentFrequency) const;
-  string ToString(FloatingIndex floatingIndex) const;
-  string ToString(FloatingIndexTenor floatingIndexTenor) const;
-  string ToString(Currency currency) const;
-  string ToString(SwapType swapType) const;
-  string ToString(SwapLegType swapLegType) const;
-
-};
-
-Product::Product(string _productId, ProductType _productType)
-{
-  productId = _productId;
-  productType = _productType;
-}
-
-const string& Product::GetProductId() const
-{
-  return productId;
-}
-
-ProductType Product::GetProductType() const
-{
-  return productType;
-}
-
-Bond::Bond(string _productId, BondIdType _bondIdType, string _ticker, float _coupon, date _maturityDate) : Product(_productId, BOND)
-{
-  bondIdType = _bondIdType;
-  ticker = _ticker;
-  coupon = _coupon;
-  maturityDate =_maturityDate;
-}
-
-Bond::Bond() : Product("000", BOND)
-{
-}
-
-const string& Bond::GetTicker() const
-{
-  return ticker;
-}
-
-float Bond::GetCoupon() const
-{
-  return coupon;
-}
-
-const date& Bond::GetMaturityDate() const
-{
-  return maturityDate;
-}
-
-BondIdType Bond::GetBondIdType() const
-{
-  return bondIdType;
-}
-
-ostream& operator<<(ostream &output, const Bond &bond)
-{
-  output << bond.ticker << " " << bond.coupon << " " << bond.GetMaturityDate();
-  return output;
-}
-
-IRSwap::IRSwap(string _productId, DayCountConvention _fixedLegDayCountConvention, DayCountConvention _floatingLegDayCountConvention, PaymentFrequency _fixedLegPaymentFrequency, FloatingIndex _floatingIndex, FloatingIndexTenor _floatingIndexTenor, date _effectiveDate, date _terminationDate, Currency _currency, int _termYears, SwapType _swapType, SwapLegType _swapLegType) :
-  Product(_productId, IRSWAP)
-{
-  fixedLegDayCountConvention =_fixedLegDayCountConvention;
-  floatingLegDayCountConvention =_floatingLegDayCountConvention;
-  fixedLegPaymentFrequency =_fixedLegPaymentFrequency;
-  floatingIndex =_floatingIndex;
-  floatingIndexTenor =_floatingIndexTenor;
-  effectiveDate =_effectiveDate;
-  terminationDate =_terminationDate;
-  currency =_currency;
-  termYears = _termYears;
-  swapType =_swapType;
-  swapLegType = _swapLegType;
-  effectiveDate =_effectiveDate;
-  terminationDate =_terminationDate;
-}
-
-IRSwap::IRSwap() : Product(0, IRSWAP)
-{
-}
-
-DayCountConvention IRSwap::GetFixedLegDayCountConvention() const
-{
-  return fixedLegDayCountConvention;
-}
-
-DayCountConvention IRSwap::GetFloatingLegDayCountConvention() const
-{
-  return floatingLegDayCountConvention;
-}
-
-PaymentFrequency IRSwap::GetFixedLegPaymentFrequency() const
-{
-  return fixedLegPaymentFrequency;
-}
-
-FloatingIndex IRSwap::GetFloatingIndex() const
-{
-  return floatingIndex;
-}
-
-FloatingIndexTenor IRSwap::GetFloatingIndexTenor() const
-{
-  return floatingIndexTenor;
-}
-
-const date& IRSwap::GetEffectiveDate() const
-{
-  return effectiveDate;
-}
-
-const date& IRSwap::GetTerminationDate() const
-{
-  return terminationDate;
-}
-
-Currency IRSwap::GetCurrency() const
-{
-  return currency;
-}
-
-int IRSwap::GetTermYears() const
-{
-  return termYears;
-}
-
-SwapType IRSwap::GetSwapType() const
-{
-  return swapType;
-}
-
-SwapLegType IRSwap::GetSwapLegType() const
-{
-  return swapLegType;
-}
-
-
-ostream& operator<<(ostream &output, const IRSwap &swap)
-{
-  output << "fixedDayCount:" << swap.ToString(swap.GetFixedLegDayCountConvention()) << " floatingDayCount:" << swap.ToString(swap.GetFloatingLegDayCountConvention()) << " paymentFreq:" << swap.ToString(swap.GetFixedLegPaymentFrequency()) << " " << swap.ToString(swap.GetFloatingIndexTenor()) << swap.ToString(swap.GetFloatingIndex()) << " effective:" << swap.GetEffectiveDate() << " termination:" << swap.GetTerminationDate() << " " << swap.ToString(swap.GetCurrency()) << " " << swap.GetTermYears() << "yrs " << swap.ToString(swap.GetSwapType()) << " " << swap.ToString(swap.GetSwapLegType());
-  return output;
-}
-
-string IRSwap::ToString(DayCountConvention dayCountConvention) const
-{
-  switch (dayCountConvention) {
-  case THIRTY_THREE_SIXTY: return "30/360";
-  case ACT_THREE_SIXTY: return "Act/360";
-  default: return "";
-  }
-}
-
-string IRSwap::ToString(PaymentFrequency paymentFrequency) const
-{
-  switch (paymentFrequency) {
-  case QUARTERLY: return "Quarterly";
-  case SEMI_ANNUAL: return "Semi-Annual";
-  case ANNUAL: return "Annual";
-  default: return "";
-  }
-}
-
-string IRSwap::ToString(FloatingIndex floatingIndex) const
-{
-  switch (floatingIndex) {
-  case LIBOR: return "LIBOR";
-  case EURIBOR: return "EURIBOR";
-  default: return "";
-  }
-}
-
-string IRSwap::ToString(FloatingIndexTenor floatingIndexTenor) const
-{ 
-  switch(floatingIndexTenor) {
-  case TENOR_1M: return "1m";
-  case TENOR_3M: return "3m";
-  case TENOR_6M: return "6m";
-  case TENOR_12M: return "12m";
-  default: return "";
-  }
-}
-
-string IRSwap::ToString(Currency currency) const
-{ 
-  switch(currency) {
-  case USD: return "USD";
-  case EUR: return "EUR";
-  case GBP: return "GBP";
-  default: return "";
-  }
-}
-
-string IRSwap::ToString(SwapType swapType) const
-{ 
-  switch(swapType) {
-  case STANDARD: return "Standard";
-  case FORWARD: return "Forward";
-  case IMM: return "IMM";
-  case MAC: return "MAC";
-  case BASIS: return "Basis";
-  default: return "";
-  }
-}
-
-string IRSwap::ToString(SwapLegType swapLegType) const
-{ 
-  switch(swapLegType) {
-  case OUTRIGHT: return "Outright";
-  case CURVE: return "Curve";
-  case FLY: return "Fly";
-  default: return "";
-  }
-}
-
-class BondBook {
-
-public:
-
-	static BondBook* instance() {
-
-		static BondBook inst;
-
-		return &inst;
-
-	}
-
-
-
-	Bond& GetData(const std::string& productId) {
-
-		return bondData[productId];
-
-	}
-
-
-	void Add(Bond &bond) {
-
-		bondData.insert(std::make_pair(bond.GetProductId(), bond));
-
-	}
-
-
-	std::vector<Bond> GetBonds(const std::string& ticker) const {
-
-		std::vector<Bond> vec;
-
-		for (auto& bd : bondData) {
-
-			if (bd.second.GetTicker() == ticker) vec.push_back(bd.second);
-
-		}
-
-		return vec;
-
-	}
-
-
-
-private:
-	
-	map<string, Bond> bondData;
-
-	BondBook() {
-
-		bondData = map<string, Bond>();
-
-	}
-
-};
-
-#endif
+/**
+ * products.hpp
+ * Defines Bond and Interest Rate Swap products.
+ *
+ * @author Breman Thuraisingham
+ */
+#ifndef PRODUCTS_HPP
+#define PRODUCTS_HPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+#include "boost/date_time/gregorian/gregorian.hpp"
+#include "keyedstore.hpp"
+
+using namespace std;
+using namespace boost::gregorian;
+
+enum ProductType { IRSWAP, BOND };
+
+/**
+ * Base class for a product.
+ */
+class Product
+{
+
+public:
+
+  // ctor for a prduct
+  Product(string _productId, ProductType _productType);
+
+  // Get the product identifier
+  const string& GetProductId() const;
+
+  // Ge the product type
+  ProductType GetProductType() const;
+
+private:
+  string productId;
+  ProductType productType;
+
+};
+
+enum BondIdType { CUSIP, ISIN };
+
+/**
+ * Bond product class
+ */
+class Bond : public Product
+{
+
+public:
+
+  // ctor for a bond
+  Bond(string _productId, BondIdType _bondIdType, string _ticker, float _coupon, date _maturityDate);
+  Bond();
+
+  // Get the ticker
+  const string& GetTicker() const;
+
+  // Get the coupon
+  float GetCoupon() const;
+
+  // Get the maturity date
+  const date& GetMaturityDate() const;
+
+  // Get the bond identifier type
+  BondIdType GetBondIdType() const;
+
+  // Print the bond
+  friend ostream& operator<<(ostream &output, const Bond &bond);
+
+private:
+  string productId;
+  BondIdType bondIdType;
+  string ticker;
+  float coupon;
+  date maturityDate;
+
+};
+
+
+/**
+ * Interest Rate Swap enums
+ */
+enum DayCountConvention { THIRTY_THREE_SIXTY, ACT_THREE_SIXTY };
+enum PaymentFrequency { QUARTERLY, SEMI_ANNUAL, ANNUAL };
+enum FloatingIndex { LIBOR, EURIBOR };
+enum FloatingIndexTenor { TENOR_1M, TENOR_3M, TENOR_6M, TENOR_12M };
+enum Currency { USD, EUR, GBP };
+enum SwapType { STANDARD, FORWARD, IMM, MAC, BASIS };
+enum SwapLegType { OUTRIGHT, CURVE, FLY };
+
+/**
+ * Interest Rate Swap product
+ */
+class IRSwap : public Product
+{
+
+public:
+
+  // ctor for a swap
+  IRSwap(string productId, DayCountConvention _fixedLegDayCountConvention, DayCountConvention _floatingLegDayCountConvention, PaymentFrequency _fixedLegPaymentFrequency, FloatingIndex _floatingIndex, FloatingIndexTenor _floatingIndexTenor, date _effectiveDate, date _terminationDate, Currency _currency, int termYears, SwapType _swapType, SwapLegType _swapLegType);
+  IRSwap();
+
+  // Get the fixed leg daycount convention
+  DayCountConvention GetFixedLegDayCountConvention() const;
+
+  // Get the floating leg daycount convention
+  DayCountConvention GetFloatingLegDayCountConvention() const;
+
+  // Get the payment frequency on the fixed leg
+  PaymentFrequency GetFixedLegPaymentFrequency() const;
+
+  // Get the flaotig leg index
+  FloatingIndex GetFloatingIndex() const;
+
+  // Get the floating leg index tenor
+  FloatingIndexTenor GetFloatingIndexTenor() const;
+
+  // Get the effective date
+  const date& GetEffectiveDate() const;
+
+  // Get the termination date
+  const date& GetTerminationDate() const;
+
+  // Get the currency
+  Currency GetCurrency() const;
+
+  // Get the term in years
+  int GetTermYears() const;
+
+  // Get the swap type
+  SwapType GetSwapType() const;
+
+  // Get the swap leg type
+  SwapLegType GetSwapLegType() const;
+
+  // Print the swap
+  friend ostream& operator<<(ostream &output, const IRSwap &swap);
+
+private:
+  DayCountConvention fixedLegDayCountConvention;
+  DayCountConvention floatingLegDayCountConvention;
+  PaymentFrequency fixedLegPaymentFrequency;
+  FloatingIndex floatingIndex;
+  FloatingIndexTenor floatingIndexTenor;
+  date effectiveDate;
+  date terminationDate;
+  Currency currency;
+  int termYears;
+  SwapType swapType;
+  SwapLegType swapLegType;
+  string ToString(DayCountConvention dayCountConvention) const;
+  string ToString(PaymentFrequency paymentFrequency) const;
+  string ToString(FloatingIndex floatingIndex) const;
+  string ToString(FloatingIndexTenor floatingIndexTenor) const;
+  string ToString(Currency currency) const;
+  string ToString(SwapType swapType) const;
+  string ToString(SwapLegType swapLegType) const;
+
+};
+
+Product::Product(string _productId, ProductType _productType)
+{
+  productId = _productId;
+  productType = _productType;
+}
+
+const string& Product::GetProductId() const
+{
+  return productId;
+}
+
+ProductType Product::GetProductType() const
+{
+  return productType;
+}
+
+Bond::Bond(string _productId, BondIdType _bondIdType, string _ticker, float _coupon, date _maturityDate) : Product(_productId, BOND)
+{
+  bondIdType = _bondIdType;
+  ticker = _ticker;
+  coupon = _coupon;
+  maturityDate =_maturityDate;
+}
+
+Bond::Bond() : Product("000", BOND)
+{
+}
+
+const string& Bond::GetTicker() const
+{
+  return ticker;
+}
+
+float Bond::GetCoupon() const
+{
+  return coupon;
+}
+
+const date& Bond::GetMaturityDate() const
+{
+  return maturityDate;
+}
+
+BondIdType Bond::GetBondIdType() const
+{
+  return bondIdType;
+}
+
+ostream& operator<<(ostream &output, const Bond &bond)
+{
+  output << bond.ticker << " " << bond.coupon << " " << bond.GetMaturityDate();
+  return output;
+}
+
+IRSwap::IRSwap(string _productId, DayCountConvention _fixedLegDayCountConvention, DayCountConvention _floatingLegDayCountConvention, PaymentFrequency _fixedLegPaymentFrequency, FloatingIndex _floatingIndex, FloatingIndexTenor _floatingIndexTenor, date _effectiveDate, date _terminationDate, Currency _currency, int _termYears, SwapType _swapType, SwapLegType _swapLegType) :
+  Product(_productId, IRSWAP)
+{
+  fixedLegDayCountConvention =_fixedLegDayCountConvention;
+  floatingLegDayCountConvention =_floatingLegDayCountConvention;
+  fixedLegPaymentFrequency =_fixedLegPaymentFrequency;
+  floatingIndex =_floatingIndex;
+  floatingIndexTenor =_floatingIndexTenor;
+  effectiveDate =_effectiveDate;
+  terminationDate =_terminationDate;
+  currency =_currency;
+  termYears = _termYears;
+  swapType =_swapType;
+  swapLegType = _swapLegType;
+  effectiveDate =_effectiveDate;
+  terminationDate =_terminationDate;
+}
+
+IRSwap::IRSwap() : Product(0, IRSWAP)
+{
+}
+
+DayCountConvention IRSwap::GetFixedLegDayCountConvention() const
+{
+  return fixedLegDayCountConvention;
+}
+
+DayCountConvention IRSwap::GetFloatingLegDayCountConvention() const
+{
+  return floatingLegDayCountConvention;
+}
+
+PaymentFrequency IRSwap::GetFixedLegPaymentFrequency() const
+{
+  return fixedLegPaymentFrequency;
+}
+
+FloatingIndex IRSwap::GetFloatingIndex() const
+{
+  return floatingIndex;
+}
+
+FloatingIndexTenor IRSwap::GetFloatingIndexTenor() const
+{
+  return floatingIndexTenor;
+}
+
+const date& IRSwap::GetEffectiveDate() const
+{
+  return effectiveDate;
+}
+
+const date& IRSwap::GetTerminationDate() const
+{
+  return terminationDate;
+}
+
+Currency IRSwap::GetCurrency() const
+{
+  return currency;
+}
+
+int IRSwap::GetTermYears() const
+{
+  return termYears;
+}
+
+SwapType IRSwap::GetSwapType() const
+{
+  return swapType;
+}
+
+SwapLegType IRSwap::GetSwapLegType() const
+{
+  return swapLegType;
+}
+
+
+ostream& operator<<(ostream &output, const IRSwap &swap)
+{
+  output << "fixedDayCount:" << swap.ToString(swap.GetFixedLegDayCountConvention()) << " floatingDayCount:" << swap.ToString(swap.GetFloatingLegDayCountConvention()) << " paymentFreq:" << swap.ToString(swap.GetFixedLegPaymentFrequency()) << " " << swap.ToString(swap.GetFloatingIndexTenor()) << swap.ToString(swap.GetFloatingIndex()) << " effective:" << swap.GetEffectiveDate() << " termination:" << swap.GetTerminationDate() << " " << swap.ToString(swap.GetCurrency()) << " " << swap.GetTermYears() << "yrs " << swap.ToString(swap.GetSwapType()) << " " << swap.ToString(swap.GetSwapLegType());
+  return output;
+}
+
+string IRSwap::ToString(DayCountConvention dayCountConvention) const
+{
+  switch (dayCountConvention) {
+  case THIRTY_THREE_SIXTY: return "30/360";
+  case ACT_THREE_SIXTY: return "Act/360";
+  default: return "";
+  }
+}
+
+string IRSwap::ToString(PaymentFrequency paymentFrequency) const
+{
+  switch (paymentFrequency) {
+  case QUARTERLY: return "Quarterly";
+  case SEMI_ANNUAL: return "Semi-Annual";
+  case ANNUAL: return "Annual";
+  default: return "";
+  }
+}
+
+string IRSwap::ToString(FloatingIndex floatingIndex) const
+{
+  switch (floatingIndex) {
+  case LIBOR: return "LIBOR";
+  case EURIBOR: return "EURIBOR";
+  default: return "";
+  }
+}
+
+string IRSwap::ToString(FloatingIndexTenor floatingIndexTenor) const
+{ 
+  switch(floatingIndexTenor) {
+  case TENOR_1M: return "1m";
+  case TENOR_3M: return "3m";
+  case TENOR_6M: return "6m";
+  case TENOR_12M: return "12m";
+  default: return "";
+  }
+}
+
+string IRSwap::ToString(Currency currency) const
+{ 
+  switch(currency) {
+  case USD: return "USD";
+  case EUR: return "EUR";
+  case GBP: return "GBP";
+  default: return "";
+  }
+}
+
+string IRSwap::ToString(SwapType swapType) const
+{ 
+  switch(swapType) {
+  case STANDARD: return "Standard";
+  case FORWARD: return "Forward";
+  case IMM: return "IMM";
+  case MAC: return "MAC";
+  case BASIS: return "Basis";
+  default: return "";
+  }
+}
+
+string IRSwap::ToString(SwapLegType swapLegType) const
+{ 
+  switch(swapLegType) {
+  case OUTRIGHT: return "Outright";
+  case CURVE: return "Curve";
+  case FLY: return "Fly";
+  default: return "";
+  }
+}
+
+/**
+ * Registry holding one copy of each product for the life of the program.
+ * Messages keep a pointer to the registered copy instead of a product value,
+ * so copying a message no longer copies the product's strings.
+ * Products are found through an open-addressed table read without locking.
+ * Registering takes a lock and publishes the pointer into a free slot; when the
+ * table is half full a table twice the size replaces it, and the old ones are
+ * kept for readers still probing them, which costs at most the size of the current table.
+ * Type T is the product type; it must be default constructible and provide GetProductId().
+ */
+template<typename T>
+class ProductRegistry
+{
+
+public:
+
+  static ProductRegistry<T>* instance();
+
+  // Get the registered copy of a product, registering it on first sight; the first registration of an id wins
+  const T& Intern(const T &product);
+
+  // Get the registered copy of a product by id, or nullptr
+  const T* Find(const string &productId) const;
+
+  // Get the registered default-constructed product
+  const T& GetDefault() const;
+
+  // Get the number of registered products
+  size_t Size() const;
+
+private:
+
+  struct Table
+  {
+    size_t mask;
+    unique_ptr<atomic<const T*>[]> slots;
+  };
+
+  ProductRegistry();
+
+  // Put a product into a free slot of a table; called under lock
+  static void Place(Table &table, const T *product);
+
+  atomic<const Table*> table;
+  mutex lock;
+  vector<unique_ptr<T> > products;
+  vector<unique_ptr<Table> > tables;
+  atomic<size_t> size;
+  const T *defaultProduct;
+
+};
+
+template<typename T>
+ProductRegistry<T>* ProductRegistry<T>::instance()
+{
+  static ProductRegistry<T> inst;
+  return &inst;
+}
+
+template<typename T>
+ProductRegistry<T>::ProductRegistry() :
+  size(0)
+{
+  // the default product is kept apart from the ids, so a real product may still claim its id
+  defaultProduct = new T();
+  products.push_back(unique_ptr<T>(const_cast<T*>(defaultProduct)));
+
+  unique_ptr<Table> first(new Table());
+  first->mask = 63;
+  first->slots.reset(new atomic<const T*>[first->mask + 1]);
+  for (size_t i = 0; i <= first->mask; ++i) first->slots[i].store(nullptr, memory_order_relaxed);
+  tables.push_back(move(first));
+  table.store(tables.back().get(), memory_order_release);
+}
+
+template<typename T>
+void ProductRegistry<T>::Place(Table &t, const T *product)
+{
+  size_t i = hash<string>()(product->GetProductId()) & t.mask;
+  while (t.slots[i].load(memory_order_relaxed) != nullptr) i = (i + 1) & t.mask;
+  t.slots[i].store(product, memory_order_release);
+}
+
+template<typename T>
+const T& ProductRegistry<T>::Intern(const T &product)
+{
+  const T *found = Find(product.GetProductId());
+  if (found) return *found;
+
+  lock_guard<mutex> guard(lock);
+  found = Find(product.GetProductId());
+  if (found) return *found;
+
+  products.push_back(unique_ptr<T>(new T(product)));
+  const T *registered = products.back().get();
+
+  const Table *current = table.load(memory_order_relaxed);
+  if ((size.load(memory_order_relaxed) + 1) * 2 > current->mask + 1) {
+    unique_ptr<Table> grown(new Table());
+    grown->mask = current->mask * 2 + 1;
+    grown->slots.reset(new atomic<const T*>[grown->mask + 1]);
+    for (size_t i = 0; i <= grown->mask; ++i) grown->slots[i].store(nullptr, memory_order_relaxed);
+    for (size_t i = 1; i < products.size(); ++i) Place(*grown, products[i].get());
+    tables.push_back(move(grown));
+    table.store(tables.back().get(), memory_order_release);
+  }
+  else {
+    Place(*tables.back(), registered);
+  }
+  size.fetch_add(1, memory_order_relaxed);
+  return *registered;
+}
+
+template<typename T>
+const T* ProductRegistry<T>::Find(const string &productId) const
+{
+  const Table *t = table.load(memory_order_acquire);
+  size_t i = hash<string>()(productId) & t->mask;
+  for (;;) {
+    const T *product = t->slots[i].load(memory_order_acquire);
+    if (product == nullptr) return nullptr;
+    if (product->GetProductId() == productId) return product;
+    i = (i + 1) & t->mask;
+  }
+}
+
+template<typename T>
+const T& ProductRegistry<T>::GetDefault() const
+{
+  return *defaultProduct;
+}
+
+template<typename T>
+size_t ProductRegistry<T>::Size() const
+{
+  return size.load(memory_order_relaxed);
+}
+
+class BondBook {
+
+public:
+
+	static BondBook* instance() {
+
+		static BondBook inst;
+
+		return &inst;
+
+	}
+
+
+
+	// Get the registered bond; unknown ids give the default bond
+
+	const Bond& GetData(const std::string& productId) {
+
+		auto it = bondData.find(productId);
+
+		return (it == bondData.end() ? registry->GetDefault() : *it->second);
+
+	}
+
+
+	// Get a bond if the book has it, otherwise nullptr
+
+	const Bond* Find(const std::string& productId) const {
+
+		auto it = bondData.find(productId);
+
+		return (it == bondData.end() ? nullptr : it->second);
+
+	}
+
+
+	void Add(const Bond &bond) {
+
+		bondData.insert(std::make_pair(bond.GetProductId(), &registry->Intern(bond)));
+
+	}
+
+
+	std::vector<Bond> GetBonds(const std::string& ticker) const {
+
+		std::vector<Bond> vec;
+
+		for (auto& bd : bondData) {
+
+			if (bd.second->GetTicker() == ticker) vec.push_back(*bd.second);
+
+		}
+
+		return vec;
+
+	}
+
+
+
+private:
+	
+	KeyedStore<string, const Bond*> bondData;
+
+	ProductRegistry<Bond>* registry;
+
+	BondBook() {
+
+		registry = ProductRegistry<Bond>::instance();
+
+	}
+
+};
+
+#endif
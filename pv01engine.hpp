@@ -0,0 +1,265 @@
+/**
+ * pv01engine.hpp
+ * Price and PV01 analytics for a universe of bonds.
+ * Each bond's semi-annual cash-flow schedule is built once when it is added and
+ * cached as its coupon, the fraction of a period to its first payment and its
+ * number of payments, in arrays indexed by bond. Re-risking the universe after a
+ * yield move walks the payment periods and updates every bond per period in a
+ * branch-free loop over those arrays, which the compiler vectorizes across bonds.
+ */
+#ifndef PV01_ENGINE_HPP
+#define PV01_ENGINE_HPP
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <stdexcept>
+#include "products.hpp"
+#include "keyedstore.hpp"
+
+using namespace std;
+
+/**
+ * Prices bonds off a yield with semi-annual compounding, the first period
+ * prorated by actual days. PV01 is the price change for a one basis point fall in
+ * yield, per unit of face value, so a position's PV01 is the unit PV01 times its quantity.
+ */
+class PV01Engine
+{
+
+public:
+
+  // ctor for an engine valuing cash flows after the settlement date
+  PV01Engine(const date &_settlement = day_clock::local_day());
+
+  // Add a bond with its yield, or replace the yield of a bond already added; returns its index
+  size_t AddBond(const Bond &bond, double yield);
+
+  // Get the index of a bond, or KeyedStore's NOT_FOUND
+  size_t IndexOf(const string &productId) const;
+
+  // Get the number of bonds
+  size_t Size() const;
+
+  // Set the yield of one bond, or move every yield by shift
+  void SetYield(size_t index, double yield);
+  void ShiftYields(double shift);
+  double GetYield(size_t index) const;
+
+  // Recompute price and PV01 for every bond from the current yields
+  void Compute();
+
+  // Whether the yields or bonds changed since the last Compute
+  bool IsStale() const;
+
+  // Price every bond with its yield moved by shifts[i] into the caller's arrays, leaving the engine as it is;
+  // scratch is resized as needed, so threads with their own scratch and outputs may evaluate at once
+  void Evaluate(const double *shifts, double *outPrices, double *outUnitPV01s, vector<double> &scratch) const;
+
+  // Get the years from settlement to the last payment of a bond
+  double GetMaturityYears(size_t index) const;
+
+  // Get the dirty price and the PV01 of one unit of face value as of the last Compute
+  double GetPrice(size_t index) const;
+  double GetUnitPV01(size_t index) const;
+
+  // Get the unit PV01 of a bond by id, or 0 for a bond the engine does not know
+  double GetUnitPV01(const string &productId) const;
+
+  // Change the settlement date, rebuilding every schedule
+  void SetSettlementDate(const date &_settlement);
+
+private:
+
+  // Cache the remaining payment schedule of bond i
+  void BuildSchedule(size_t i);
+  void RebuildSchedules();
+
+  // Price every bond at its yield plus shift (none when shifts is null), using three scratch arrays of Size()
+  void Price(const double *shifts, double *price, double *unitPV01, double *discount, double *decay, double *weight) const;
+
+  date settlement;
+  KeyedStore<string, const Bond*> bonds;
+
+  // per bond, by index
+  vector<double> yields;
+  vector<double> prices;
+  vector<double> unitPV01s;
+
+  // schedules: coupon per period per unit face, periods to the first payment, number of payments
+  vector<double> coupons;
+  vector<double> firstPeriods;
+  vector<double> periodCounts;
+  double maxPeriods;
+
+  // scratch for Compute
+  vector<double> discounts;
+  vector<double> decays;
+  vector<double> weighted;
+
+  bool dirty;
+
+};
+
+PV01Engine::PV01Engine(const date &_settlement) :
+  settlement(_settlement), maxPeriods(0), dirty(false)
+{
+}
+
+size_t PV01Engine::AddBond(const Bond &bond, double yield)
+{
+  size_t i = bonds.IndexOf(bond.GetProductId());
+  if (i != KeyedStore<string, const Bond*>::NOT_FOUND) {
+    SetYield(i, yield);
+    return i;
+  }
+
+  i = bonds.Assign(bond.GetProductId());
+  bonds.AtIndex(i) = &ProductRegistry<Bond>::instance()->Intern(bond);
+  yields.push_back(yield);
+  prices.push_back(0);
+  unitPV01s.push_back(0);
+  coupons.push_back(0);
+  firstPeriods.push_back(0);
+  periodCounts.push_back(0);
+  BuildSchedule(i);
+  dirty = true;
+  return i;
+}
+
+size_t PV01Engine::IndexOf(const string &productId) const
+{
+  return bonds.IndexOf(productId);
+}
+
+size_t PV01Engine::Size() const
+{
+  return bonds.size();
+}
+
+void PV01Engine::SetYield(size_t i, double yield)
+{
+  yields[i] = yield;
+  dirty = true;
+}
+
+void PV01Engine::ShiftYields(double shift)
+{
+  for (size_t i = 0; i < yields.size(); ++i) yields[i] += shift;
+  dirty = true;
+}
+
+double PV01Engine::GetYield(size_t i) const
+{
+  return yields[i];
+}
+
+void PV01Engine::BuildSchedule(size_t i)
+{
+  const Bond &bond = *bonds.AtIndex(i);
+  coupons[i] = bond.GetCoupon() / 2.0;
+
+  // walk back from maturity in six month steps to the coupon date on or before settlement
+  const date &maturity = bond.GetMaturityDate();
+  int payments = 0;
+  while (maturity - months(6 * (payments + 1)) > settlement) ++payments;
+  if (maturity > settlement) {
+    date next = maturity - months(6 * payments);
+    date previous = maturity - months(6 * (payments + 1));
+    firstPeriods[i] = static_cast<double>((next - settlement).days()) / (next - previous).days();
+    periodCounts[i] = payments + 1;
+  }
+  else {
+    firstPeriods[i] = 0;
+    periodCounts[i] = 0;
+  }
+  if (periodCounts[i] > maxPeriods) maxPeriods = periodCounts[i];
+}
+
+void PV01Engine::RebuildSchedules()
+{
+  maxPeriods = 0;
+  for (size_t i = 0; i < bonds.size(); ++i) BuildSchedule(i);
+  dirty = true;
+}
+
+void PV01Engine::Compute()
+{
+  size_t n = yields.size();
+  discounts.resize(n);
+  decays.resize(n);
+  weighted.resize(n);
+  Price(nullptr, prices.data(), unitPV01s.data(), discounts.data(), decays.data(), weighted.data());
+  dirty = false;
+}
+
+bool PV01Engine::IsStale() const
+{
+  return dirty;
+}
+
+void PV01Engine::Evaluate(const double *shifts, double *outPrices, double *outUnitPV01s, vector<double> &scratch) const
+{
+  size_t n = yields.size();
+  scratch.resize(3 * n);
+  Price(shifts, outPrices, outUnitPV01s, scratch.data(), scratch.data() + n, scratch.data() + 2 * n);
+}
+
+void PV01Engine::Price(const double *shifts, double *price, double *unitPV01, double *discount, double *decay, double *weight) const
+{
+  size_t n = yields.size();
+  for (size_t i = 0; i < n; ++i) {
+    double growth = 1.0 + (yields[i] + (shifts ? shifts[i] : 0.0)) / 2.0;
+    discount[i] = pow(growth, -firstPeriods[i]);
+    decay[i] = 1.0 / growth;
+    price[i] = 0;
+    weight[i] = 0;
+  }
+
+  const double *coupon = coupons.data(), *first = firstPeriods.data(), *count = periodCounts.data();
+
+  for (double k = 0; k < maxPeriods; ++k) {
+    // payment k of every bond: the coupon, plus the face on the last one, nothing once a bond has matured
+    for (size_t i = 0; i < n; ++i) {
+      double amount = (k < count[i] ? coupon[i] : 0.0) + (k + 1 == count[i] ? 1.0 : 0.0);
+      double pv = amount * discount[i];
+      price[i] += pv;
+      weight[i] += (first[i] + k) * pv;
+      discount[i] *= decay[i];
+    }
+  }
+
+  // -dP/dy = sum(periods * pv) / 2 / (1 + y/2), scaled to one basis point
+  for (size_t i = 0; i < n; ++i) unitPV01[i] = weight[i] * decay[i] / 2.0 * 1e-4;
+}
+
+double PV01Engine::GetMaturityYears(size_t i) const
+{
+  return (periodCounts[i] > 0 ? (firstPeriods[i] + periodCounts[i] - 1) / 2.0 : 0.0);
+}
+
+double PV01Engine::GetPrice(size_t i) const
+{
+  if (dirty) throw logic_error("PV01Engine::Compute must run after the yields or bonds change");
+  return prices[i];
+}
+
+double PV01Engine::GetUnitPV01(size_t i) const
+{
+  if (dirty) throw logic_error("PV01Engine::Compute must run after the yields or bonds change");
+  return unitPV01s[i];
+}
+
+double PV01Engine::GetUnitPV01(const string &productId) const
+{
+  size_t i = bonds.IndexOf(productId);
+  return (i == KeyedStore<string, const Bond*>::NOT_FOUND ? 0 : GetUnitPV01(i));
+}
+
+void PV01Engine::SetSettlementDate(const date &_settlement)
+{
+  settlement = _settlement;
+  RebuildSchedules();
+}
+
+#endif
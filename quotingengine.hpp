@@ -0,0 +1,250 @@
+/**
+ * quotingengine.hpp
+ * Two-way quotes for a curve of products, kept as parallel arrays indexed by product.
+ * Prices and positions are recorded as they arrive, and a pass then requotes the
+ * products which changed, or the whole curve, in one sweep over the arrays.
+ */
+#ifndef QUOTING_ENGINE_HPP
+#define QUOTING_ENGINE_HPP
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "keyedstore.hpp"
+#include "products.hpp"
+#include "priceformat.hpp"
+
+using namespace std;
+
+// How a quote's size is chosen from the tiers
+enum TierMode { ALTERNATE, BY_POSITION };
+
+/**
+ * Quoted size on each side: shown and hidden quantity.
+ * Under BY_POSITION a tier applies while the absolute position is at most positionLimit.
+ */
+struct QuoteTier
+{
+  long visible;
+  long hidden;
+  long positionLimit;
+};
+
+/**
+ * Quoting engine for a curve.
+ * A quote is centred on the mid less skew times the position, capped at maxSkew either
+ * way, so a long position lowers both sides. It is spread wide around that centre, with the
+ * bid rounded down and the offer up to whole ticks, so an odd spread quotes a tick wider.
+ * Its size comes from the tiers, either taken in turn on successive quotes of a product
+ * (ALTERNATE) or the first whose limit covers the product's position (BY_POSITION).
+ * Type T is the product type.
+ */
+template<typename T>
+class QuotingEngine
+{
+
+public:
+
+  // ctor for an engine alternating 1M and 2M shown, with twice that hidden, and no skew
+  QuotingEngine();
+
+  void SetTiers(const vector<QuoteTier> &_tiers, TierMode _mode);
+
+  // Move quotes by -skew per unit of position, by at most maxSkew
+  void SetSkew(double _skew, double _maxSkew);
+
+  // Get the index of a product, adding it on first sight
+  size_t Add(const T &product);
+
+  // Get the number of products
+  size_t Size() const;
+
+  // Record the latest mid and spread, or position, of a product; a price marks it for the next pass
+  void SetPrice(size_t i, FixedPrice mid, FixedPrice spread);
+  void SetPosition(size_t i, long position);
+
+  // Requote the products marked since the last pass, or every product, appending their indices to quoted
+  void Quote(vector<size_t> &quoted);
+  void QuoteAll(vector<size_t> &quoted);
+
+  // Get the latest quote of a product
+  const T& GetProduct(size_t i) const;
+  FixedPrice GetBid(size_t i) const;
+  FixedPrice GetOffer(size_t i) const;
+  long GetVisibleQuantity(size_t i) const;
+  long GetHiddenQuantity(size_t i) const;
+  long GetPosition(size_t i) const;
+
+private:
+
+  // Compute the quote of one product
+  void QuoteProduct(size_t i);
+
+  vector<QuoteTier> tiers;
+  TierMode mode;
+  double skew;
+  double maxSkew;
+
+  KeyedStore<const T*, bool> index;
+  vector<const T*> products;
+
+  // inputs
+  vector<FixedPrice> mids;
+  vector<FixedPrice> spreads;
+  vector<long> positions;
+  vector<uint32_t> quoteCounts;
+  vector<uint8_t> marked;
+  vector<size_t> markedList;
+
+  // outputs
+  vector<FixedPrice> bids;
+  vector<FixedPrice> offers;
+  vector<long> visibles;
+  vector<long> hiddens;
+
+};
+
+template<typename T>
+QuotingEngine<T>::QuotingEngine() :
+  tiers{ QuoteTier{ 1000000, 2000000, 0 }, QuoteTier{ 2000000, 4000000, 0 } }, mode(ALTERNATE), skew(0), maxSkew(0)
+{
+}
+
+template<typename T>
+void QuotingEngine<T>::SetTiers(const vector<QuoteTier> &_tiers, TierMode _mode)
+{
+  if (_tiers.empty()) return;
+  tiers = _tiers;
+  mode = _mode;
+}
+
+template<typename T>
+void QuotingEngine<T>::SetSkew(double _skew, double _maxSkew)
+{
+  skew = _skew;
+  maxSkew = _maxSkew;
+}
+
+template<typename T>
+size_t QuotingEngine<T>::Add(const T &product)
+{
+  const T *registered = &ProductRegistry<T>::instance()->Intern(product);
+  size_t i = index.Assign(registered);
+  if (i == products.size()) {
+    products.push_back(registered);
+    mids.push_back(FixedPrice());
+    spreads.push_back(FixedPrice());
+    positions.push_back(0);
+    quoteCounts.push_back(0);
+    marked.push_back(0);
+    bids.push_back(FixedPrice());
+    offers.push_back(FixedPrice());
+    visibles.push_back(0);
+    hiddens.push_back(0);
+  }
+  return i;
+}
+
+template<typename T>
+size_t QuotingEngine<T>::Size() const
+{
+  return products.size();
+}
+
+template<typename T>
+void QuotingEngine<T>::SetPrice(size_t i, FixedPrice mid, FixedPrice spread)
+{
+  mids[i] = mid;
+  spreads[i] = spread;
+  if (!marked[i]) {
+    marked[i] = 1;
+    markedList.push_back(i);
+  }
+}
+
+template<typename T>
+void QuotingEngine<T>::SetPosition(size_t i, long position)
+{
+  positions[i] = position;
+}
+
+template<typename T>
+void QuotingEngine<T>::QuoteProduct(size_t i)
+{
+  double shift = max(-maxSkew, min(maxSkew, -skew * positions[i]));
+  double centre = mids[i].ToDouble() + shift, half = spreads[i].ToDouble() / 2;
+  bids[i] = FixedPrice::Floor(centre - half);
+  offers[i] = FixedPrice::Ceil(centre + half);
+
+  size_t tier = 0;
+  if (mode == ALTERNATE) {
+    tier = quoteCounts[i] % tiers.size();
+  }
+  else {
+    long exposure = (positions[i] < 0 ? -positions[i] : positions[i]);
+    while (tier + 1 < tiers.size() && exposure > tiers[tier].positionLimit) ++tier;
+  }
+  ++quoteCounts[i];
+  visibles[i] = tiers[tier].visible;
+  hiddens[i] = tiers[tier].hidden;
+}
+
+template<typename T>
+void QuotingEngine<T>::Quote(vector<size_t> &quoted)
+{
+  for (size_t i : markedList) {
+    QuoteProduct(i);
+    marked[i] = 0;
+    quoted.push_back(i);
+  }
+  markedList.clear();
+}
+
+template<typename T>
+void QuotingEngine<T>::QuoteAll(vector<size_t> &quoted)
+{
+  for (size_t i = 0; i < products.size(); ++i) {
+    QuoteProduct(i);
+    marked[i] = 0;
+    quoted.push_back(i);
+  }
+  markedList.clear();
+}
+
+template<typename T>
+const T& QuotingEngine<T>::GetProduct(size_t i) const
+{
+  return *products[i];
+}
+
+template<typename T>
+FixedPrice QuotingEngine<T>::GetBid(size_t i) const
+{
+  return bids[i];
+}
+
+template<typename T>
+FixedPrice QuotingEngine<T>::GetOffer(size_t i) const
+{
+  return offers[i];
+}
+
+template<typename T>
+long QuotingEngine<T>::GetVisibleQuantity(size_t i) const
+{
+  return visibles[i];
+}
+
+template<typename T>
+long QuotingEngine<T>::GetHiddenQuantity(size_t i) const
+{
+  return hiddens[i];
+}
+
+template<typename T>
+long QuotingEngine<T>::GetPosition(size_t i) const
+{
+  return positions[i];
+}
+
+#endif
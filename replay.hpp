@@ -0,0 +1,145 @@
+/**
+ * replay.hpp
+ * Replays a journal of recorded connector inputs (order books, deltas, prices, trades
+ * and inquiries) through the services' OnMessage paths, in recorded order, either as
+ * fast as possible or paced by the recorded timestamps at a chosen speed.
+ */
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include <string>
+#include <chrono>
+#include <thread>
+#include "journal.hpp"
+#include "marketdataservice.hpp"
+#include "pricingservice.hpp"
+#include "tradebookingservice.hpp"
+#include "inquiryservice.hpp"
+
+using namespace std;
+
+/**
+ * Drives the listener graph from a journal written through JournalServiceListener recorders.
+ * Historical records in the journal are skipped.
+ */
+class ReplayEngine
+{
+
+public:
+
+  // ctor for an engine replaying at speed times the recorded pace; 0 replays as fast as possible
+  ReplayEngine(double _speed = 0);
+
+  // Replay a journal and return the number of inputs replayed
+  size_t Replay(const string &path);
+
+  // Get the number of inputs and the wall-clock seconds taken by the last replay
+  size_t GetRecords() const;
+  double GetSeconds() const;
+
+private:
+
+  struct Dispatcher;
+
+  double speed;
+  size_t records;
+  double seconds;
+
+};
+
+/**
+ * Visitor which waits for each input's due time and hands it to its service.
+ */
+struct ReplayEngine::Dispatcher : public JournalVisitor
+{
+
+  using JournalVisitor::OnRecord;
+
+  double speed;
+  bool started;
+  int64_t firstTimestamp;
+  chrono::steady_clock::time_point start;
+  size_t records;
+
+  // Sleep until the input is due at the replay speed
+  void Pace(int64_t timestamp)
+  {
+    ++records;
+    if (!started) {
+      started = true;
+      firstTimestamp = timestamp;
+      start = chrono::steady_clock::now();
+    }
+    if (speed <= 0) return;
+    auto due = chrono::nanoseconds(static_cast<int64_t>((timestamp - firstTimestamp) / speed));
+    this_thread::sleep_until(start + due);
+  }
+
+  void OnRecord(const OrderBook<Bond> &data, int64_t timestamp)
+  {
+    Pace(timestamp);
+    OrderBook<Bond> book(data);
+    BondMarketDataService::instance()->OnMessage(book);
+  }
+
+  void OnRecord(const OrderBookDelta &data, int64_t timestamp)
+  {
+    Pace(timestamp);
+    BondMarketDataService::instance()->OnDelta(data);
+  }
+
+  void OnRecord(const Price<Bond> &data, int64_t timestamp)
+  {
+    Pace(timestamp);
+    Price<Bond> price(data);
+    BondPricingService::instance()->OnMessage(price);
+  }
+
+  void OnRecord(const Trade<Bond> &data, int64_t timestamp)
+  {
+    Pace(timestamp);
+    Trade<Bond> trade(data);
+    BondTradeBookingService::instance()->OnMessage(trade);
+  }
+
+  void OnRecord(const Inquiry<Bond> &data, int64_t timestamp)
+  {
+    Pace(timestamp);
+    Inquiry<Bond> inquiry(data);
+    BondInquiryService::instance()->OnMessage(inquiry);
+  }
+
+};
+
+ReplayEngine::ReplayEngine(double _speed) :
+  speed(_speed), records(0), seconds(0)
+{
+}
+
+size_t ReplayEngine::Replay(const string &path)
+{
+  JournalReader reader(path);
+  Dispatcher dispatcher;
+  dispatcher.speed = speed;
+  dispatcher.started = false;
+  dispatcher.firstTimestamp = 0;
+  dispatcher.records = 0;
+
+  auto start = chrono::steady_clock::now();
+  reader.ForEachRecord(dispatcher);
+  seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  records = dispatcher.records;
+  return records;
+}
+
+size_t ReplayEngine::GetRecords() const
+{
+  return records;
+}
+
+double ReplayEngine::GetSeconds() const
+{
+  return seconds;
+}
+
+#endif
@@ -1,296 +1,488 @@
-/**
- * riskservice.hpp
- * Defines the data types and Service for fixed income risk.
- *
- * @author Breman Thuraisingham
- */
-#ifndef RISK_SERVICE_HPP
-#define RISK_SERVICE_HPP
-
-#include "soa.hpp"
-#include "positionservice.hpp"
-
-/**
- * PV01 risk.
- * Type T is the product type.
- */
-template<typename T>
-class PV01
-{
-
-public:
-
-  // ctor for a PV01 value
-	PV01() {};
-	PV01(const T &_product, double _pv01, long _quantity);
-
-  // Get the product on this PV01 value
-	const T& GetProduct() const;
-
-  // Get the PV01 value
-	double GetPV01() const;
-
-  // Get the quantity that this risk value is associated with
-	long GetQuantity() const;
-
-	void AddQuantity(long q) {
-		
-		quantity += q;
-
-	}
-
-private:
-	T product;
-	double pv01;
-	long quantity;
-
-};
-
-/**
- * A bucket sector to bucket a group of securities.
- * We can then aggregate bucketed risk to this bucket.
- * Type T is the product type.
- */
-template<typename T>
-class BucketedSector
-{
-
-public:
-
-  // ctor for a bucket sector
-  BucketedSector(const vector<T> &_products, string _name);
-
-  // Get the products associated with this bucket
-  const vector<T>& GetProducts() const;
-
-  // Get the name of the bucket
-  const string& GetName() const;
-
-private:
-  vector<T> products;
-  string name;
-
-};
-
-/**
- * Risk Service to vend out risk for a particular security and across a risk bucketed sector.
- * Keyed on product identifier.
- * Type T is the product type.
- */
-
-template<typename T>
-class RiskService : public Service<string, PV01 <T> >
-{
-
-public:
-
-	// Add a position that the service will risk
-	virtual void AddPosition(Position<T> &position) = 0;
-
-	// Get the bucketed risk for the bucket sector
-	virtual PV01<BucketedSector<T>> GetBucketedRisk(const BucketedSector<T> &sector) = 0;
-
-};
-
-
-class BondRiskService : public RiskService<Bond>
-{
-
-public:
-
-	static BondRiskService* instance() {
-
-		static BondRiskService inst;
-
-		return &inst;
-
-	}
-
-	void AddBusketedSector(BucketedSector<Bond> &sector) {
-
-		sectorData.push_back(sector);
-
-	}
-
-	void AddPosition(Position<Bond> &position) {
-
-		std::cout << "The risk service is taking position of " << position.GetProduct().GetProductId() << " from position service." << std::endl;
-
-		Bond thisBond = position.GetProduct();
-
-		string product_ID = thisBond.GetProductId();
-
-		long quantity = position.GetAggregatePosition();
-
-		riskData[product_ID].AddQuantity(quantity);
-		
-		PV01<Bond> pb = riskData[product_ID];
-
-		std::cout << "The risk of the product is " << pb.GetPV01() << ".\n" << std::endl;
-
-		OnMessage(pb);
-
-		/*for (auto iter = sectorData.begin(); iter != sectorData.end(); iter++) {
-
-			BucketedSector<Bond> sector = *iter;
-
-			vector<Bond> products = sector.GetProducts();
-
-			if (std::find(products.begin(), products.end(), thisBond) != products.end()) {
-
-				PV01< BucketedSector<Bond> > pb = GetBucketedRisk(sector);
-
-				OnMessage(pb);
-			}
-
-		}*/
-
-	}
-
-	PV01< BucketedSector<Bond> > GetBucketedRisk(const BucketedSector<Bond> &sector) {
-		
-		double sectorPV01 = 0;
-
-		for (auto&b : sector.GetProducts()) sectorPV01 += riskData.at(b.GetProductId()).GetPV01();
-
-		PV01< BucketedSector<Bond> > result = PV01< BucketedSector<Bond> >(sector, sectorPV01, 1);
-
-		return result;
-	}
-
-	PV01<Bond>& GetData(std::string _cusip) {
-
-		return riskData.at(_cusip);
-
-	}
-
-
-	void AddListener(ServiceListener<PV01<Bond>> *listener) {
-
-		risklisteners.push_back(listener);
-
-	}
-
-
-	const vector< ServiceListener<PV01<Bond>>* >& GetListeners() const {
-
-		return risklisteners;
-
-	}
-
-
-	void OnMessage(PV01<Bond> &trade) {
-
-		for (auto& listener : risklisteners) 	listener->ProcessAdd(trade);
-	
-	}
-
-	void Add(PV01<Bond> &risk) {
-
-		riskData.insert(std::make_pair(risk.GetProduct().GetProductId(), risk));
-
-	}
-
-private:
-
-	std::map<std::string, PV01<Bond>> riskData;
-
-	vector<BucketedSector<Bond>> sectorData;
-
-	std::vector<ServiceListener<PV01<Bond>>*>  risklisteners;
-
-	BondRiskService() {}
-
-};
-
-class BondRiskServiceListener : public ServiceListener<Position<Bond>> {
-
-public:
-
-
-	static BondRiskServiceListener* instance() {
-
-		static BondRiskServiceListener inst;
-
-		return &inst;
-
-	}
-
-
-	void ProcessAdd(Position<Bond> &data) {
-
-		bondRiskService->AddPosition(data);
-
-	}
-
-
-
-	void ProcessRemove(Position<Bond> &data) {}
-
-	void ProcessUpdate(Position<Bond> &data) {}
-
-
-
-	BondRiskService* GetService() {
-
-		return bondRiskService;
-
-	}
-
-private:
-
-	BondRiskService* bondRiskService;
-
-	BondRiskServiceListener() { bondRiskService = BondRiskService::instance(); }
-
-};
-
-
-template<typename T>
-PV01<T>::PV01(const T &_product, double _pv01, long _quantity) :
-  product(_product)
-{
-  pv01 = _pv01;
-  quantity = _quantity;
-}
-
-template<typename T>
-const T& PV01<T>::GetProduct() const
-{
-	return product;
-}
-
-template<typename T>
-long PV01<T>::GetQuantity() const
-{
-	return quantity;
-}
-
-
-template<typename T>
-double PV01<T>::GetPV01() const
-{
-	return pv01;
-}
-
-
-template<typename T>
-BucketedSector<T>::BucketedSector(const vector<T>& _products, string _name) :
-  products(_products)
-{
-  name = _name;
-}
-
-template<typename T>
-const vector<T>& BucketedSector<T>::GetProducts() const
-{
-  return products;
-}
-
-template<typename T>
-const string& BucketedSector<T>::GetName() const
-{
-  return name;
-}
-
-#endif
+/**
+ * riskservice.hpp
+ * Defines the data types and Service for fixed income risk.
+ *
+ * @author Breman Thuraisingham
+ */
+#ifndef RISK_SERVICE_HPP
+#define RISK_SERVICE_HPP
+
+#include "soa.hpp"
+#include "keyedstore.hpp"
+#include "positionservice.hpp"
+#include "pv01engine.hpp"
+#include "scenarioengine.hpp"
+
+/**
+ * PV01 risk.
+ * Type T is the product type.
+ */
+template<typename T>
+class PV01
+{
+
+public:
+
+  // ctor for a PV01 value
+	PV01() : product(&ProductRegistry<T>::instance()->GetDefault()), pv01(0), quantity(0) {};
+	PV01(const T &_product, double _pv01, long _quantity);
+
+  // Get the product on this PV01 value
+	const T& GetProduct() const;
+
+  // Get the PV01 value
+	double GetPV01() const;
+
+  // Get the quantity that this risk value is associated with
+	long GetQuantity() const;
+
+	void AddQuantity(long q) {
+		
+		quantity += q;
+
+	}
+
+private:
+	const T *product;
+	double pv01;
+	long quantity;
+
+};
+
+/**
+ * A bucket sector to bucket a group of securities.
+ * We can then aggregate bucketed risk to this bucket.
+ * Type T is the product type.
+ */
+template<typename T>
+class BucketedSector
+{
+
+public:
+
+  // ctor for a bucket sector
+  BucketedSector() {};
+  BucketedSector(const vector<T> &_products, string _name);
+
+  // Get the products associated with this bucket
+  const vector<T>& GetProducts() const;
+
+  // Get the name of the bucket
+  const string& GetName() const;
+
+  // Get the name of the bucket, which identifies it in the ProductRegistry
+  const string& GetProductId() const;
+
+private:
+  vector<T> products;
+  string name;
+
+};
+
+/**
+ * Risk Service to vend out risk for a particular security and across a risk bucketed sector.
+ * Keyed on product identifier.
+ * Type T is the product type.
+ */
+
+template<typename T>
+class RiskService : public Service<string, PV01 <T> >
+{
+
+public:
+
+	// Add a position that the service will risk
+	virtual void AddPosition(Position<T> &position) = 0;
+
+	// Get the bucketed risk for the bucket sector
+	virtual PV01<BucketedSector<T>> GetBucketedRisk(const BucketedSector<T> &sector) = 0;
+
+};
+
+
+class BondRiskService : public RiskService<Bond>
+{
+
+public:
+
+	static BondRiskService* instance() {
+
+		static BondRiskService inst;
+
+		return &inst;
+
+	}
+
+	// Add a sector, whose risk is kept up to date from then on; a name already added keeps its products
+
+	void AddBusketedSector(BucketedSector<Bond> &sector) {
+
+		if (sectorData.count(sector.GetName())) return;
+
+		size_t s = sectorData.Assign(sector.GetName());
+
+		sectorPV01s.push_back(0);
+
+		sectorData.AtIndex(s) = sector;
+
+		for (auto& b : sector.GetProducts()) {
+
+			productSectors[b.GetProductId()].push_back(s);
+
+			auto risk = riskData.find(b.GetProductId());
+
+			if (risk != riskData.end()) sectorPV01s[s] += risk->second.GetPV01();
+
+		}
+
+	}
+
+	// Add a bond to risk at a yield, starting with no position; the engine is computed once, on the next read
+
+	void AddBond(const Bond &bond, double yield) {
+
+		riskEngine.AddBond(bond, yield);
+
+		PV01<Bond> risk(bond, 0, 0);
+
+		Add(risk);
+
+	}
+
+	// Set the date cash flows are valued from
+
+	void SetSettlementDate(const date &settlement) {
+
+		riskEngine.SetSettlementDate(settlement);
+
+	}
+
+	// Move every yield by shift and re-risk every held position
+
+	void ShiftYields(double shift) {
+
+		riskEngine.ShiftYields(shift);
+
+		const PV01Engine& engine = ComputedEngine();
+
+		for (auto& risk : riskData) risk.second = PV01<Bond>(risk.second.GetProduct(), engine.GetUnitPV01(risk.first) * risk.second.GetQuantity(), risk.second.GetQuantity());
+
+		// every bond moved, so each sector is summed again and published once
+
+		for (size_t s = 0; s < sectorData.size(); ++s) {
+
+			sectorPV01s[s] = 0;
+
+			for (auto& b : sectorData.AtIndex(s).GetProducts()) {
+
+				auto risk = riskData.find(b.GetProductId());
+
+				if (risk != riskData.end()) sectorPV01s[s] += risk->second.GetPV01();
+
+			}
+
+
+			PublishSector(s);
+
+		}
+
+	}
+
+	// Evaluate a batch of curve shocks against every position on a bond the engine prices, spread over threads
+	// (0 for one per core); sector bumps name the sectors added with AddBusketedSector
+
+	ScenarioResults RunScenarios(const vector<CurveShock> &shocks, unsigned threads = 0) {
+
+		ScenarioEngine scenarios(ComputedEngine(), threads);
+
+		for (size_t s = 0; s < sectorData.size(); ++s) {
+
+			vector<size_t> bondIndices;
+
+			for (auto& b : sectorData.AtIndex(s).GetProducts()) {
+
+				size_t i = riskEngine.IndexOf(b.GetProductId());
+
+				if (i != KeyedStore<std::string, const Bond*>::NOT_FOUND) bondIndices.push_back(i);
+
+			}
+
+			scenarios.AddSector(sectorData.KeyAt(s), bondIndices);
+
+		}
+
+		for (auto& risk : riskData) {
+
+			size_t i = riskEngine.IndexOf(risk.first);
+
+			if (i != KeyedStore<std::string, const Bond*>::NOT_FOUND) scenarios.AddPosition(risk.first, i, risk.second.GetQuantity());
+
+		}
+
+		return scenarios.Run(shocks);
+
+	}
+
+	// Get the engine, computed for the current bonds and yields
+
+	PV01Engine& GetEngine() {
+
+		return ComputedEngine();
+
+	}
+
+	void AddPosition(Position<Bond> &position) {
+
+		std::cout << "The risk service is taking position of " << position.GetProduct().GetProductId() << " from position service." << std::endl;
+
+		const Bond& thisBond = position.GetProduct();
+
+		string product_ID = thisBond.GetProductId();
+
+		// the position carries the aggregate across books, which replaces the quantity risked so far
+
+		long quantity = position.GetAggregatePosition();
+
+		PV01<Bond>& risk = riskData[product_ID];
+
+		double previousPV01 = risk.GetPV01();
+
+		risk = PV01<Bond>(thisBond, ComputedEngine().GetUnitPV01(product_ID) * quantity, quantity);
+		
+		PV01<Bond> pb = risk;
+
+		std::cout << "The risk of the product is " << pb.GetPV01() << ".\n" << std::endl;
+
+		OnMessage(pb);
+
+		// only the sectors holding this bond move, by the change in its risk
+
+		auto sectors = productSectors.find(product_ID);
+
+		if (sectors != productSectors.end()) {
+
+			for (size_t s : sectors->second) {
+
+				sectorPV01s[s] += pb.GetPV01() - previousPV01;
+
+				PublishSector(s);
+
+			}
+
+		}
+
+	}
+
+	// Risk every position of a snapshot, such as one from a ShardedPositionService
+
+	void AddPositions(vector<Position<Bond>> &positions) {
+
+		for (auto& position : positions) AddPosition(position);
+
+	}
+
+	// Get the risk of a sector; a sector that was added is read from its running total, any other is summed
+
+	PV01< BucketedSector<Bond> > GetBucketedRisk(const BucketedSector<Bond> &sector) {
+
+		size_t s = sectorData.IndexOf(sector.GetName());
+
+		if (s != KeyedStore<std::string, BucketedSector<Bond>>::NOT_FOUND) return PV01< BucketedSector<Bond> >(sectorData.AtIndex(s), sectorPV01s[s], 1);
+		
+		double sectorPV01 = 0;
+
+		for (auto&b : sector.GetProducts()) sectorPV01 += riskData.at(b.GetProductId()).GetPV01();
+
+		PV01< BucketedSector<Bond> > result = PV01< BucketedSector<Bond> >(sector, sectorPV01, 1);
+
+		return result;
+	}
+
+	PV01<Bond>& GetData(std::string _cusip) {
+
+		return riskData.at(_cusip);
+
+	}
+
+
+	void AddListener(ServiceListener<PV01<Bond>> *listener) {
+
+		risklisteners.push_back(listener);
+
+	}
+
+
+	const vector< ServiceListener<PV01<Bond>>* >& GetListeners() const {
+
+		return risklisteners;
+
+	}
+
+
+	// Listeners to sector risk, called with a sector's new total whenever it changes
+
+	void AddSectorListener(ServiceListener<PV01<BucketedSector<Bond>>> *listener) {
+
+		sectorListeners.push_back(listener);
+
+	}
+
+
+	const vector< ServiceListener<PV01<BucketedSector<Bond>>>* >& GetSectorListeners() const {
+
+		return sectorListeners;
+
+	}
+
+
+	void OnMessage(PV01<Bond> &trade) {
+
+		for (auto& listener : risklisteners) 	listener->ProcessAdd(trade);
+	
+	}
+
+	void Add(PV01<Bond> &risk) {
+
+		riskData.insert(std::make_pair(risk.GetProduct().GetProductId(), risk));
+
+	}
+
+private:
+
+	KeyedStore<std::string, PV01<Bond>> riskData;
+
+	// Get the engine, computing it first if bonds, yields or the settlement date changed since it was last computed
+
+	PV01Engine& ComputedEngine() {
+
+		if (riskEngine.IsStale()) riskEngine.Compute();
+
+		return riskEngine;
+
+	}
+
+	void PublishSector(size_t s) {
+
+		if (sectorListeners.empty()) return;
+
+		PV01< BucketedSector<Bond> > risk(sectorData.AtIndex(s), sectorPV01s[s], 1);
+
+		for (auto& listener : sectorListeners) listener->ProcessAdd(risk);
+
+	}
+
+	KeyedStore<std::string, BucketedSector<Bond>> sectorData;
+
+	// running PV01 per sector, by sector index, and the sectors each CUSIP belongs to
+
+	vector<double> sectorPV01s;
+
+	KeyedStore<std::string, vector<size_t>> productSectors;
+
+	std::vector<ServiceListener<PV01<BucketedSector<Bond>>>*> sectorListeners;
+
+	std::vector<ServiceListener<PV01<Bond>>*>  risklisteners;
+
+	PV01Engine riskEngine;
+
+	BondRiskService() {}
+
+};
+
+class BondRiskServiceListener : public ServiceListener<Position<Bond>> {
+
+public:
+
+
+	static BondRiskServiceListener* instance() {
+
+		static BondRiskServiceListener inst;
+
+		return &inst;
+
+	}
+
+
+	void ProcessAdd(Position<Bond> &data) {
+
+		bondRiskService->AddPosition(data);
+
+	}
+
+
+
+	void ProcessRemove(Position<Bond> &data) {}
+
+	void ProcessUpdate(Position<Bond> &data) {}
+
+
+
+	BondRiskService* GetService() {
+
+		return bondRiskService;
+
+	}
+
+private:
+
+	BondRiskService* bondRiskService;
+
+	BondRiskServiceListener() { bondRiskService = BondRiskService::instance(); }
+
+};
+
+
+template<typename T>
+PV01<T>::PV01(const T &_product, double _pv01, long _quantity) :
+  product(&ProductRegistry<T>::instance()->Intern(_product))
+{
+  pv01 = _pv01;
+  quantity = _quantity;
+}
+
+template<typename T>
+const T& PV01<T>::GetProduct() const
+{
+	return *product;
+}
+
+template<typename T>
+long PV01<T>::GetQuantity() const
+{
+	return quantity;
+}
+
+
+template<typename T>
+double PV01<T>::GetPV01() const
+{
+	return pv01;
+}
+
+
+template<typename T>
+BucketedSector<T>::BucketedSector(const vector<T>& _products, string _name) :
+  products(_products)
+{
+  name = _name;
+}
+
+template<typename T>
+const vector<T>& BucketedSector<T>::GetProducts() const
+{
+  return products;
+}
+
+template<typename T>
+const string& BucketedSector<T>::GetName() const
+{
+  return name;
+}
+
+template<typename T>
+const string& BucketedSector<T>::GetProductId() const
+{
+  return name;
+}
+
+#endif
@@ -0,0 +1,282 @@
+/**
+ * scenarioengine.hpp
+ * Batch evaluation of yield-curve shocks over a book of bond positions.
+ * Every scenario reprices the whole universe through PV01Engine::Evaluate in one
+ * vectorized pass, and scenarios are shared out across worker threads, each with
+ * its own scratch, so the engine is only ever read.
+ */
+#ifndef SCENARIO_ENGINE_HPP
+#define SCENARIO_ENGINE_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
+#include "pv01engine.hpp"
+
+using namespace std;
+
+/**
+ * A shock to the yield curve, as yield changes in decimal (0.0001 is one basis point).
+ * A bond's yield moves by the parallel shift, plus the twist times its years to
+ * maturity beyond the pivot, plus the key-rate bump of every sector holding it.
+ */
+class CurveShock
+{
+
+public:
+
+  // ctor for a shock
+  CurveShock(const string &_name, double _parallel = 0, double _twist = 0, double _pivotYears = 10);
+
+  // Bump the yields of the bonds in a sector by bump
+  void AddSectorBump(const string &sector, double bump);
+
+  const string& GetName() const;
+  double GetParallel() const;
+  double GetTwist() const;
+  double GetPivotYears() const;
+  const map<string, double>& GetSectorBumps() const;
+
+private:
+  string name;
+  double parallel;
+  double twist;
+  double pivotYears;
+  map<string, double> sectorBumps;
+
+};
+
+/**
+ * P&L against the current yields and PV01 of every position under every scenario.
+ * Values are held scenario by scenario, positions in the order they were added.
+ */
+class ScenarioResults
+{
+
+public:
+
+  // ctor for results of scenarios over positions
+  ScenarioResults(size_t _scenarios, const vector<string> &_productIds);
+
+  size_t GetScenarioCount() const;
+  size_t GetPositionCount() const;
+
+  // Get the product of a position
+  const string& GetProductId(size_t position) const;
+
+  // Get the P&L or PV01 of one position, or of the whole book, under a scenario
+  double GetPnL(size_t scenario, size_t position) const;
+  double GetPV01(size_t scenario, size_t position) const;
+  double GetTotalPnL(size_t scenario) const;
+  double GetTotalPV01(size_t scenario) const;
+
+private:
+
+  friend class ScenarioEngine;
+
+  size_t scenarios;
+  vector<string> productIds;
+  vector<double> pnls;
+  vector<double> pv01s;
+  vector<double> totalPnLs;
+  vector<double> totalPV01s;
+
+};
+
+/**
+ * Evaluates batches of CurveShocks for positions on bonds of a PV01Engine.
+ * The engine must have been computed and must not change while Run is going.
+ */
+class ScenarioEngine
+{
+
+public:
+
+  // ctor for scenarios over an engine's bonds, on threads workers (0 for one per core)
+  ScenarioEngine(const PV01Engine &_engine, unsigned _threads = 0);
+
+  // Name a sector by the engine indices of its bonds, for key-rate bumps
+  void AddSector(const string &name, const vector<size_t> &bondIndices);
+
+  // Add a position of quantity face value in the bond at an engine index
+  void AddPosition(const string &productId, size_t bondIndex, long quantity);
+
+  // Evaluate every shock against every position
+  ScenarioResults Run(const vector<CurveShock> &shocks) const;
+
+private:
+
+  // Evaluate scenarios taken from next until none are left
+  void Work(const vector<CurveShock> &shocks, const vector<double> &basePrices, const vector<double> &maturities,
+    atomic<size_t> &next, ScenarioResults &results) const;
+
+  const PV01Engine &engine;
+  unsigned threads;
+  map<string, vector<size_t> > sectors;
+  vector<size_t> positionBonds;
+  vector<double> positionQuantities;
+  vector<string> positionIds;
+
+};
+
+CurveShock::CurveShock(const string &_name, double _parallel, double _twist, double _pivotYears) :
+  name(_name), parallel(_parallel), twist(_twist), pivotYears(_pivotYears)
+{
+}
+
+void CurveShock::AddSectorBump(const string &sector, double bump)
+{
+  sectorBumps[sector] += bump;
+}
+
+const string& CurveShock::GetName() const
+{
+  return name;
+}
+
+double CurveShock::GetParallel() const
+{
+  return parallel;
+}
+
+double CurveShock::GetTwist() const
+{
+  return twist;
+}
+
+double CurveShock::GetPivotYears() const
+{
+  return pivotYears;
+}
+
+const map<string, double>& CurveShock::GetSectorBumps() const
+{
+  return sectorBumps;
+}
+
+ScenarioResults::ScenarioResults(size_t _scenarios, const vector<string> &_productIds) :
+  scenarios(_scenarios), productIds(_productIds),
+  pnls(_scenarios * _productIds.size()), pv01s(_scenarios * _productIds.size()),
+  totalPnLs(_scenarios), totalPV01s(_scenarios)
+{
+}
+
+size_t ScenarioResults::GetScenarioCount() const
+{
+  return scenarios;
+}
+
+size_t ScenarioResults::GetPositionCount() const
+{
+  return productIds.size();
+}
+
+const string& ScenarioResults::GetProductId(size_t position) const
+{
+  return productIds[position];
+}
+
+double ScenarioResults::GetPnL(size_t scenario, size_t position) const
+{
+  return pnls[scenario * productIds.size() + position];
+}
+
+double ScenarioResults::GetPV01(size_t scenario, size_t position) const
+{
+  return pv01s[scenario * productIds.size() + position];
+}
+
+double ScenarioResults::GetTotalPnL(size_t scenario) const
+{
+  return totalPnLs[scenario];
+}
+
+double ScenarioResults::GetTotalPV01(size_t scenario) const
+{
+  return totalPV01s[scenario];
+}
+
+ScenarioEngine::ScenarioEngine(const PV01Engine &_engine, unsigned _threads) :
+  engine(_engine), threads(_threads)
+{
+  if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+}
+
+void ScenarioEngine::AddSector(const string &name, const vector<size_t> &bondIndices)
+{
+  sectors[name] = bondIndices;
+}
+
+void ScenarioEngine::AddPosition(const string &productId, size_t bondIndex, long quantity)
+{
+  positionIds.push_back(productId);
+  positionBonds.push_back(bondIndex);
+  positionQuantities.push_back(static_cast<double>(quantity));
+}
+
+ScenarioResults ScenarioEngine::Run(const vector<CurveShock> &shocks) const
+{
+  for (auto &shock : shocks) {
+    for (auto &bump : shock.GetSectorBumps()) {
+      if (!sectors.count(bump.first)) throw invalid_argument("ScenarioEngine::Run: unknown sector " + bump.first + " in " + shock.GetName());
+    }
+  }
+
+  // the base case is the engine as last computed; GetPrice throws here, not on a worker, if it is stale
+  size_t n = engine.Size();
+  vector<double> basePrices(n), maturities(n);
+  for (size_t i = 0; i < n; ++i) {
+    basePrices[i] = engine.GetPrice(i);
+    maturities[i] = engine.GetMaturityYears(i);
+  }
+
+  ScenarioResults results(shocks.size(), positionIds);
+  atomic<size_t> next(0);
+  size_t workers = min<size_t>(threads, shocks.size());
+
+  if (workers <= 1) {
+    Work(shocks, basePrices, maturities, next, results);
+    return results;
+  }
+
+  vector<thread> pool;
+  for (size_t w = 0; w < workers; ++w) pool.push_back(thread(&ScenarioEngine::Work, this, cref(shocks), cref(basePrices), cref(maturities), ref(next), ref(results)));
+  for (auto &worker : pool) worker.join();
+  return results;
+}
+
+void ScenarioEngine::Work(const vector<CurveShock> &shocks, const vector<double> &basePrices, const vector<double> &maturities,
+  atomic<size_t> &next, ScenarioResults &results) const
+{
+  size_t n = engine.Size(), positions = positionBonds.size();
+
+  vector<double> shifts(n), prices(n), unitPV01s(n), scratch;
+
+  for (size_t s = next++; s < shocks.size(); s = next++) {
+    const CurveShock &shock = shocks[s];
+    for (size_t i = 0; i < n; ++i) shifts[i] = shock.GetParallel() + shock.GetTwist() * (maturities[i] - shock.GetPivotYears());
+    for (auto &bump : shock.GetSectorBumps()) {
+      for (size_t i : sectors.at(bump.first)) shifts[i] += bump.second;
+    }
+
+    engine.Evaluate(shifts.data(), prices.data(), unitPV01s.data(), scratch);
+
+    // rows of different scenarios do not overlap, so workers write without locking
+    double *pnl = results.pnls.data() + s * positions, *pv01 = results.pv01s.data() + s * positions;
+    double totalPnL = 0, totalPV01 = 0;
+    for (size_t j = 0; j < positions; ++j) {
+      size_t i = positionBonds[j];
+      pnl[j] = (prices[i] - basePrices[i]) * positionQuantities[j];
+      pv01[j] = unitPV01s[i] * positionQuantities[j];
+      totalPnL += pnl[j];
+      totalPV01 += pv01[j];
+    }
+    results.totalPnLs[s] = totalPnL;
+    results.totalPV01s[s] = totalPV01;
+  }
+}
+
+#endif
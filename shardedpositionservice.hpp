@@ -0,0 +1,234 @@
+/**
+ * shardedpositionservice.hpp
+ * Position keeping spread over worker shards.
+ * Trades are routed by product to one of N shards, each a thread owning the
+ * positions of its products outright, so no position is ever shared or locked.
+ * A snapshot of every shard is taken at a single point in the trade stream.
+ */
+#ifndef SHARDED_POSITION_SERVICE_HPP
+#define SHARDED_POSITION_SERVICE_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <boost/align/aligned_alloc.hpp>
+#include "soa.hpp"
+#include "keyedstore.hpp"
+#include "asynclistener.hpp"
+#include "positionservice.hpp"
+
+using namespace std;
+
+/**
+ * Position keeping on shard threads, fed from one booking thread.
+ * Trades and snapshot requests enter each shard through an SpscQueue, so
+ * AddTrade and Snapshot must be called from the same thread; a full queue
+ * makes that thread wait. A product always maps to the same shard, so its
+ * trades are applied in booking order.
+ * Register it on a trade booking service in place of the position service listener.
+ * Type T is the product type.
+ */
+template<typename T>
+class ShardedPositionService : public ServiceListener<Trade<T> >
+{
+
+public:
+
+  // ctor starts one thread per shard, each with a queue of capacity commands
+  ShardedPositionService(size_t _shards, size_t capacity = 4096);
+
+  // dtor applies everything queued and joins the shard threads
+  ~ShardedPositionService();
+
+  // Route a trade to the shard owning its product
+  void AddTrade(const Trade<T> &trade);
+
+  // Get every position as of all trades added so far, ordered by product identifier
+  vector<Position<T> > Snapshot();
+
+  // Get the number of shards
+  size_t GetShardCount() const;
+
+  // Listener callbacks; an added trade is routed as by AddTrade
+  void ProcessAdd(Trade<T> &data);
+  void ProcessRemove(Trade<T> &data);
+  void ProcessUpdate(Trade<T> &data);
+
+private:
+
+  // A snapshot in progress: each shard fills its part and counts down
+  struct SnapshotRequest
+  {
+    vector<vector<Position<T> > > parts;
+    atomic<size_t> remaining;
+  };
+
+  // A trade reduced to what a position needs, or a snapshot marker
+  struct Command
+  {
+    const T *product;
+    size_t bookId;
+    long amount;
+    SnapshotRequest *snapshot;
+  };
+
+  struct Shard
+  {
+    SpscQueue<Command> queue;
+    KeyedStore<const T*, Position<T> > positions;
+    thread worker;
+
+    Shard(size_t capacity) : queue(capacity) {}
+
+    // the queue's indices sit on their own cache lines, which plain new does not honour before C++17
+    static void* operator new(size_t size)
+    {
+      void *p = boost::alignment::aligned_alloc(alignof(Shard), size);
+      if (!p) throw bad_alloc();
+      return p;
+    }
+    static void operator delete(void *p) { boost::alignment::aligned_free(p); }
+  };
+
+  // Queue a command, waiting while the shard is full
+  void Push(Shard &shard, const Command &command);
+
+  // Apply a shard's commands until stopped and empty
+  void Run(Shard &shard, size_t index);
+
+  vector<unique_ptr<Shard> > shards;
+  KeyedStore<string, size_t> bookIds;
+  atomic<bool> running;
+
+};
+
+template<typename T>
+ShardedPositionService<T>::ShardedPositionService(size_t _shards, size_t capacity) :
+  running(true)
+{
+  for (size_t i = 0; i < max<size_t>(1, _shards); ++i) shards.push_back(unique_ptr<Shard>(new Shard(capacity)));
+  for (size_t i = 0; i < shards.size(); ++i) shards[i]->worker = thread(&ShardedPositionService<T>::Run, this, ref(*shards[i]), i);
+}
+
+template<typename T>
+ShardedPositionService<T>::~ShardedPositionService()
+{
+  running.store(false, memory_order_release);
+  for (auto &shard : shards) shard->worker.join();
+}
+
+template<typename T>
+void ShardedPositionService<T>::AddTrade(const Trade<T> &trade)
+{
+  // book ids are cached on the booking thread, so the shards never touch the registry lock
+  size_t i = bookIds.IndexOf(trade.GetBook());
+  if (i == KeyedStore<string, size_t>::NOT_FOUND) {
+    i = bookIds.Assign(trade.GetBook());
+    bookIds.AtIndex(i) = BookRegistry::instance()->Intern(trade.GetBook());
+  }
+
+  // products are registered once, so the address identifies the product and is cheap to route on
+  const T *product = &trade.GetProduct();
+  uint64_t h = reinterpret_cast<uintptr_t>(product) / alignof(T);
+  h ^= h >> 17;
+  h *= 0x9E3779B97F4A7C15ULL;
+
+  Command command;
+  command.product = product;
+  command.bookId = bookIds.AtIndex(i);
+  command.amount = (trade.GetSide() == BUY ? trade.GetQuantity() : -trade.GetQuantity());
+  command.snapshot = nullptr;
+  Push(*shards[(h >> 32) % shards.size()], command);
+}
+
+template<typename T>
+vector<Position<T> > ShardedPositionService<T>::Snapshot()
+{
+  // every trade added before the marker is ahead of it in its shard's queue
+  SnapshotRequest request;
+  request.parts.resize(shards.size());
+  request.remaining.store(shards.size(), memory_order_relaxed);
+
+  Command command;
+  command.product = nullptr;
+  command.bookId = 0;
+  command.amount = 0;
+  command.snapshot = &request;
+  for (auto &shard : shards) Push(*shard, command);
+
+  while (request.remaining.load(memory_order_acquire) > 0) this_thread::yield();
+
+  vector<Position<T> > result;
+  for (auto &part : request.parts) result.insert(result.end(), part.begin(), part.end());
+  sort(result.begin(), result.end(), [](const Position<T> &a, const Position<T> &b) { return a.GetProduct().GetProductId() < b.GetProduct().GetProductId(); });
+  return result;
+}
+
+template<typename T>
+size_t ShardedPositionService<T>::GetShardCount() const
+{
+  return shards.size();
+}
+
+template<typename T>
+void ShardedPositionService<T>::ProcessAdd(Trade<T> &data)
+{
+  AddTrade(data);
+}
+
+template<typename T>
+void ShardedPositionService<T>::ProcessRemove(Trade<T> &data)
+{
+}
+
+template<typename T>
+void ShardedPositionService<T>::ProcessUpdate(Trade<T> &data)
+{
+}
+
+template<typename T>
+void ShardedPositionService<T>::Push(Shard &shard, const Command &command)
+{
+  while (!shard.queue.TryPush(command)) this_thread::yield();
+}
+
+template<typename T>
+void ShardedPositionService<T>::Run(Shard &shard, size_t index)
+{
+  auto apply = [&](Command &command) {
+    if (command.snapshot) {
+      vector<Position<T> > &part = command.snapshot->parts[index];
+      part.reserve(shard.positions.size());
+      for (auto &entry : shard.positions) part.push_back(entry.second);
+      command.snapshot->remaining.fetch_sub(1, memory_order_release);
+      return;
+    }
+    size_t i = shard.positions.IndexOf(command.product);
+    if (i == KeyedStore<const T*, Position<T> >::NOT_FOUND) {
+      i = shard.positions.Assign(command.product);
+      shard.positions.AtIndex(i) = Position<T>(*command.product);
+    }
+    shard.positions.AtIndex(i).AddPosition(command.bookId, command.amount);
+  };
+
+  int idle = 0;
+  for (;;) {
+    if (shard.queue.TryConsume(apply)) {
+      idle = 0;
+      continue;
+    }
+    // stop only once the queue is seen empty after the stop flag
+    if (!running.load(memory_order_acquire)) {
+      while (shard.queue.TryConsume(apply)) {}
+      return;
+    }
+    IdleBackoff(idle);
+  }
+}
+
+#endif